@@ -15,6 +15,9 @@
 
 #include <linux/regmap.h>
 #include <linux/fs.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
 
 struct regmap;
 struct regcache_ops;
@@ -30,6 +33,13 @@ struct regmap_format {
 	unsigned int (*parse_val)(void *buf);
 };
 
+/* A write in flight on the bus, embedded in a bus specific context */
+struct regmap_async {
+	struct list_head list;
+	struct regmap *map;
+	void *work_buf;
+};
+
 struct regmap {
 	struct mutex lock;
 
@@ -75,6 +85,15 @@ struct regmap {
 	const void *reg_defaults_raw;
 	void *cache;
 	bool cache_dirty;
+	/* if set, sync writes runs of registers with one raw write */
+	bool cache_sync_raw;
+
+	/* if set, writes are submitted without waiting for completion */
+	bool async;
+	spinlock_t async_lock;
+	wait_queue_head_t async_waitq;
+	struct list_head async_list;	/* writes in flight */
+	int async_ret;			/* first error from async writes */
 };
 
 struct regcache_ops {
@@ -94,6 +113,8 @@ bool regmap_precious(struct regmap *map, unsigned int reg);
 
 int _regmap_write(struct regmap *map, unsigned int reg,
 		  unsigned int val);
+int _regmap_raw_write(struct regmap *map, unsigned int reg,
+		      const void *val, size_t val_len);
 
 #ifdef CONFIG_DEBUG_FS
 extern void regmap_debugfs_initcall(void);
@@ -119,6 +140,12 @@ unsigned int regcache_get_val(const void *base, unsigned int idx,
 bool regcache_set_val(void *base, unsigned int idx,
 		      unsigned int val, unsigned int word_size);
 int regcache_lookup_reg(struct regmap *map, unsigned int reg);
+void regcache_update_dirty(struct regmap *map, unsigned long *dirty,
+			   unsigned int idx, unsigned int reg,
+			   unsigned int val);
+int regcache_sync_block(struct regmap *map, const void *block,
+			const unsigned long *dirty, unsigned int base,
+			unsigned int count);
 
 extern struct regcache_ops regcache_rbtree_ops;
 extern struct regcache_ops regcache_lzo_ops;
@@ -24,8 +24,8 @@ struct regcache_lzo_ctx {
 	size_t src_len;
 	size_t dst_len;
 	size_t decompressed_size;
-	unsigned long *sync_bmp;
-	int sync_bmp_nbits;
+	/* registers in the block which may need syncing */
+	unsigned long *dirty;
 };
 
 #define LZO_BLOCK_NUM 8
@@ -104,35 +104,31 @@ static int regcache_lzo_decompress_cache_block(struct regmap *map,
 	return 0;
 }
 
+static inline int regcache_lzo_get_blksize(struct regmap *map)
+{
+	/* whole registers only, the index calculations rely on it */
+	return roundup(DIV_ROUND_UP(map->cache_size_raw,
+				    regcache_lzo_block_count(map)),
+		       map->cache_word_size);
+}
+
 static inline int regcache_lzo_get_blkindex(struct regmap *map,
 					    unsigned int reg)
 {
-	return (reg * map->cache_word_size) /
-		DIV_ROUND_UP(map->cache_size_raw,
-			     regcache_lzo_block_count(map));
+	return (reg * map->cache_word_size) / regcache_lzo_get_blksize(map);
 }
 
 static inline int regcache_lzo_get_blkpos(struct regmap *map,
 					  unsigned int reg)
 {
-	return reg % (DIV_ROUND_UP(map->cache_size_raw,
-				   regcache_lzo_block_count(map)) /
-		      map->cache_word_size);
-}
-
-static inline int regcache_lzo_get_blksize(struct regmap *map)
-{
-	return DIV_ROUND_UP(map->cache_size_raw,
-			    regcache_lzo_block_count(map));
+	return reg % (regcache_lzo_get_blksize(map) / map->cache_word_size);
 }
 
 static int regcache_lzo_init(struct regmap *map)
 {
 	struct regcache_lzo_ctx **lzo_blocks;
-	size_t bmp_size;
 	int ret, i, blksize, blkcount;
 	const char *p, *end;
-	unsigned long *sync_bmp;
 
 	ret = 0;
 
@@ -143,45 +139,43 @@ static int regcache_lzo_init(struct regmap *map)
 		return -ENOMEM;
 	lzo_blocks = map->cache;
 
-	/*
-	 * allocate a bitmap to be used when syncing the cache with
-	 * the hardware.  Each time a register is modified, the corresponding
-	 * bit is set in the bitmap, so we know that we have to sync
-	 * that register.
-	 */
-	bmp_size = map->num_reg_defaults_raw;
-	sync_bmp = kmalloc(BITS_TO_LONGS(bmp_size) * sizeof(long),
-			   GFP_KERNEL);
-	if (!sync_bmp) {
-		ret = -ENOMEM;
-		goto err;
-	}
-	bitmap_zero(sync_bmp, bmp_size);
+	blksize = regcache_lzo_get_blksize(map);
 
 	/* allocate the lzo blocks and initialize them */
 	for (i = 0; i < blkcount; i++) {
 		lzo_blocks[i] = kzalloc(sizeof **lzo_blocks,
 					GFP_KERNEL);
 		if (!lzo_blocks[i]) {
-			kfree(sync_bmp);
 			ret = -ENOMEM;
 			goto err;
 		}
-		lzo_blocks[i]->sync_bmp = sync_bmp;
-		lzo_blocks[i]->sync_bmp_nbits = bmp_size;
+		/*
+		 * Each time a register is modified the corresponding bit
+		 * in the block's bitmap is updated, so when syncing we
+		 * know which registers need writing and can skip blocks
+		 * which have none without decompressing them.
+		 */
+		lzo_blocks[i]->dirty = kzalloc(BITS_TO_LONGS(blksize /
+					map->cache_word_size) * sizeof(long),
+					GFP_KERNEL);
+		if (!lzo_blocks[i]->dirty) {
+			ret = -ENOMEM;
+			goto err;
+		}
 		/* alloc the working space for the compressed block */
 		ret = regcache_lzo_prepare(lzo_blocks[i]);
 		if (ret < 0)
 			goto err;
 	}
 
-	blksize = regcache_lzo_get_blksize(map);
 	p = map->reg_defaults_raw;
 	end = map->reg_defaults_raw + map->cache_size_raw;
 	/* compress the register map and fill the lzo blocks */
 	for (i = 0; i < blkcount; i++, p += blksize) {
 		lzo_blocks[i]->src = p;
-		if (p + blksize > end)
+		if (p >= end)
+			lzo_blocks[i]->src_len = 0;
+		else if (p + blksize > end)
 			lzo_blocks[i]->src_len = end - p;
 		else
 			lzo_blocks[i]->src_len = blksize;
@@ -209,15 +203,9 @@ static int regcache_lzo_exit(struct regmap *map)
 		return 0;
 
 	blkcount = regcache_lzo_block_count(map);
-	/*
-	 * the pointer to the bitmap used for syncing the cache
-	 * is shared amongst all lzo_blocks.  Ensure it is freed
-	 * only once.
-	 */
-	if (lzo_blocks[0])
-		kfree(lzo_blocks[0]->sync_bmp);
 	for (i = 0; i < blkcount; i++) {
 		if (lzo_blocks[i]) {
+			kfree(lzo_blocks[i]->dirty);
 			kfree(lzo_blocks[i]->wmem);
 			kfree(lzo_blocks[i]->dst);
 		}
@@ -320,8 +308,8 @@ static int regcache_lzo_write(struct regmap *map,
 		goto out;
 	}
 
-	/* set the bit so we know we have to sync this register */
-	set_bit(reg, lzo_block->sync_bmp);
+	/* note whether we now have to sync this register */
+	regcache_update_dirty(map, lzo_block->dirty, blkpos, reg, value);
 	kfree(tmp_dst);
 	kfree(lzo_block->src);
 	return 0;
@@ -333,23 +321,44 @@ out:
 
 static int regcache_lzo_sync(struct regmap *map)
 {
-	struct regcache_lzo_ctx **lzo_blocks;
-	unsigned int val;
-	int i;
+	struct regcache_lzo_ctx *lzo_block, **lzo_blocks;
+	size_t tmp_dst_len;
+	void *tmp_dst;
+	unsigned int base, count;
+	int i, blkcount, blkregs;
 	int ret;
 
 	lzo_blocks = map->cache;
-	for_each_set_bit(i, lzo_blocks[0]->sync_bmp, lzo_blocks[0]->sync_bmp_nbits) {
-		ret = regcache_read(map, i, &val);
-		if (ret)
-			return ret;
-		map->cache_bypass = 1;
-		ret = _regmap_write(map, i, val);
-		map->cache_bypass = 0;
-		if (ret)
+	blkcount = regcache_lzo_block_count(map);
+	blkregs = regcache_lzo_get_blksize(map) / map->cache_word_size;
+
+	for (i = 0; i < blkcount; i++) {
+		lzo_block = lzo_blocks[i];
+		base = i * blkregs;
+		count = lzo_block->decompressed_size / map->cache_word_size;
+
+		/* nothing in this block to sync, don't decompress it */
+		if (find_first_bit(lzo_block->dirty, count) >= count)
+			continue;
+
+		tmp_dst = lzo_block->dst;
+		tmp_dst_len = lzo_block->dst_len;
+
+		lzo_block->src = lzo_block->dst;
+		lzo_block->src_len = lzo_block->dst_len;
+
+		ret = regcache_lzo_decompress_cache_block(map, lzo_block);
+		if (ret >= 0)
+			ret = regcache_sync_block(map, lzo_block->dst,
+						  lzo_block->dirty, base,
+						  count);
+
+		kfree(lzo_block->dst);
+		lzo_block->dst = tmp_dst;
+		lzo_block->dst_len = tmp_dst_len;
+
+		if (ret < 0)
 			return ret;
-		dev_dbg(map->dev, "Synced register %#x, value %#x\n",
-			i, val);
 	}
 
 	return 0;
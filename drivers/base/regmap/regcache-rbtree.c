@@ -28,6 +28,8 @@ struct regcache_rbtree_node {
 	unsigned int base_reg;
 	/* block of adjacent registers */
 	void *block;
+	/* registers in the block which may need syncing */
+	unsigned long *dirty;
 	/* number of registers available in the block */
 	unsigned int blklen;
 } __attribute__ ((packed));
@@ -52,11 +54,13 @@ static unsigned int regcache_rbtree_get_register(
 	return regcache_get_val(rbnode->block, idx, word_size);
 }
 
-static void regcache_rbtree_set_register(struct regcache_rbtree_node *rbnode,
-					 unsigned int idx, unsigned int val,
-					 unsigned int word_size)
+static void regcache_rbtree_set_register(struct regmap *map,
+					 struct regcache_rbtree_node *rbnode,
+					 unsigned int idx, unsigned int val)
 {
-	regcache_set_val(rbnode->block, idx, val, word_size);
+	regcache_set_val(rbnode->block, idx, val, map->cache_word_size);
+	regcache_update_dirty(map, rbnode->dirty, idx,
+			      rbnode->base_reg + idx, val);
 }
 
 static struct regcache_rbtree_node *regcache_rbtree_lookup(struct regmap *map,
@@ -230,6 +234,7 @@ static int regcache_rbtree_exit(struct regmap *map)
 		next = rb_next(&rbtree_node->node);
 		rb_erase(&rbtree_node->node, &rbtree_ctx->root);
 		kfree(rbtree_node->block);
+		kfree(rbtree_node->dirty);
 		kfree(rbtree_node);
 	}
 
@@ -259,29 +264,48 @@ static int regcache_rbtree_read(struct regmap *map,
 }
 
 
-static int regcache_rbtree_insert_to_block(struct regcache_rbtree_node *rbnode,
+static int regcache_rbtree_insert_to_block(struct regmap *map,
+					   struct regcache_rbtree_node *rbnode,
 					   unsigned int pos, unsigned int reg,
-					   unsigned int value, unsigned int word_size)
+					   unsigned int value)
 {
+	unsigned int word_size = map->cache_word_size;
+	unsigned long *dirty;
+	unsigned int i;
 	u8 *blk;
 
 	blk = krealloc(rbnode->block,
 		       (rbnode->blklen + 1) * word_size, GFP_KERNEL);
 	if (!blk)
 		return -ENOMEM;
+	rbnode->block = blk;
+
+	dirty = krealloc(rbnode->dirty,
+			 BITS_TO_LONGS(rbnode->blklen + 1) * sizeof(long),
+			 GFP_KERNEL);
+	if (!dirty)
+		return -ENOMEM;
+	rbnode->dirty = dirty;
 
 	/* insert the register value in the correct place in the rbnode block */
 	memmove(blk + (pos + 1) * word_size,
 		blk + pos * word_size,
 		(rbnode->blklen - pos) * word_size);
 
-	/* update the rbnode block, its size and the base register */
-	rbnode->block = blk;
+	/* and move the dirty bits of the registers after it along */
+	for (i = rbnode->blklen; i > pos; i--) {
+		if (test_bit(i - 1, dirty))
+			__set_bit(i, dirty);
+		else
+			__clear_bit(i, dirty);
+	}
+
+	/* update the rbnode size and the base register */
 	rbnode->blklen++;
 	if (!pos)
 		rbnode->base_reg = reg;
 
-	regcache_rbtree_set_register(rbnode, pos, value, word_size);
+	regcache_rbtree_set_register(map, rbnode, pos, value);
 	return 0;
 }
 
@@ -308,8 +332,7 @@ static int regcache_rbtree_write(struct regmap *map, unsigned int reg,
 						   map->cache_word_size);
 		if (val == value)
 			return 0;
-		regcache_rbtree_set_register(rbnode, reg_tmp, value,
-					     map->cache_word_size);
+		regcache_rbtree_set_register(map, rbnode, reg_tmp, value);
 	} else {
 		/* look for an adjacent register to the one we are about to add */
 		for (node = rb_first(&rbtree_ctx->root); node;
@@ -324,9 +347,8 @@ static int regcache_rbtree_write(struct regmap *map, unsigned int reg,
 					pos = i + 1;
 				else
 					pos = i;
-				ret = regcache_rbtree_insert_to_block(rbnode_tmp, pos,
-								      reg, value,
-								      map->cache_word_size);
+				ret = regcache_rbtree_insert_to_block(map, rbnode_tmp,
+								      pos, reg, value);
 				if (ret)
 					return ret;
 				rbtree_ctx->cached_rbnode = rbnode_tmp;
@@ -345,11 +367,14 @@ static int regcache_rbtree_write(struct regmap *map, unsigned int reg,
 		rbnode->base_reg = reg;
 		rbnode->block = kmalloc(rbnode->blklen * map->cache_word_size,
 					GFP_KERNEL);
-		if (!rbnode->block) {
+		rbnode->dirty = kzalloc(sizeof(long), GFP_KERNEL);
+		if (!rbnode->block || !rbnode->dirty) {
+			kfree(rbnode->block);
+			kfree(rbnode->dirty);
 			kfree(rbnode);
 			return -ENOMEM;
 		}
-		regcache_rbtree_set_register(rbnode, 0, value, map->cache_word_size);
+		regcache_rbtree_set_register(map, rbnode, 0, value);
 		regcache_rbtree_insert(&rbtree_ctx->root, rbnode);
 		rbtree_ctx->cached_rbnode = rbnode;
 	}
@@ -362,32 +387,15 @@ static int regcache_rbtree_sync(struct regmap *map)
 	struct regcache_rbtree_ctx *rbtree_ctx;
 	struct rb_node *node;
 	struct regcache_rbtree_node *rbnode;
-	unsigned int regtmp;
-	unsigned int val;
 	int ret;
-	int i;
 
 	rbtree_ctx = map->cache;
 	for (node = rb_first(&rbtree_ctx->root); node; node = rb_next(node)) {
 		rbnode = rb_entry(node, struct regcache_rbtree_node, node);
-		for (i = 0; i < rbnode->blklen; i++) {
-			regtmp = rbnode->base_reg + i;
-			val = regcache_rbtree_get_register(rbnode, i,
-							   map->cache_word_size);
-
-			/* Is this the hardware default?  If so skip. */
-			ret = regcache_lookup_reg(map, i);
-			if (ret > 0 && val == map->reg_defaults[ret].def)
-				continue;
-
-			map->cache_bypass = 1;
-			ret = _regmap_write(map, regtmp, val);
-			map->cache_bypass = 0;
-			if (ret)
-				return ret;
-			dev_dbg(map->dev, "Synced register %#x, value %#x\n",
-				regtmp, val);
-		}
+		ret = regcache_sync_block(map, rbnode->block, rbnode->dirty,
+					  rbnode->base_reg, rbnode->blklen);
+		if (ret)
+			return ret;
 	}
 
 	return 0;
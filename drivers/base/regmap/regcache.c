@@ -272,6 +272,8 @@ int regcache_sync(struct regmap *map)
 		goto out;
 	if (map->cache_ops->sync) {
 		ret = map->cache_ops->sync(map);
+		if (ret == 0)
+			map->cache_dirty = false;
 	} else {
 		for (i = 0; i < map->num_reg_defaults; i++) {
 			ret = regcache_read(map, i, &val);
@@ -427,3 +429,108 @@ int regcache_lookup_reg(struct regmap *map, unsigned int reg)
 	else
 		return -ENOENT;
 }
+
+/**
+ * regcache_update_dirty: Track whether a cached register needs syncing
+ *
+ * @map: map the register belongs to.
+ * @dirty: dirty bitmap of the cache block holding the register.
+ * @idx: index of the register within the block.
+ * @reg: the register.
+ * @val: the new value of the register.
+ *
+ * Cache types keep a dirty bit for each register which may differ
+ * from its hardware default, these are the only registers a sync
+ * needs to restore.  Registers without a known default are always
+ * considered dirty once written.
+ */
+void regcache_update_dirty(struct regmap *map, unsigned long *dirty,
+			   unsigned int idx, unsigned int reg,
+			   unsigned int val)
+{
+	int ret;
+
+	ret = regcache_lookup_reg(map, reg);
+	if (ret >= 0 && map->reg_defaults[ret].def == val)
+		__clear_bit(idx, dirty);
+	else
+		__set_bit(idx, dirty);
+}
+
+static int regcache_sync_block_raw(struct regmap *map, const void *block,
+				   unsigned int base, unsigned int start,
+				   unsigned int end)
+{
+	size_t val_bytes = map->format.val_bytes;
+	unsigned int i, val;
+	void *buf;
+	int ret;
+
+	buf = kmalloc((end - start) * val_bytes, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	for (i = start; i < end; i++) {
+		val = regcache_get_val(block, i, map->cache_word_size);
+		map->format.format_val(buf + (i - start) * val_bytes, val);
+	}
+
+	map->cache_bypass = 1;
+	ret = _regmap_raw_write(map, base + start, buf,
+				(end - start) * val_bytes);
+	map->cache_bypass = 0;
+
+	kfree(buf);
+	return ret;
+}
+
+/**
+ * regcache_sync_block: Write the dirty registers of a cache block
+ *
+ * @map: map to sync.
+ * @block: register values for the block, in cache format.
+ * @dirty: dirty bitmap for the block.
+ * @base: first register of the block.
+ * @count: number of registers in the block.
+ *
+ * Runs of adjacent dirty registers are written in a single raw write
+ * if the device supports it (sync_raw in the regmap_config) and the
+ * register format allows it, otherwise registers are written one by one.
+ */
+int regcache_sync_block(struct regmap *map, const void *block,
+			const unsigned long *dirty, unsigned int base,
+			unsigned int count)
+{
+	unsigned int start, end, i, val;
+	int ret;
+
+	start = find_first_bit(dirty, count);
+	while (start < count) {
+		end = find_next_zero_bit(dirty, count, start);
+
+		if (map->cache_sync_raw && map->format.format_val &&
+		    end - start > 1) {
+			ret = regcache_sync_block_raw(map, block, base,
+						      start, end);
+			if (ret != 0)
+				return ret;
+		} else {
+			for (i = start; i < end; i++) {
+				val = regcache_get_val(block, i,
+						       map->cache_word_size);
+				map->cache_bypass = 1;
+				ret = _regmap_write(map, base + i, val);
+				map->cache_bypass = 0;
+				if (ret != 0)
+					return ret;
+			}
+		}
+
+		dev_dbg(map->dev, "Synced registers %#x-%#x\n",
+			base + start, base + end - 1);
+
+		start = find_next_bit(dirty, count, end);
+	}
+
+	return 0;
+}
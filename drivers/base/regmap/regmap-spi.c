@@ -14,6 +14,15 @@
 #include <linux/spi/spi.h>
 #include <linux/init.h>
 #include <linux/module.h>
+#include <linux/slab.h>
+
+#include "internal.h"
+
+struct regmap_async_spi {
+	struct regmap_async core;
+	struct spi_message m;
+	struct spi_transfer t[2];
+};
 
 static int regmap_spi_write(struct device *dev, const void *data, size_t count)
 {
@@ -38,6 +47,49 @@ static int regmap_spi_gather_write(struct device *dev,
 	return spi_sync(spi, &m);
 }
 
+static void regmap_spi_complete(void *data)
+{
+	struct regmap_async_spi *async = data;
+
+	regmap_async_complete_cb(&async->core, async->m.status);
+}
+
+static int regmap_spi_async_write(struct device *dev,
+				  const void *reg, size_t reg_len,
+				  const void *val, size_t val_len,
+				  struct regmap_async *a)
+{
+	struct regmap_async_spi *async = container_of(a,
+						      struct regmap_async_spi,
+						      core);
+	struct spi_device *spi = to_spi_device(dev);
+
+	async->t[0].tx_buf = reg;
+	async->t[0].len = reg_len;
+	async->t[1].tx_buf = val;
+	async->t[1].len = val_len;
+
+	spi_message_init(&async->m);
+	spi_message_add_tail(&async->t[0], &async->m);
+	spi_message_add_tail(&async->t[1], &async->m);
+
+	async->m.complete = regmap_spi_complete;
+	async->m.context = async;
+
+	return spi_async(spi, &async->m);
+}
+
+static struct regmap_async *regmap_spi_async_alloc(void)
+{
+	struct regmap_async_spi *async;
+
+	async = kzalloc(sizeof(*async), GFP_KERNEL);
+	if (!async)
+		return NULL;
+
+	return &async->core;
+}
+
 static int regmap_spi_read(struct device *dev,
 			   const void *reg, size_t reg_size,
 			   void *val, size_t val_size)
@@ -50,7 +102,9 @@ static int regmap_spi_read(struct device *dev,
 static struct regmap_bus regmap_spi = {
 	.write = regmap_spi_write,
 	.gather_write = regmap_spi_gather_write,
+	.async_write = regmap_spi_async_write,
 	.read = regmap_spi_read,
+	.async_alloc = regmap_spi_async_alloc,
 	.read_flag_mask = 0x80,
 };
 
@@ -158,6 +158,9 @@ struct regmap *regmap_init(struct device *dev,
 	}
 
 	mutex_init(&map->lock);
+	spin_lock_init(&map->async_lock);
+	init_waitqueue_head(&map->async_waitq);
+	INIT_LIST_HEAD(&map->async_list);
 	map->format.buf_size = (config->reg_bits + config->val_bits) / 8;
 	map->format.reg_bytes = config->reg_bits / 8;
 	map->format.val_bytes = config->val_bits / 8;
@@ -169,6 +172,7 @@ struct regmap *regmap_init(struct device *dev,
 	map->volatile_reg = config->volatile_reg;
 	map->precious_reg = config->precious_reg;
 	map->cache_type = config->cache_type;
+	map->cache_sync_raw = config->sync_raw;
 
 	if (config->read_flag_mask || config->write_flag_mask) {
 		map->read_flag_mask = config->read_flag_mask;
@@ -283,6 +287,7 @@ int regmap_reinit_cache(struct regmap *map, const struct regmap_config *config)
 	map->volatile_reg = config->volatile_reg;
 	map->precious_reg = config->precious_reg;
 	map->cache_type = config->cache_type;
+	map->cache_sync_raw = config->sync_raw;
 
 	map->cache_bypass = false;
 	map->cache_only = false;
@@ -299,6 +304,7 @@ int regmap_reinit_cache(struct regmap *map, const struct regmap_config *config)
  */
 void regmap_exit(struct regmap *map)
 {
+	regmap_async_complete(map);
 	regcache_exit(map);
 	regmap_debugfs_exit(map);
 	kfree(map->work_buf);
@@ -306,8 +312,52 @@ void regmap_exit(struct regmap *map)
 }
 EXPORT_SYMBOL_GPL(regmap_exit);
 
-static int _regmap_raw_write(struct regmap *map, unsigned int reg,
-			     const void *val, size_t val_len)
+/* Submit a write whose register is already formatted in work_buf */
+static int _regmap_raw_write_async(struct regmap *map,
+				   const void *val, size_t val_len)
+{
+	size_t reg_bytes = map->format.reg_bytes;
+	struct regmap_async *async;
+	unsigned long flags;
+	int ret;
+
+	async = map->bus->async_alloc();
+	if (!async)
+		return -ENOMEM;
+
+	/* The caller's buffers may go away before the write is done */
+	async->work_buf = kmalloc(reg_bytes + val_len, GFP_KERNEL);
+	if (!async->work_buf) {
+		kfree(async);
+		return -ENOMEM;
+	}
+	memcpy(async->work_buf, map->work_buf, reg_bytes);
+	memcpy(async->work_buf + reg_bytes, val, val_len);
+	async->map = map;
+
+	spin_lock_irqsave(&map->async_lock, flags);
+	list_add_tail(&async->list, &map->async_list);
+	spin_unlock_irqrestore(&map->async_lock, flags);
+
+	ret = map->bus->async_write(map->dev, async->work_buf, reg_bytes,
+				    async->work_buf + reg_bytes, val_len,
+				    async);
+	if (ret != 0) {
+		dev_err(map->dev, "Failed to schedule write: %d\n", ret);
+
+		spin_lock_irqsave(&map->async_lock, flags);
+		list_del(&async->list);
+		spin_unlock_irqrestore(&map->async_lock, flags);
+
+		kfree(async->work_buf);
+		kfree(async);
+	}
+
+	return ret;
+}
+
+int _regmap_raw_write(struct regmap *map, unsigned int reg,
+		      const void *val, size_t val_len)
 {
 	u8 *u8 = map->work_buf;
 	void *buf;
@@ -321,6 +371,32 @@ static int _regmap_raw_write(struct regmap *map, unsigned int reg,
 			if (!map->writeable_reg(map->dev, reg + i))
 				return -EINVAL;
 
+	/* Keep the cache coherent with multi-register writes; single
+	 * register writes from _regmap_write() have already done so.
+	 */
+	if (!map->cache_bypass && map->format.parse_val &&
+	    val != map->work_buf + map->format.reg_bytes) {
+		size_t val_bytes = map->format.val_bytes;
+		unsigned int ival;
+
+		for (i = 0; i < val_len / val_bytes; i++) {
+			memcpy(map->work_buf, val + (i * val_bytes), val_bytes);
+			ival = map->format.parse_val(map->work_buf);
+			ret = regcache_write(map, reg + i, ival);
+			if (ret) {
+				dev_err(map->dev,
+					"Error in caching of register: %u ret: %d\n",
+					reg + i, ret);
+				return ret;
+			}
+		}
+		if (map->cache_only) {
+			map->cache_dirty = true;
+			return 0;
+		}
+		ret = -ENOTSUPP;
+	}
+
 	map->format.format_reg(map->work_buf, reg);
 
 	u8[0] |= map->write_flag_mask;
@@ -328,6 +404,9 @@ static int _regmap_raw_write(struct regmap *map, unsigned int reg,
 	trace_regmap_hw_write_start(map->dev, reg,
 				    val_len / map->format.val_bytes);
 
+	if (map->async && map->bus->async_write)
+		return _regmap_raw_write_async(map, val, val_len);
+
 	/* If we're doing a single register write we can probably just
 	 * send the work_buf directly, otherwise try to do a gather
 	 * write.
@@ -422,6 +501,38 @@ int regmap_write(struct regmap *map, unsigned int reg, unsigned int val)
 }
 EXPORT_SYMBOL_GPL(regmap_write);
 
+/**
+ * regmap_write_async(): Write a value to a single register asynchronously
+ *
+ * @map: Register map to write to
+ * @reg: Register to write to
+ * @val: Value to be written
+ *
+ * As regmap_write() but the write is only started, the function does
+ * not wait for the bus transfer to complete.  Writes are performed in
+ * the order they are submitted.  Use regmap_async_complete() to wait
+ * for them and collect any errors.  Buses without asynchronous
+ * support simply do a synchronous write.
+ *
+ * A value of zero will be returned on success, a negative errno will
+ * be returned in error cases.
+ */
+int regmap_write_async(struct regmap *map, unsigned int reg, unsigned int val)
+{
+	int ret;
+
+	mutex_lock(&map->lock);
+
+	map->async = true;
+	ret = _regmap_write(map, reg, val);
+	map->async = false;
+
+	mutex_unlock(&map->lock);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(regmap_write_async);
+
 /**
  * regmap_raw_write(): Write raw values to one or more registers
  *
@@ -441,11 +552,10 @@ EXPORT_SYMBOL_GPL(regmap_write);
 int regmap_raw_write(struct regmap *map, unsigned int reg,
 		     const void *val, size_t val_len)
 {
-	size_t val_count = val_len / map->format.val_bytes;
 	int ret;
 
-	WARN_ON(!regmap_volatile_range(map, reg, val_count) &&
-		map->cache_type != REGCACHE_NONE);
+	if (val_len % map->format.val_bytes)
+		return -EINVAL;
 
 	mutex_lock(&map->lock);
 
@@ -457,6 +567,90 @@ int regmap_raw_write(struct regmap *map, unsigned int reg,
 }
 EXPORT_SYMBOL_GPL(regmap_raw_write);
 
+/**
+ * regmap_raw_write_async(): Write raw values to one or more registers
+ *                           asynchronously
+ *
+ * @map: Register map to write to
+ * @reg: Initial register to write to
+ * @val: Block of data to be written, laid out for direct transmission to the
+ *       device.  The data is copied so need not remain valid.
+ * @val_len: Length of data pointed to by val.
+ *
+ * As regmap_raw_write() but the function does not wait for the bus
+ * transfer to complete, see regmap_write_async().
+ *
+ * A value of zero will be returned on success, a negative errno will
+ * be returned in error cases.
+ */
+int regmap_raw_write_async(struct regmap *map, unsigned int reg,
+			   const void *val, size_t val_len)
+{
+	int ret;
+
+	if (val_len % map->format.val_bytes)
+		return -EINVAL;
+
+	mutex_lock(&map->lock);
+
+	map->async = true;
+	ret = _regmap_raw_write(map, reg, val, val_len);
+	map->async = false;
+
+	mutex_unlock(&map->lock);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(regmap_raw_write_async);
+
+/**
+ * regmap_bulk_write(): Write multiple registers to the device
+ *
+ * @map: Register map to write to
+ * @reg: First register to be written to
+ * @val: Block of data to be written, in native register size for device
+ * @val_count: Number of registers to write
+ *
+ * The registers are written to the device in a single bus transaction
+ * and the cache, if any, is updated to match.
+ *
+ * A value of zero will be returned on success, a negative errno will
+ * be returned in error cases.
+ */
+int regmap_bulk_write(struct regmap *map, unsigned int reg, const void *val,
+		      size_t val_count)
+{
+	int ret, i;
+	size_t val_bytes = map->format.val_bytes;
+	void *wval;
+
+	if (!map->format.parse_val)
+		return -EINVAL;
+
+	/* No formatting is required for single byte registers */
+	if (val_bytes == 1) {
+		wval = (void *)val;
+	} else {
+		wval = kmemdup(val, val_count * val_bytes, GFP_KERNEL);
+		if (!wval)
+			return -ENOMEM;
+		for (i = 0; i < val_count * val_bytes; i += val_bytes)
+			map->format.parse_val(wval + i);
+	}
+
+	mutex_lock(&map->lock);
+
+	ret = _regmap_raw_write(map, reg, wval, val_bytes * val_count);
+
+	mutex_unlock(&map->lock);
+
+	if (val_bytes != 1)
+		kfree(wval);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(regmap_bulk_write);
+
 static int _regmap_raw_read(struct regmap *map, unsigned int reg, void *val,
 			    unsigned int val_len)
 {
@@ -595,9 +789,26 @@ int regmap_bulk_read(struct regmap *map, unsigned int reg, void *val,
 			map->format.parse_val(val + i);
 	} else {
 		for (i = 0; i < val_count; i++) {
-			ret = regmap_read(map, reg + i, val + (i * val_bytes));
+			unsigned int ival;
+
+			ret = regmap_read(map, reg + i, &ival);
 			if (ret != 0)
 				return ret;
+
+			/* same native values as the uncached path above */
+			switch (val_bytes) {
+			case 1:
+				((u8 *)val)[i] = ival;
+				break;
+			case 2:
+				((u16 *)val)[i] = ival;
+				break;
+			case 4:
+				((u32 *)val)[i] = ival;
+				break;
+			default:
+				return -EINVAL;
+			}
 		}
 	}
 
@@ -607,12 +818,13 @@ EXPORT_SYMBOL_GPL(regmap_bulk_read);
 
 static int _regmap_update_bits(struct regmap *map, unsigned int reg,
 			       unsigned int mask, unsigned int val,
-			       bool *change)
+			       bool *change, bool async)
 {
 	int ret;
 	unsigned int tmp, orig;
 
 	mutex_lock(&map->lock);
+	map->async = async;
 
 	ret = _regmap_read(map, reg, &orig);
 	if (ret != 0)
@@ -629,6 +841,7 @@ static int _regmap_update_bits(struct regmap *map, unsigned int reg,
 	}
 
 out:
+	map->async = false;
 	mutex_unlock(&map->lock);
 
 	return ret;
@@ -648,10 +861,33 @@ int regmap_update_bits(struct regmap *map, unsigned int reg,
 		       unsigned int mask, unsigned int val)
 {
 	bool change;
-	return _regmap_update_bits(map, reg, mask, val, &change);
+	return _regmap_update_bits(map, reg, mask, val, &change, false);
 }
 EXPORT_SYMBOL_GPL(regmap_update_bits);
 
+/**
+ * regmap_update_bits_async: Perform a read/modify/write cycle on the
+ *                           register map, not waiting for the write
+ *
+ * @map: Register map to update
+ * @reg: Register to update
+ * @mask: Bitmask to change
+ * @val: New value for bitmask
+ *
+ * As regmap_update_bits() but any write is done asynchronously, see
+ * regmap_write_async().  Reads of uncached registers still wait for
+ * the bus.
+ *
+ * Returns zero for success, a negative number on error.
+ */
+int regmap_update_bits_async(struct regmap *map, unsigned int reg,
+			     unsigned int mask, unsigned int val)
+{
+	bool change;
+	return _regmap_update_bits(map, reg, mask, val, &change, true);
+}
+EXPORT_SYMBOL_GPL(regmap_update_bits_async);
+
 /**
  * regmap_update_bits_check: Perform a read/modify/write cycle on the
  *                           register map and report if updated
@@ -668,10 +904,83 @@ int regmap_update_bits_check(struct regmap *map, unsigned int reg,
 			     unsigned int mask, unsigned int val,
 			     bool *change)
 {
-	return _regmap_update_bits(map, reg, mask, val, change);
+	return _regmap_update_bits(map, reg, mask, val, change, false);
 }
 EXPORT_SYMBOL_GPL(regmap_update_bits_check);
 
+/**
+ * regmap_async_complete_cb: Report completion of an async write
+ *
+ * @async: The write which has completed
+ * @ret: Status of the write
+ *
+ * Called by bus implementations when an async write has finished,
+ * possibly from interrupt context.
+ */
+void regmap_async_complete_cb(struct regmap_async *async, int ret)
+{
+	struct regmap *map = async->map;
+	unsigned long flags;
+	bool wake;
+
+	spin_lock_irqsave(&map->async_lock, flags);
+
+	list_del(&async->list);
+	wake = list_empty(&map->async_list);
+
+	if (ret != 0 && !map->async_ret)
+		map->async_ret = ret;
+
+	spin_unlock_irqrestore(&map->async_lock, flags);
+
+	kfree(async->work_buf);
+	kfree(async);
+
+	if (wake)
+		wake_up(&map->async_waitq);
+}
+EXPORT_SYMBOL_GPL(regmap_async_complete_cb);
+
+static int regmap_async_is_done(struct regmap *map)
+{
+	unsigned long flags;
+	int ret;
+
+	spin_lock_irqsave(&map->async_lock, flags);
+	ret = list_empty(&map->async_list);
+	spin_unlock_irqrestore(&map->async_lock, flags);
+
+	return ret;
+}
+
+/**
+ * regmap_async_complete: Ensure all asynchronous I/O has completed.
+ *
+ * @map: Map to operate on.
+ *
+ * Blocks until any pending asynchronous I/O has completed.  Returns
+ * the first error reported by the writes since the last call, if any.
+ */
+int regmap_async_complete(struct regmap *map)
+{
+	unsigned long flags;
+	int ret;
+
+	/* Nothing to do with no async support */
+	if (!map->bus->async_write)
+		return 0;
+
+	wait_event(map->async_waitq, regmap_async_is_done(map));
+
+	spin_lock_irqsave(&map->async_lock, flags);
+	ret = map->async_ret;
+	map->async_ret = 0;
+	spin_unlock_irqrestore(&map->async_lock, flags);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(regmap_async_complete);
+
 static int __init regmap_initcall(void)
 {
 	regmap_debugfs_initcall();
@@ -74,6 +74,42 @@ int twl6040_reg_write(struct twl6040 *twl6040, unsigned int reg, u8 val)
 }
 EXPORT_SYMBOL(twl6040_reg_write);
 
+/*
+ * Block access to consecutive registers in a single I2C transaction.
+ * As with twl_i2c_write(), the first byte of @buf is reserved for the
+ * register address and the data starts at buf[1]. The vibra registers
+ * (VIBCTLL to VIBDATR) are handled apart, so they must not be covered.
+ */
+int twl6040_block_write(struct twl6040 *twl6040, unsigned int reg, u8 *buf,
+			unsigned int count)
+{
+	int ret;
+
+	if (WARN_ON(reg <= TWL6040_REG_VIBDATR &&
+		    reg + count > TWL6040_REG_VIBCTLL))
+		return -EINVAL;
+
+	mutex_lock(&twl6040->io_mutex);
+	ret = twl_i2c_write(TWL_MODULE_AUDIO_VOICE, buf, reg, count);
+	mutex_unlock(&twl6040->io_mutex);
+
+	return ret;
+}
+EXPORT_SYMBOL(twl6040_block_write);
+
+int twl6040_block_read(struct twl6040 *twl6040, unsigned int reg, u8 *buf,
+		       unsigned int count)
+{
+	int ret;
+
+	mutex_lock(&twl6040->io_mutex);
+	ret = twl_i2c_read(TWL_MODULE_AUDIO_VOICE, buf, reg, count);
+	mutex_unlock(&twl6040->io_mutex);
+
+	return ret;
+}
+EXPORT_SYMBOL(twl6040_block_read);
+
 int twl6040_set_bits(struct twl6040 *twl6040, unsigned int reg, u8 mask)
 {
 	int ret;
@@ -201,6 +201,10 @@ struct twl6040 {
 int twl6040_reg_read(struct twl6040 *twl6040, unsigned int reg);
 int twl6040_reg_write(struct twl6040 *twl6040, unsigned int reg,
 		      u8 val);
+int twl6040_block_write(struct twl6040 *twl6040, unsigned int reg, u8 *buf,
+			unsigned int count);
+int twl6040_block_read(struct twl6040 *twl6040, unsigned int reg, u8 *buf,
+		       unsigned int count);
 int twl6040_set_bits(struct twl6040 *twl6040, unsigned int reg,
 		     u8 mask);
 int twl6040_clear_bits(struct twl6040 *twl6040, unsigned int reg,
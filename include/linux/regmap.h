@@ -19,6 +19,7 @@
 struct module;
 struct i2c_client;
 struct spi_device;
+struct regmap_async;
 
 /* An enum of all the supported cache types */
 enum regcache_type {
@@ -71,6 +72,10 @@ struct reg_default {
  * @reg_defaults_raw: Power on reset values for registers (for use with
  *                    register cache support).
  * @num_reg_defaults_raw: Number of elements in reg_defaults_raw.
+ *
+ * @sync_raw: Set if the device increments the register address for
+ *            multi-register writes.  Cache syncs then write runs of
+ *            adjacent dirty registers in a single transfer.
  */
 struct regmap_config {
 	int reg_bits;
@@ -90,6 +95,8 @@ struct regmap_config {
 
 	u8 read_flag_mask;
 	u8 write_flag_mask;
+
+	bool sync_raw;
 };
 
 typedef int (*regmap_hw_write)(struct device *dev, const void *data,
@@ -97,9 +104,14 @@ typedef int (*regmap_hw_write)(struct device *dev, const void *data,
 typedef int (*regmap_hw_gather_write)(struct device *dev,
 				      const void *reg, size_t reg_len,
 				      const void *val, size_t val_len);
+typedef int (*regmap_hw_async_write)(struct device *dev,
+				     const void *reg, size_t reg_len,
+				     const void *val, size_t val_len,
+				     struct regmap_async *async);
 typedef int (*regmap_hw_read)(struct device *dev,
 			      const void *reg_buf, size_t reg_size,
 			      void *val_buf, size_t val_size);
+typedef struct regmap_async *(*regmap_hw_async_alloc)(void);
 
 /**
  * Description of a hardware bus for the register map infrastructure.
@@ -107,15 +119,23 @@ typedef int (*regmap_hw_read)(struct device *dev,
  * @write: Write operation.
  * @gather_write: Write operation with split register/value, return -ENOTSUPP
  *                if not implemented  on a given device.
+ * @async_write: Optional write operation which starts the transfer and
+ *               returns without waiting for it, calling
+ *               regmap_async_complete_cb() when it finishes.  The
+ *               buffers remain valid until then.
  * @read: Read operation.  Data is returned in the buffer used to transmit
  *         data.
+ * @async_alloc: Allocate the context for an async write; the struct
+ *               regmap_async must be the first member of it.
  * @read_flag_mask: Mask to be set in the top byte of the register when doing
  *                  a read.
  */
 struct regmap_bus {
 	regmap_hw_write write;
 	regmap_hw_gather_write gather_write;
+	regmap_hw_async_write async_write;
 	regmap_hw_read read;
+	regmap_hw_async_alloc async_alloc;
 	u8 read_flag_mask;
 };
 
@@ -131,8 +151,13 @@ void regmap_exit(struct regmap *map);
 int regmap_reinit_cache(struct regmap *map,
 			const struct regmap_config *config);
 int regmap_write(struct regmap *map, unsigned int reg, unsigned int val);
+int regmap_write_async(struct regmap *map, unsigned int reg, unsigned int val);
 int regmap_raw_write(struct regmap *map, unsigned int reg,
 		     const void *val, size_t val_len);
+int regmap_raw_write_async(struct regmap *map, unsigned int reg,
+			   const void *val, size_t val_len);
+int regmap_bulk_write(struct regmap *map, unsigned int reg, const void *val,
+		      size_t val_count);
 int regmap_read(struct regmap *map, unsigned int reg, unsigned int *val);
 int regmap_raw_read(struct regmap *map, unsigned int reg,
 		    void *val, size_t val_len);
@@ -140,9 +165,13 @@ int regmap_bulk_read(struct regmap *map, unsigned int reg, void *val,
 		     size_t val_count);
 int regmap_update_bits(struct regmap *map, unsigned int reg,
 		       unsigned int mask, unsigned int val);
+int regmap_update_bits_async(struct regmap *map, unsigned int reg,
+			     unsigned int mask, unsigned int val);
 int regmap_update_bits_check(struct regmap *map, unsigned int reg,
 			     unsigned int mask, unsigned int val,
 			     bool *change);
+int regmap_async_complete(struct regmap *map);
+void regmap_async_complete_cb(struct regmap_async *async, int ret);
 
 int regcache_sync(struct regmap *map);
 void regcache_cache_only(struct regmap *map, bool enable);
@@ -498,7 +498,7 @@ enum {
  *  Raw MIDI section - /dev/snd/midi??
  */
 
-#define SNDRV_RAWMIDI_VERSION		SNDRV_PROTOCOL_VERSION(2, 0, 0)
+#define SNDRV_RAWMIDI_VERSION		SNDRV_PROTOCOL_VERSION(2, 0, 1)
 
 enum {
 	SNDRV_RAWMIDI_STREAM_OUTPUT = 0,
@@ -540,12 +540,38 @@ struct snd_rawmidi_status {
 	unsigned char reserved[16];	/* reserved for future use */
 };
 
+/*
+ * mmap of the stream buffers.  The pointers in the status page run
+ * freely up to boundary, the buffer offset is ptr % buffer_size.  The
+ * application advances appl_ptr and tells the kernel with MMAP_SYNC,
+ * which also kicks the output; the kernel picks up appl_ptr by itself
+ * whenever it looks at the buffer.  tstamp is taken whenever hw_ptr
+ * moves.  Fixed size types keep the page layout the same for 32 and
+ * 64 bit applications.
+ */
+struct snd_rawmidi_mmap_status {
+	__u32 buffer_size;		/* RO: buffer size in bytes */
+	__u32 boundary;			/* RO: pointer wrap, n * buffer_size */
+	__u32 hw_ptr;			/* RO: hw ptr (0...boundary-1) */
+	__u32 appl_ptr;			/* RW: appl ptr (0...boundary-1) */
+	__u32 xruns;			/* RO: input bytes lost to overruns */
+	__u32 pad;
+	__s64 tstamp_sec;		/* RO: CLOCK_MONOTONIC of last hw_ptr move */
+	__s64 tstamp_nsec;
+};
+
+#define SNDRV_RAWMIDI_MMAP_OFFSET_OUTPUT	0x00000000
+#define SNDRV_RAWMIDI_MMAP_OFFSET_INPUT		0x40000000
+#define SNDRV_RAWMIDI_MMAP_OFFSET_OUTPUT_STATUS	0x80000000
+#define SNDRV_RAWMIDI_MMAP_OFFSET_INPUT_STATUS	0x81000000
+
 #define SNDRV_RAWMIDI_IOCTL_PVERSION	_IOR('W', 0x00, int)
 #define SNDRV_RAWMIDI_IOCTL_INFO	_IOR('W', 0x01, struct snd_rawmidi_info)
 #define SNDRV_RAWMIDI_IOCTL_PARAMS	_IOWR('W', 0x10, struct snd_rawmidi_params)
 #define SNDRV_RAWMIDI_IOCTL_STATUS	_IOWR('W', 0x20, struct snd_rawmidi_status)
 #define SNDRV_RAWMIDI_IOCTL_DROP	_IOW('W', 0x30, int)
 #define SNDRV_RAWMIDI_IOCTL_DRAIN	_IOW('W', 0x31, int)
+#define SNDRV_RAWMIDI_IOCTL_MMAP_SYNC	_IOW('W', 0x40, int)
 
 /*
  *  Timer section - /dev/snd/timer
@@ -706,7 +732,7 @@ struct snd_timer_tread {
  *                                                                          *
  ****************************************************************************/
 
-#define SNDRV_CTL_VERSION		SNDRV_PROTOCOL_VERSION(2, 0, 7)
+#define SNDRV_CTL_VERSION		SNDRV_PROTOCOL_VERSION(2, 0, 8)
 
 struct snd_ctl_card_info {
 	int card;			/* card number */
@@ -841,6 +867,13 @@ struct snd_ctl_elem_value {
 	unsigned char reserved[128-sizeof(struct timespec)];
 };
 
+struct snd_ctl_elem_values {
+	unsigned int count;		/* W: count of values in pvalues */
+	unsigned int done;		/* R: count of values processed */
+	struct snd_ctl_elem_value __user *pvalues; /* RW: values */
+	unsigned char reserved[48];
+};
+
 struct snd_ctl_tlv {
 	unsigned int numid;	/* control element numeric identification */
 	unsigned int length;	/* in bytes aligned to 4 */
@@ -862,6 +895,8 @@ struct snd_ctl_tlv {
 #define SNDRV_CTL_IOCTL_TLV_READ	_IOWR('U', 0x1a, struct snd_ctl_tlv)
 #define SNDRV_CTL_IOCTL_TLV_WRITE	_IOWR('U', 0x1b, struct snd_ctl_tlv)
 #define SNDRV_CTL_IOCTL_TLV_COMMAND	_IOWR('U', 0x1c, struct snd_ctl_tlv)
+#define SNDRV_CTL_IOCTL_ELEM_READ_MULTI	_IOWR('U', 0x1d, struct snd_ctl_elem_values)
+#define SNDRV_CTL_IOCTL_ELEM_WRITE_MULTI _IOWR('U', 0x1e, struct snd_ctl_elem_values)
 #define SNDRV_CTL_IOCTL_HWDEP_NEXT_DEVICE _IOWR('U', 0x20, int)
 #define SNDRV_CTL_IOCTL_HWDEP_INFO	_IOR('U', 0x21, struct snd_hwdep_info)
 #define SNDRV_CTL_IOCTL_PCM_NEXT_DEVICE	_IOR('U', 0x30, int)
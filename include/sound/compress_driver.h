@@ -47,6 +47,8 @@ struct snd_compr_ops;
  * @total_bytes_available: cumulative number of bytes made available in
  *	the ring buffer
  * @total_bytes_transferred: cumulative bytes transferred by offload DSP
+ * @status: status page mmapped by the application
+ * @control: control page mmapped by the application
  * @sleep: poll sleep
  */
 struct snd_compr_runtime {
@@ -60,6 +62,8 @@ struct snd_compr_runtime {
 	u64 app_pointer;
 	u64 total_bytes_available;
 	u64 total_bytes_transferred;
+	struct snd_compr_mmap_status *status;
+	struct snd_compr_mmap_control *control;
 	wait_queue_head_t sleep;
 };
 
@@ -96,8 +100,10 @@ struct snd_compr_stream {
  * @pointer: Retrieve current h/w pointer information. Mandatory
  * @copy: Copy the compressed data to/from userspace, Optional
  * Can't be implemented if DSP supports mmap
- * @mmap: DSP mmap method to mmap DSP memory
- * @ack: Ack for DSP when data is written to audio buffer, Optional
+ * @mmap: DSP mmap method to mmap DSP memory, Optional
+ * If not implemented the core maps its own ring buffer
+ * @ack: Ack for DSP when data is written to (playback) or read from
+ * (capture) the audio buffer, Optional
  * Not valid if copy is implemented
  * @get_caps: Retrieve DSP capabilities, mandatory
  * @get_codec_caps: Retrieve capabilities for a specific codec, mandatory
@@ -112,7 +118,7 @@ struct snd_compr_ops {
 	int (*trigger)(struct snd_compr_stream *stream, int cmd);
 	int (*pointer)(struct snd_compr_stream *stream,
 			struct snd_compr_tstamp *tstamp);
-	int (*copy)(struct snd_compr_stream *stream, const char __user *buf,
+	int (*copy)(struct snd_compr_stream *stream, char __user *buf,
 		       size_t count);
 	int (*mmap)(struct snd_compr_stream *stream,
 			struct vm_area_struct *vma);
@@ -30,7 +30,7 @@
 #include <sound/compress_params.h>
 
 
-#define SNDRV_COMPRESS_VERSION SNDRV_PROTOCOL_VERSION(0, 1, 0)
+#define SNDRV_COMPRESS_VERSION SNDRV_PROTOCOL_VERSION(0, 1, 1)
 /**
  * struct snd_compressed_buffer: compressed buffer
  * @fragment_size: size of buffer fragment in bytes
@@ -82,6 +82,40 @@ struct snd_compr_avail {
 	struct snd_compr_tstamp tstamp;
 };
 
+/**
+ * struct snd_compr_mmap_status: ring buffer status shared with userspace
+ * @state: stream state, of type snd_pcm_state_t
+ * @hw_pointer: offset in ring buffer up to which the DSP has consumed
+ *	(playback) or produced (capture) data
+ * @total_bytes_transferred: cumulative bytes transferred by the DSP
+ *
+ * Mapped read-only at SNDRV_COMPRESS_MMAP_OFFSET_STATUS, updated by the core
+ * whenever it queries the DSP pointer.
+ */
+struct snd_compr_mmap_status {
+	__u32 state;
+	__u32 pad;
+	__u64 hw_pointer;
+	__u64 total_bytes_transferred;
+};
+
+/**
+ * struct snd_compr_mmap_control: application pointer shared with userspace
+ * @total_bytes_available: cumulative bytes written (playback) or read
+ *	(capture) by the application through the mmapped ring buffer
+ *
+ * Mapped read-write at SNDRV_COMPRESS_MMAP_OFFSET_CONTROL. The core picks up
+ * the new value on poll, SNDRV_COMPRESS_AVAIL, SNDRV_COMPRESS_START and
+ * SNDRV_COMPRESS_DRAIN, so no write() or read() call is needed per fragment.
+ */
+struct snd_compr_mmap_control {
+	__u64 total_bytes_available;
+};
+
+#define SNDRV_COMPRESS_MMAP_OFFSET_DATA		0x00000000
+#define SNDRV_COMPRESS_MMAP_OFFSET_STATUS	0x80000000
+#define SNDRV_COMPRESS_MMAP_OFFSET_CONTROL	0x81000000
+
 enum snd_compr_direction {
 	SND_COMPRESS_PLAYBACK = 0,
 	SND_COMPRESS_CAPTURE
@@ -152,10 +186,5 @@ struct snd_compr_codec_caps {
 #define SNDRV_COMPRESS_START		_IO('C', 0x32)
 #define SNDRV_COMPRESS_STOP		_IO('C', 0x33)
 #define SNDRV_COMPRESS_DRAIN		_IO('C', 0x34)
-/*
- * TODO
- * 1. add mmap support
- *
- */
 #define SND_COMPR_TRIGGER_DRAIN 7 /*FIXME move this to pcm.h */
 #endif
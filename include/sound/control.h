@@ -61,6 +61,7 @@ struct snd_kcontrol_volatile {
 
 struct snd_kcontrol {
 	struct list_head list;		/* list of controls */
+	struct hlist_node hash;		/* card->ctl_hash chain */
 	struct snd_ctl_elem_id id;
 	unsigned int count;		/* count of same elements */
 	snd_kcontrol_info_t *info;
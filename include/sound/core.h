@@ -28,6 +28,7 @@
 #include <linux/pm.h>			/* pm_message_t */
 #include <linux/device.h>
 #include <linux/stringify.h>
+#include <linux/radix-tree.h>		/* struct radix_tree_root */
 
 /* number of supported soundcards */
 #ifdef CONFIG_SND_DYNAMIC_MINORS
@@ -38,6 +39,10 @@
 
 #define CONFIG_SND_MAJOR	116	/* standard configuration */
 
+/* buckets of the per-card control id hash */
+#define SNDRV_CTL_HASH_BITS	6
+#define SNDRV_CTL_HASH_SIZE	(1 << SNDRV_CTL_HASH_BITS)
+
 /* forward declarations */
 #ifdef CONFIG_PCI
 struct pci_dev;
@@ -120,6 +125,8 @@ struct snd_card {
 	int controls_count;		/* count of all controls */
 	int user_ctl_count;		/* count of all user controls */
 	struct list_head controls;	/* all controls for this card */
+	struct hlist_head ctl_hash[SNDRV_CTL_HASH_SIZE]; /* controls by id */
+	struct radix_tree_root ctl_numids;	/* controls by numid */
 	struct list_head ctl_files;	/* active control files */
 
 	struct snd_info_entry *proc_root;	/* root for soundcard specific files */
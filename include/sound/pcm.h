@@ -270,6 +270,16 @@ struct snd_pcm_hw_constraint_list {
 
 struct snd_pcm_hwptr_log;
 
+#define SNDRV_PCM_HIST_BUCKETS	16
+
+/* period handling statistics, log2 buckets in microseconds */
+struct snd_pcm_latency_hist {
+	unsigned int wakeup[SNDRV_PCM_HIST_BUCKETS];	/* irq to task wakeup */
+	unsigned int jitter[SNDRV_PCM_HIST_BUCKETS];	/* hw_ptr vs. time */
+	unsigned int wakeup_max;
+	unsigned int jitter_max;
+};
+
 struct snd_pcm_runtime {
 	/* -- Status -- */
 	struct snd_pcm_substream *trigger_master;
@@ -281,6 +291,9 @@ struct snd_pcm_runtime {
 	unsigned long hw_ptr_jiffies;	/* Time when hw_ptr is updated */
 	unsigned long hw_ptr_buffer_jiffies; /* buffer time in jiffies */
 	snd_pcm_sframes_t delay;	/* extra delay; typically FIFO size */
+	u64 period_irq_ns;		/* Time of the last period update */
+	snd_pcm_uframes_t period_irq_hw_ptr; /* hw_ptr at that time */
+	unsigned int period_wake_pending; /* period update not waited yet */
 
 	/* -- HW params -- */
 	snd_pcm_access_t access;	/* access mode */
@@ -365,6 +378,7 @@ struct snd_pcm_group {		/* keep linked substreams */
 };
 
 struct pid;
+struct snd_pcm_buffer_pool;
 
 struct snd_pcm_substream {
 	struct snd_pcm *pcm;
@@ -378,6 +392,7 @@ struct snd_pcm_substream {
 	struct snd_dma_buffer dma_buffer;
 	unsigned int dma_buf_id;
 	size_t dma_max;
+	struct snd_pcm_buffer_pool *buffer_pool; /* recycles freed buffers */
 	/* -- hardware operations -- */
 	struct snd_pcm_ops *ops;
 	/* -- runtime information -- */
@@ -410,7 +425,10 @@ struct snd_pcm_substream {
 	struct snd_info_entry *proc_status_entry;
 	struct snd_info_entry *proc_prealloc_entry;
 	struct snd_info_entry *proc_prealloc_max_entry;
+	struct snd_info_entry *proc_latency_entry;
 #endif
+	/* -- period handling statistics -- */
+	struct snd_pcm_latency_hist latency;
 	/* misc flags */
 	unsigned int hw_opened: 1;
 };
@@ -858,6 +876,13 @@ int snd_pcm_format_physical_width(snd_pcm_format_t format);		/* in bits */
 ssize_t snd_pcm_format_size(snd_pcm_format_t format, size_t samples);
 const unsigned char *snd_pcm_format_silence_64(snd_pcm_format_t format);
 int snd_pcm_format_set_silence(snd_pcm_format_t format, void *buf, unsigned int frames);
+void snd_pcm_sample_copy(void *dst, unsigned int dst_step,
+			 const void *src, unsigned int src_step,
+			 unsigned int width, size_t samples);
+void snd_pcm_s16_to_s32(s32 *dst, unsigned int dst_step,
+			const s16 *src, unsigned int src_step, size_t samples);
+void snd_pcm_s32_to_s16(s16 *dst, unsigned int dst_step,
+			const s32 *src, unsigned int src_step, size_t samples);
 snd_pcm_format_t snd_pcm_build_linear_format(int width, int unsignd, int big_endian);
 
 void snd_pcm_set_ops(struct snd_pcm * pcm, int direction, struct snd_pcm_ops *ops);
@@ -75,6 +75,13 @@ struct snd_rawmidi_runtime {
 	size_t avail_min;	/* min avail for wakeup */
 	size_t avail;		/* max used buffer for wakeup */
 	size_t xruns;		/* over/underruns counter */
+	/* mmap */
+	struct snd_rawmidi_mmap_status *status;	/* shared status page */
+	size_t boundary;	/* status page pointer wrap */
+	size_t mmap_appl;	/* appl_ptr last taken from the status page */
+	atomic_t mmap_count;	/* buffer mappings */
+	struct mutex mmap_mutex;	/* mapping vs. buffer replacement */
+	struct timespec tstamp;	/* last hw_ptr move, with status page only */
 	/* misc */
 	spinlock_t lock;
 	wait_queue_head_t sleep;
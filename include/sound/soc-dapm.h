@@ -387,6 +387,7 @@ void snd_soc_dapm_auto_nc_codec_pins(struct snd_soc_codec *codec);
 
 /* Mostly internal - should not normally be used */
 void dapm_mark_dirty(struct snd_soc_dapm_widget *w, const char *reason);
+void dapm_mark_path_dirty(struct snd_soc_dapm_path *p, const char *reason);
 
 /* dapm widget types */
 enum snd_soc_dapm_type {
@@ -453,6 +454,7 @@ struct snd_soc_dapm_path {
 	struct list_head list_source;
 	struct list_head list_sink;
 	struct list_head list;
+	struct list_head walk_list;	/* paths walked by the current search */
 };
 
 /* dapm widget */
@@ -503,6 +505,8 @@ struct snd_soc_dapm_widget {
 	/* used during DAPM updates */
 	struct list_head power_list;
 	struct list_head dirty;
+
+	/* cached connected endpoint counts, -1 if they need recomputing */
 	int inputs;
 	int outputs;
 };
@@ -536,6 +540,8 @@ struct snd_soc_dapm_context {
 	/* used during DAPM updates */
 	enum snd_soc_bias_level target_bias_level;
 	struct list_head list;
+	struct list_head seq_list;	/* contexts in the current sequence step */
+	struct list_head seq_pending;	/* widgets queued for the current step */
 
 	int (*stream_event)(struct snd_soc_dapm_context *dapm, int event);
 
@@ -556,4 +562,11 @@ struct snd_soc_dapm_stats {
 	int neighbour_checks;
 };
 
+/* time taken by DAPM to power up a stream, in microseconds */
+struct snd_soc_dapm_latency {
+	unsigned int last;
+	unsigned int max;
+	unsigned int count;
+};
+
 #endif
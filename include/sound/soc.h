@@ -267,6 +267,8 @@ enum snd_soc_control_type {
 
 enum snd_soc_compress_type {
 	SND_SOC_FLAT_COMPRESSION = 1,
+	SND_SOC_RBTREE_COMPRESSION,
+	SND_SOC_LZO_COMPRESSION,
 };
 
 enum snd_soc_pcm_subclass {
@@ -300,6 +302,9 @@ int snd_soc_codec_writable_register(struct snd_soc_codec *codec,
 int snd_soc_codec_set_cache_io(struct snd_soc_codec *codec,
 			       int addr_bits, int data_bits,
 			       enum snd_soc_control_type control);
+int snd_soc_codec_defer_writes(struct snd_soc_codec *codec);
+int snd_soc_codec_flush_writes(struct snd_soc_codec *codec);
+int snd_soc_codec_end_writes(struct snd_soc_codec *codec);
 int snd_soc_cache_sync(struct snd_soc_codec *codec);
 int snd_soc_cache_init(struct snd_soc_codec *codec);
 int snd_soc_cache_exit(struct snd_soc_codec *codec);
@@ -575,6 +580,9 @@ struct snd_soc_codec {
 	const struct snd_soc_cache_ops *cache_ops;
 	struct mutex cache_rw_mutex;
 	int val_bytes;
+	unsigned long *defer_dirty; /* registers with deferred writes */
+	unsigned int defer_depth; /* nesting of deferred write sections */
+	struct mutex defer_mutex; /* protects the deferred write state */
 
 	/* dapm */
 	struct snd_soc_dapm_context dapm;
@@ -625,6 +633,8 @@ struct snd_soc_codec_driver {
 	short reg_access_size;
 	const struct snd_soc_reg_access *reg_access_default;
 	enum snd_soc_compress_type compress_type;
+	/* device auto-increments, DAPM may combine register writes */
+	bool write_combine;
 
 	/* codec bias level */
 	int (*set_bias_level)(struct snd_soc_codec *,
@@ -835,6 +845,7 @@ struct snd_soc_card {
 	/* Generic DAPM context for the card */
 	struct snd_soc_dapm_context dapm;
 	struct snd_soc_dapm_stats dapm_stats;
+	bool dapm_suspended;	/* power state the endpoint counts are for */
 
 #ifdef CONFIG_DEBUG_FS
 	struct dentry *debugfs_card_root;
@@ -867,6 +878,9 @@ struct snd_soc_pcm_runtime {
 	struct snd_soc_dai *cpu_dai;
 
 	struct delayed_work delayed_work;
+
+	/* DAPM stream power up latency, per direction */
+	struct snd_soc_dapm_latency dapm_latency[2];
 };
 
 /* mixer control */
@@ -35,9 +35,11 @@
 #include <linux/sched.h>
 #include <linux/uio.h>
 #include <linux/uaccess.h>
+#include <linux/vmalloc.h>
 #include <linux/module.h>
 #include <sound/core.h>
 #include <sound/initval.h>
+#include <sound/memalloc.h>
 #include <sound/compress_params.h>
 #include <sound/compress_offload.h>
 #include <sound/compress_driver.h>
@@ -71,6 +73,16 @@ struct snd_compr_file {
  *	SNDRV_COMPRESS_PAUSE. It can be stopped or resumed by calling
  *	SNDRV_COMPRESS_STOP or SNDRV_COMPRESS_RESUME respectively.
  */
+static void snd_compr_free_status(struct snd_compr_runtime *runtime)
+{
+	if (runtime->status)
+		snd_free_pages(runtime->status,
+			       PAGE_ALIGN(sizeof(*runtime->status)));
+	if (runtime->control)
+		snd_free_pages(runtime->control,
+			       PAGE_ALIGN(sizeof(*runtime->control)));
+}
+
 static int snd_compr_open(struct inode *inode, struct file *f)
 {
 	struct snd_compr *compr;
@@ -119,15 +131,27 @@ static int snd_compr_open(struct inode *inode, struct file *f)
 	}
 	runtime->state = SNDRV_PCM_STATE_OPEN;
 	init_waitqueue_head(&runtime->sleep);
+	runtime->status = snd_malloc_pages(PAGE_ALIGN(sizeof(*runtime->status)),
+					   GFP_KERNEL);
+	runtime->control = snd_malloc_pages(
+				PAGE_ALIGN(sizeof(*runtime->control)),
+				GFP_KERNEL);
+	if (!runtime->status || !runtime->control) {
+		ret = -ENOMEM;
+		goto err;
+	}
+	runtime->status->state = SNDRV_PCM_STATE_OPEN;
 	data->stream.runtime = runtime;
 	f->private_data = (void *)data;
 	mutex_lock(&compr->lock);
 	ret = compr->ops->open(&data->stream);
 	mutex_unlock(&compr->lock);
-	if (ret) {
-		kfree(runtime);
-		kfree(data);
-	}
+	if (!ret)
+		return 0;
+err:
+	snd_compr_free_status(runtime);
+	kfree(runtime);
+	kfree(data);
 	return ret;
 }
 
@@ -135,12 +159,24 @@ static int snd_compr_free(struct inode *inode, struct file *f)
 {
 	struct snd_compr_file *data = f->private_data;
 	data->stream.ops->free(&data->stream);
-	kfree(data->stream.runtime->buffer);
+	vfree(data->stream.runtime->buffer);
+	snd_compr_free_status(data->stream.runtime);
 	kfree(data->stream.runtime);
 	kfree(data);
 	return 0;
 }
 
+/* mirror the stream state into the page shared with userspace */
+static inline void snd_compr_update_status(struct snd_compr_stream *stream)
+{
+	struct snd_compr_runtime *runtime = stream->runtime;
+
+	runtime->status->state = runtime->state;
+	runtime->status->hw_pointer = runtime->hw_pointer;
+	runtime->status->total_bytes_transferred =
+		runtime->total_bytes_transferred;
+}
+
 static void snd_compr_update_tstamp(struct snd_compr_stream *stream,
 		struct snd_compr_tstamp *tstamp)
 {
@@ -151,6 +187,7 @@ static void snd_compr_update_tstamp(struct snd_compr_stream *stream,
 		tstamp->byte_offset, tstamp->copied_total);
 	stream->runtime->hw_pointer = tstamp->byte_offset;
 	stream->runtime->total_bytes_transferred = tstamp->copied_total;
+	snd_compr_update_status(stream);
 }
 
 static size_t snd_compr_calc_avail(struct snd_compr_stream *stream,
@@ -160,9 +197,15 @@ static size_t snd_compr_calc_avail(struct snd_compr_stream *stream,
 
 	snd_compr_update_tstamp(stream, &avail->tstamp);
 
-	/* FIXME: This needs to be different for capture stream,
-	   available is # of compressed data, for playback it's
-	   remainder of buffer */
+	/* for capture, available is # of compressed data not yet read */
+	if (stream->direction == SND_COMPRESS_CAPTURE) {
+		avail->avail = stream->runtime->total_bytes_transferred -
+				stream->runtime->total_bytes_available;
+		pr_debug("DSP produced %lld, app read %lld\n",
+				stream->runtime->total_bytes_transferred,
+				stream->runtime->total_bytes_available);
+		return avail->avail;
+	}
 
 	if (stream->runtime->total_bytes_available == 0 &&
 			stream->runtime->state == SNDRV_PCM_STATE_SETUP) {
@@ -203,12 +246,52 @@ static inline size_t snd_compr_get_avail(struct snd_compr_stream *stream)
 	return snd_compr_calc_avail(stream, &avail);
 }
 
+/*
+ * Pick up the application pointer from the mmapped control page and advance
+ * the ring buffer by the bytes produced (playback) or consumed (capture)
+ * since the last call.
+ */
+static int snd_compr_sync_appl_ptr(struct snd_compr_stream *stream)
+{
+	struct snd_compr_runtime *runtime = stream->runtime;
+	u64 bytes;
+
+	bytes = runtime->control->total_bytes_available -
+		runtime->total_bytes_available;
+	if (!bytes)
+		return 0;
+	if (!runtime->buffer_size || (s64)bytes < 0 ||
+			bytes > snd_compr_get_avail(stream)) {
+		pr_debug("invalid application pointer %lld\n",
+				runtime->control->total_bytes_available);
+		return -EINVAL;
+	}
+
+	runtime->app_pointer += bytes;
+	if (runtime->app_pointer >= runtime->buffer_size)
+		runtime->app_pointer -= runtime->buffer_size;
+	runtime->total_bytes_available += bytes;
+
+	/* if DSP cares, let it know data has been written/read */
+	if (stream->ops->ack)
+		stream->ops->ack(stream, bytes);
+
+	if (stream->direction == SND_COMPRESS_PLAYBACK &&
+			runtime->state == SNDRV_PCM_STATE_SETUP)
+		runtime->state = SNDRV_PCM_STATE_PREPARED;
+	return 0;
+}
+
 static int
 snd_compr_ioctl_avail(struct snd_compr_stream *stream, unsigned long arg)
 {
 	struct snd_compr_avail ioctl_avail;
 	size_t avail;
+	int retval;
 
+	retval = snd_compr_sync_appl_ptr(stream);
+	if (retval < 0)
+		return retval;
 	avail = snd_compr_calc_avail(stream, &ioctl_avail);
 	ioctl_avail.avail = avail;
 
@@ -273,11 +356,14 @@ static ssize_t snd_compr_write(struct file *f, const char __user *buf,
 		avail = count;
 
 	if (stream->ops->copy)
-		retval = stream->ops->copy(stream, buf, avail);
+		retval = stream->ops->copy(stream, (char __user *)buf, avail);
 	else
 		retval = snd_compr_write_data(stream, buf, avail);
-	if (retval > 0)
+	if (retval > 0) {
 		stream->runtime->total_bytes_available += retval;
+		stream->runtime->control->total_bytes_available =
+			stream->runtime->total_bytes_available;
+	}
 
 	/* while initiating the stream, write should be called before START
 	 * call, so in setup move state */
@@ -285,21 +371,141 @@ static ssize_t snd_compr_write(struct file *f, const char __user *buf,
 		stream->runtime->state = SNDRV_PCM_STATE_PREPARED;
 		pr_debug("stream prepared, Houston we are good to go\n");
 	}
+	snd_compr_update_status(stream);
 
 	mutex_unlock(&stream->device->lock);
 	return retval;
 }
 
+static int snd_compr_read_data(struct snd_compr_stream *stream,
+	       char __user *buf, size_t count)
+{
+	void *src;
+	size_t copy;
+	struct snd_compr_runtime *runtime = stream->runtime;
+
+	src = runtime->buffer + runtime->app_pointer;
+	pr_debug("copying %ld at %lld\n",
+			(unsigned long)count, runtime->app_pointer);
+	if (count < runtime->buffer_size - runtime->app_pointer) {
+		if (copy_to_user(buf, src, count))
+			return -EFAULT;
+		runtime->app_pointer += count;
+	} else {
+		copy = runtime->buffer_size - runtime->app_pointer;
+		if (copy_to_user(buf, src, copy))
+			return -EFAULT;
+		if (copy_to_user(buf + copy, runtime->buffer, count - copy))
+			return -EFAULT;
+		runtime->app_pointer = count - copy;
+	}
+	/* if DSP cares, let it know data has been read */
+	if (stream->ops->ack)
+		stream->ops->ack(stream, count);
+	return count;
+}
 
 static ssize_t snd_compr_read(struct file *f, char __user *buf,
 		size_t count, loff_t *offset)
 {
-	return -ENXIO;
+	struct snd_compr_file *data = f->private_data;
+	struct snd_compr_stream *stream;
+	size_t avail;
+	int retval;
+
+	if (snd_BUG_ON(!data))
+		return -EFAULT;
+
+	stream = &data->stream;
+	mutex_lock(&stream->device->lock);
+	/* read is allowed when stream is running, paused, or has been stopped
+	 * with encoded data left in the buffer */
+	if (stream->runtime->state != SNDRV_PCM_STATE_SETUP &&
+			stream->runtime->state != SNDRV_PCM_STATE_RUNNING &&
+			stream->runtime->state != SNDRV_PCM_STATE_PAUSED &&
+			stream->runtime->state != SNDRV_PCM_STATE_DRAINING) {
+		retval = -EBADFD;
+		goto out;
+	}
+
+	avail = snd_compr_get_avail(stream);
+	pr_debug("avail returned %ld\n", (unsigned long)avail);
+	/* calculate how much we can read from buffer */
+	if (avail > count)
+		avail = count;
+
+	if (stream->ops->copy)
+		retval = stream->ops->copy(stream, buf, avail);
+	else
+		retval = snd_compr_read_data(stream, buf, avail);
+	if (retval > 0) {
+		stream->runtime->total_bytes_available += retval;
+		stream->runtime->control->total_bytes_available =
+			stream->runtime->total_bytes_available;
+	}
+
+out:
+	mutex_unlock(&stream->device->lock);
+	return retval;
+}
+
+static int snd_compr_mmap_page(struct vm_area_struct *vma, void *page)
+{
+	if (vma->vm_end - vma->vm_start > PAGE_SIZE)
+		return -EINVAL;
+
+	vma->vm_flags |= VM_RESERVED;
+	return remap_pfn_range(vma, vma->vm_start,
+			       page_to_pfn(virt_to_page(page)),
+			       PAGE_SIZE, vma->vm_page_prot);
+}
+
+static int snd_compr_mmap_data(struct snd_compr_stream *stream,
+		struct vm_area_struct *vma)
+{
+	/* the ring buffer exists only once params have been set */
+	if (stream->runtime->state == SNDRV_PCM_STATE_OPEN)
+		return -EBADFD;
+
+	if (stream->ops->mmap)
+		return stream->ops->mmap(stream, vma);
+	if (!stream->runtime->buffer)
+		return -ENXIO;
+
+	return remap_vmalloc_range(vma, stream->runtime->buffer, 0);
 }
 
 static int snd_compr_mmap(struct file *f, struct vm_area_struct *vma)
 {
-	return -ENXIO;
+	struct snd_compr_file *data = f->private_data;
+	struct snd_compr_stream *stream;
+	unsigned long offset;
+	int retval;
+
+	if (snd_BUG_ON(!data))
+		return -EFAULT;
+	stream = &data->stream;
+
+	offset = vma->vm_pgoff << PAGE_SHIFT;
+	mutex_lock(&stream->device->lock);
+	switch (offset) {
+	case SNDRV_COMPRESS_MMAP_OFFSET_STATUS:
+		if (vma->vm_flags & VM_WRITE) {
+			retval = -EINVAL;
+			break;
+		}
+		vma->vm_flags &= ~VM_MAYWRITE;
+		retval = snd_compr_mmap_page(vma, stream->runtime->status);
+		break;
+	case SNDRV_COMPRESS_MMAP_OFFSET_CONTROL:
+		retval = snd_compr_mmap_page(vma, stream->runtime->control);
+		break;
+	default:
+		retval = snd_compr_mmap_data(stream, vma);
+		break;
+	}
+	mutex_unlock(&stream->device->lock);
+	return retval;
 }
 
 static inline int snd_compr_get_poll(struct snd_compr_stream *stream)
@@ -331,6 +537,10 @@ static unsigned int snd_compr_poll(struct file *f, poll_table *wait)
 	}
 	poll_wait(f, &stream->runtime->sleep, wait);
 
+	if (snd_compr_sync_appl_ptr(stream) < 0) {
+		retval = snd_compr_get_poll(stream) | POLLERR;
+		goto out;
+	}
 	avail = snd_compr_get_avail(stream);
 	pr_debug("avail is %ld\n", (unsigned long)avail);
 	/* check if we have at least one fragment to fill */
@@ -341,6 +551,7 @@ static unsigned int snd_compr_poll(struct file *f, poll_table *wait)
 		 */
 		retval = snd_compr_get_poll(stream);
 		stream->runtime->state = SNDRV_PCM_STATE_SETUP;
+		snd_compr_update_status(stream);
 		break;
 	case SNDRV_PCM_STATE_RUNNING:
 	case SNDRV_PCM_STATE_PREPARED:
@@ -416,7 +627,8 @@ static int snd_compr_allocate_buffer(struct snd_compr_stream *stream,
 		 * the data from core
 		 */
 	} else {
-		buffer = kmalloc(buffer_size, GFP_KERNEL);
+		/* vmalloc_user() so that the ring buffer can be mmapped */
+		buffer = vmalloc_user(buffer_size);
 		if (!buffer)
 			return -ENOMEM;
 	}
@@ -525,7 +737,13 @@ static int snd_compr_start(struct snd_compr_stream *stream)
 {
 	int retval;
 
-	if (stream->runtime->state != SNDRV_PCM_STATE_PREPARED)
+	retval = snd_compr_sync_appl_ptr(stream);
+	if (retval < 0)
+		return retval;
+	/* capture streams have nothing to write before start */
+	if (stream->runtime->state != SNDRV_PCM_STATE_PREPARED &&
+			!(stream->direction == SND_COMPRESS_CAPTURE &&
+			  stream->runtime->state == SNDRV_PCM_STATE_SETUP))
 		return -EPERM;
 	retval = stream->ops->trigger(stream, SNDRV_PCM_TRIGGER_START);
 	if (!retval)
@@ -552,6 +770,9 @@ static int snd_compr_drain(struct snd_compr_stream *stream)
 {
 	int retval;
 
+	retval = snd_compr_sync_appl_ptr(stream);
+	if (retval < 0)
+		return retval;
 	if (stream->runtime->state == SNDRV_PCM_STATE_PREPARED ||
 			stream->runtime->state == SNDRV_PCM_STATE_SETUP)
 		return -EPERM;
@@ -614,6 +835,7 @@ static long snd_compr_ioctl(struct file *f, unsigned int cmd, unsigned long arg)
 		retval = snd_compr_drain(stream);
 		break;
 	}
+	snd_compr_update_status(stream);
 	mutex_unlock(&stream->device->lock);
 	return retval;
 }
@@ -25,6 +25,8 @@
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
 #include <linux/time.h>
+#include <linux/jhash.h>
+#include <linux/radix-tree.h>
 #include <sound/core.h>
 #include <sound/minors.h>
 #include <sound/info.h>
@@ -33,6 +35,8 @@
 /* max number of user-defined controls */
 #define MAX_USER_CONTROLS	32
 #define MAX_CONTROL_COUNT	1028
+/* max number of values per multi read/write ioctl */
+#define MAX_MULTI_VALUES	512
 
 struct snd_kctl_ioctl {
 	struct list_head list;		/* list of all ioctls */
@@ -280,18 +284,112 @@ void snd_ctl_free_one(struct snd_kcontrol *kcontrol)
 
 EXPORT_SYMBOL(snd_ctl_free_one);
 
-static bool snd_ctl_remove_numid_conflict(struct snd_card *card,
-					  unsigned int count)
+/*
+ * Controls are indexed twice: card->ctl_hash chains them by
+ * (iface, device, subdevice, name), and card->ctl_numids maps every
+ * numid a control occupies back to the control.  The index field is
+ * left out of the hash since one control covers a range of indices;
+ * the chain walk compares the range instead.
+ *
+ * Some drivers still change the id of a control after adding it, which
+ * leaves the control chained under its old id.  snd_ctl_find_id() falls
+ * back to walking the control list when the hash misses, which keeps the
+ * duplicate check in snd_ctl_add() exact, and all controls are hashed
+ * again once the card is registered.
+ */
+static unsigned int snd_ctl_hash_id(const struct snd_ctl_elem_id *id)
+{
+	u32 h;
+
+	h = jhash(id->name, strnlen(id->name, sizeof(id->name)), 0);
+	h = jhash_3words(id->iface, id->device, id->subdevice, h);
+	return h & (SNDRV_CTL_HASH_SIZE - 1);
+}
+
+static bool snd_ctl_id_match(struct snd_kcontrol *kctl,
+			     struct snd_ctl_elem_id *id)
+{
+	if (kctl->id.iface != id->iface)
+		return false;
+	if (kctl->id.device != id->device)
+		return false;
+	if (kctl->id.subdevice != id->subdevice)
+		return false;
+	if (strncmp(kctl->id.name, id->name, sizeof(kctl->id.name)))
+		return false;
+	if (kctl->id.index > id->index)
+		return false;
+	if (kctl->id.index + kctl->count <= id->index)
+		return false;
+	return true;
+}
+
+/* look up the id in the hash only, see snd_ctl_hash_id() */
+static struct snd_kcontrol *snd_ctl_find_hashed(struct snd_card *card,
+						struct snd_ctl_elem_id *id)
+{
+	struct snd_kcontrol *kctl;
+	struct hlist_node *pos;
+
+	hlist_for_each_entry(kctl, pos, &card->ctl_hash[snd_ctl_hash_id(id)],
+			     hash) {
+		if (snd_ctl_id_match(kctl, id))
+			return kctl;
+	}
+	return NULL;
+}
+
+static void snd_ctl_rehash(struct snd_card *card)
 {
 	struct snd_kcontrol *kctl;
 
 	list_for_each_entry(kctl, &card->controls, list) {
-		if (kctl->id.numid < card->last_numid + 1 + count &&
-		    kctl->id.numid + kctl->count > card->last_numid + 1) {
-		    	card->last_numid = kctl->id.numid + kctl->count - 1;
-			return true;
+		hlist_del(&kctl->hash);
+		hlist_add_head(&kctl->hash,
+			       &card->ctl_hash[snd_ctl_hash_id(&kctl->id)]);
+	}
+}
+
+static int snd_ctl_numid_insert(struct snd_card *card,
+				struct snd_kcontrol *kctl, unsigned int numid)
+{
+	unsigned int idx;
+	int err;
+
+	for (idx = 0; idx < kctl->count; idx++) {
+		err = radix_tree_insert(&card->ctl_numids, numid + idx, kctl);
+		if (err < 0) {
+			while (idx--)
+				radix_tree_delete(&card->ctl_numids, numid + idx);
+			return err;
 		}
 	}
+	return 0;
+}
+
+static void snd_ctl_numid_delete(struct snd_card *card,
+				 struct snd_kcontrol *kctl)
+{
+	unsigned int idx;
+
+	for (idx = 0; idx < kctl->count; idx++)
+		radix_tree_delete(&card->ctl_numids, kctl->id.numid + idx);
+}
+
+static bool snd_ctl_remove_numid_conflict(struct snd_card *card,
+					  unsigned int count)
+{
+	struct snd_kcontrol *kctl;
+
+	/* the first control at or above the wanted range decides */
+	if (!radix_tree_gang_lookup(&card->ctl_numids, (void **)&kctl,
+				    card->last_numid + 1, 1))
+		return false;
+	if (kctl->id.numid < card->last_numid + 1 + count &&
+	    kctl->id.numid + kctl->count > card->last_numid + 1) {
+		card->last_numid = kctl->id.numid + kctl->count - 1;
+		return true;
+	}
 	return false;
 }
 
@@ -309,6 +407,26 @@ static int snd_ctl_find_hole(struct snd_card *card, unsigned int count)
 	return 0;
 }
 
+/* link a new control into the card; controls_rwsem held for writing */
+static int __snd_ctl_add(struct snd_card *card, struct snd_kcontrol *kcontrol)
+{
+	int err;
+
+	err = snd_ctl_find_hole(card, kcontrol->count);
+	if (err < 0)
+		return err;
+	err = snd_ctl_numid_insert(card, kcontrol, card->last_numid + 1);
+	if (err < 0)
+		return err;
+	list_add_tail(&kcontrol->list, &card->controls);
+	hlist_add_head(&kcontrol->hash,
+		       &card->ctl_hash[snd_ctl_hash_id(&kcontrol->id)]);
+	card->controls_count += kcontrol->count;
+	kcontrol->id.numid = card->last_numid + 1;
+	card->last_numid += kcontrol->count;
+	return 0;
+}
+
 /**
  * snd_ctl_add - add the control instance to the card
  * @card: the card instance
@@ -345,15 +463,12 @@ int snd_ctl_add(struct snd_card *card, struct snd_kcontrol *kcontrol)
 		err = -EBUSY;
 		goto error;
 	}
-	if (snd_ctl_find_hole(card, kcontrol->count) < 0) {
+	if (__snd_ctl_add(card, kcontrol) < 0) {
 		up_write(&card->controls_rwsem);
 		err = -ENOMEM;
 		goto error;
 	}
-	list_add_tail(&kcontrol->list, &card->controls);
-	card->controls_count += kcontrol->count;
-	kcontrol->id.numid = card->last_numid + 1;
-	card->last_numid += kcontrol->count;
+	id.numid = kcontrol->id.numid;
 	up_write(&card->controls_rwsem);
 	for (idx = 0; idx < kcontrol->count; idx++, id.index++, id.numid++)
 		snd_ctl_notify(card, SNDRV_CTL_EVENT_MASK_ADD, &id);
@@ -410,15 +525,12 @@ int snd_ctl_replace(struct snd_card *card, struct snd_kcontrol *kcontrol,
 		goto error;
 	}
 add:
-	if (snd_ctl_find_hole(card, kcontrol->count) < 0) {
+	if (__snd_ctl_add(card, kcontrol) < 0) {
 		up_write(&card->controls_rwsem);
 		ret = -ENOMEM;
 		goto error;
 	}
-	list_add_tail(&kcontrol->list, &card->controls);
-	card->controls_count += kcontrol->count;
-	kcontrol->id.numid = card->last_numid + 1;
-	card->last_numid += kcontrol->count;
+	id.numid = kcontrol->id.numid;
 	up_write(&card->controls_rwsem);
 	for (idx = 0; idx < kcontrol->count; idx++, id.index++, id.numid++)
 		snd_ctl_notify(card, SNDRV_CTL_EVENT_MASK_ADD, &id);
@@ -449,6 +561,8 @@ int snd_ctl_remove(struct snd_card *card, struct snd_kcontrol *kcontrol)
 	if (snd_BUG_ON(!card || !kcontrol))
 		return -EINVAL;
 	list_del(&kcontrol->list);
+	hlist_del(&kcontrol->hash);
+	snd_ctl_numid_delete(card, kcontrol);
 	card->controls_count -= kcontrol->count;
 	id = kcontrol->id;
 	for (idx = 0; idx < kcontrol->count; idx++, id.index++, id.numid++)
@@ -589,6 +703,7 @@ int snd_ctl_rename_id(struct snd_card *card, struct snd_ctl_elem_id *src_id,
 		      struct snd_ctl_elem_id *dst_id)
 {
 	struct snd_kcontrol *kctl;
+	int err;
 
 	down_write(&card->controls_rwsem);
 	kctl = snd_ctl_find_id(card, src_id);
@@ -596,9 +711,20 @@ int snd_ctl_rename_id(struct snd_card *card, struct snd_ctl_elem_id *src_id,
 		up_write(&card->controls_rwsem);
 		return -ENOENT;
 	}
+	/* map the new numids before dropping the old ones */
+	err = snd_ctl_find_hole(card, kctl->count);
+	if (err >= 0)
+		err = snd_ctl_numid_insert(card, kctl, card->last_numid + 1);
+	if (err < 0) {
+		up_write(&card->controls_rwsem);
+		return err;
+	}
+	snd_ctl_numid_delete(card, kctl);
+	hlist_del(&kctl->hash);
 	kctl->id = *dst_id;
 	kctl->id.numid = card->last_numid + 1;
 	card->last_numid += kctl->count;
+	hlist_add_head(&kctl->hash, &card->ctl_hash[snd_ctl_hash_id(&kctl->id)]);
 	up_write(&card->controls_rwsem);
 	return 0;
 }
@@ -619,15 +745,9 @@ EXPORT_SYMBOL(snd_ctl_rename_id);
  */
 struct snd_kcontrol *snd_ctl_find_numid(struct snd_card *card, unsigned int numid)
 {
-	struct snd_kcontrol *kctl;
-
 	if (snd_BUG_ON(!card || !numid))
 		return NULL;
-	list_for_each_entry(kctl, &card->controls, list) {
-		if (kctl->id.numid <= numid && kctl->id.numid + kctl->count > numid)
-			return kctl;
-	}
-	return NULL;
+	return radix_tree_lookup(&card->ctl_numids, numid);
 }
 
 EXPORT_SYMBOL(snd_ctl_find_numid);
@@ -653,20 +773,13 @@ struct snd_kcontrol *snd_ctl_find_id(struct snd_card *card,
 		return NULL;
 	if (id->numid != 0)
 		return snd_ctl_find_numid(card, id->numid);
-	list_for_each_entry(kctl, &card->controls, list) {
-		if (kctl->id.iface != id->iface)
-			continue;
-		if (kctl->id.device != id->device)
-			continue;
-		if (kctl->id.subdevice != id->subdevice)
-			continue;
-		if (strncmp(kctl->id.name, id->name, sizeof(kctl->id.name)))
-			continue;
-		if (kctl->id.index > id->index)
-			continue;
-		if (kctl->id.index + kctl->count <= id->index)
-			continue;
+	kctl = snd_ctl_find_hashed(card, id);
+	if (kctl)
 		return kctl;
+	/* the id may have been changed after the control was added */
+	list_for_each_entry(kctl, &card->controls, list) {
+		if (snd_ctl_id_match(kctl, id))
+			return kctl;
 	}
 	return NULL;
 }
@@ -819,15 +932,15 @@ static int snd_ctl_elem_info_user(struct snd_ctl_file *ctl,
 	return result;
 }
 
-static int snd_ctl_elem_read(struct snd_card *card,
-			     struct snd_ctl_elem_value *control)
+/* the caller must down card->controls_rwsem */
+static int __snd_ctl_elem_read(struct snd_card *card,
+			       struct snd_ctl_elem_value *control)
 {
 	struct snd_kcontrol *kctl;
 	struct snd_kcontrol_volatile *vd;
 	unsigned int index_offset;
 	int result;
 
-	down_read(&card->controls_rwsem);
 	kctl = snd_ctl_find_id(card, &control->id);
 	if (kctl == NULL) {
 		result = -ENOENT;
@@ -841,6 +954,16 @@ static int snd_ctl_elem_read(struct snd_card *card,
 		} else
 			result = -EPERM;
 	}
+	return result;
+}
+
+static int snd_ctl_elem_read(struct snd_card *card,
+			     struct snd_ctl_elem_value *control)
+{
+	int result;
+
+	down_read(&card->controls_rwsem);
+	result = __snd_ctl_elem_read(card, control);
 	up_read(&card->controls_rwsem);
 	return result;
 }
@@ -867,15 +990,16 @@ static int snd_ctl_elem_read_user(struct snd_card *card,
 	return result;
 }
 
-static int snd_ctl_elem_write(struct snd_card *card, struct snd_ctl_file *file,
-			      struct snd_ctl_elem_value *control)
+/* the caller must down card->controls_rwsem */
+static int __snd_ctl_elem_write(struct snd_card *card,
+				struct snd_ctl_file *file,
+				struct snd_ctl_elem_value *control)
 {
 	struct snd_kcontrol *kctl;
 	struct snd_kcontrol_volatile *vd;
 	unsigned int index_offset;
 	int result;
 
-	down_read(&card->controls_rwsem);
 	kctl = snd_ctl_find_id(card, &control->id);
 	if (kctl == NULL) {
 		result = -ENOENT;
@@ -891,12 +1015,21 @@ static int snd_ctl_elem_write(struct snd_card *card, struct snd_ctl_file *file,
 			result = kctl->put(kctl, control);
 		}
 		if (result > 0) {
-			up_read(&card->controls_rwsem);
 			snd_ctl_notify(card, SNDRV_CTL_EVENT_MASK_VALUE,
 				       &control->id);
 			return 0;
 		}
 	}
+	return result;
+}
+
+static int snd_ctl_elem_write(struct snd_card *card, struct snd_ctl_file *file,
+			      struct snd_ctl_elem_value *control)
+{
+	int result;
+
+	down_read(&card->controls_rwsem);
+	result = __snd_ctl_elem_write(card, file, control);
 	up_read(&card->controls_rwsem);
 	return result;
 }
@@ -925,6 +1058,79 @@ static int snd_ctl_elem_write_user(struct snd_ctl_file *file,
 	return result;
 }
 
+/*
+ * Read or write a batch of values under a single controls_rwsem hold.
+ * Processing stops at the first failing element; *done tells the
+ * caller how many elements were handled before that.
+ */
+static int snd_ctl_elem_multi(struct snd_ctl_file *file,
+			      struct snd_ctl_elem_value *controls,
+			      unsigned int count, unsigned int *done,
+			      int write)
+{
+	struct snd_card *card = file->card;
+	unsigned int i;
+	int result;
+
+	*done = 0;
+	snd_power_lock(card);
+	result = snd_power_wait(card, SNDRV_CTL_POWER_D0);
+	if (result < 0)
+		goto unlock;
+	down_read(&card->controls_rwsem);
+	for (i = 0; i < count; i++) {
+		if (write)
+			result = __snd_ctl_elem_write(card, file, &controls[i]);
+		else
+			result = __snd_ctl_elem_read(card, &controls[i]);
+		if (result < 0)
+			break;
+		(*done)++;
+	}
+	up_read(&card->controls_rwsem);
+ unlock:
+	snd_power_unlock(card);
+	return result;
+}
+
+static int snd_ctl_elem_multi_user(struct snd_ctl_file *file,
+				   struct snd_ctl_elem_values __user *_values,
+				   int write)
+{
+	struct snd_ctl_elem_values values;
+	struct snd_ctl_elem_value *controls;
+	size_t size;
+	int result = 0;
+
+	if (copy_from_user(&values, _values, sizeof(values)))
+		return -EFAULT;
+	if (values.count > MAX_MULTI_VALUES)
+		return -EINVAL;
+	values.done = 0;
+	if (values.count == 0)
+		goto done;
+	size = values.count * sizeof(*controls);
+	controls = vmalloc(size);
+	if (controls == NULL)
+		return -ENOMEM;
+	if (copy_from_user(controls, values.pvalues, size)) {
+		vfree(controls);
+		return -EFAULT;
+	}
+	result = snd_ctl_elem_multi(file, controls, values.count,
+				    &values.done, write);
+	if (values.done &&
+	    copy_to_user(values.pvalues, controls,
+			 values.done * sizeof(*controls)))
+		result = -EFAULT;
+	vfree(controls);
+ done:
+	/* report the progress also along with an error */
+	if (put_user(values.done, &_values->done))
+		return -EFAULT;
+	return result < 0 ? result : 0;
+}
+
 static int snd_ctl_elem_lock(struct snd_ctl_file *file,
 			     struct snd_ctl_elem_id __user *_id)
 {
@@ -1363,6 +1569,10 @@ static long snd_ctl_ioctl(struct file *file, unsigned int cmd, unsigned long arg
 		return snd_ctl_elem_read_user(card, argp);
 	case SNDRV_CTL_IOCTL_ELEM_WRITE:
 		return snd_ctl_elem_write_user(ctl, argp);
+	case SNDRV_CTL_IOCTL_ELEM_READ_MULTI:
+		return snd_ctl_elem_multi_user(ctl, argp, 0);
+	case SNDRV_CTL_IOCTL_ELEM_WRITE_MULTI:
+		return snd_ctl_elem_multi_user(ctl, argp, 1);
 	case SNDRV_CTL_IOCTL_ELEM_LOCK:
 		return snd_ctl_elem_lock(ctl, argp);
 	case SNDRV_CTL_IOCTL_ELEM_UNLOCK:
@@ -1598,6 +1808,10 @@ static int snd_ctl_dev_register(struct snd_device *device)
 	cardnum = card->number;
 	if (snd_BUG_ON(cardnum < 0 || cardnum >= SNDRV_CARDS))
 		return -ENXIO;
+	/* pick up ids changed by the driver after adding the controls */
+	down_write(&card->controls_rwsem);
+	snd_ctl_rehash(card);
+	up_write(&card->controls_rwsem);
 	sprintf(name, "controlC%i", cardnum);
 	if ((err = snd_register_device(SNDRV_DEVICE_TYPE_CONTROL, card, -1,
 				       &snd_ctl_f_ops, card, name)) < 0)
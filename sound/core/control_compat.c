@@ -335,6 +335,68 @@ static int snd_ctl_elem_write_user_compat(struct snd_ctl_file *file,
 	return err;
 }
 
+/* multi read / write */
+struct snd_ctl_elem_values32 {
+	u32 count;
+	u32 done;
+	u32 pvalues;
+	unsigned char reserved[48];
+};
+
+struct snd_ctl_elem_type_compat {
+	int type;
+	int count;
+};
+
+static int snd_ctl_elem_multi_user_compat(struct snd_ctl_file *file,
+				struct snd_ctl_elem_values32 __user *values32,
+				int write)
+{
+	struct snd_ctl_elem_value32 __user *data32;
+	struct snd_ctl_elem_type_compat *types;
+	struct snd_ctl_elem_value *data;
+	unsigned int i, count, done = 0;
+	u32 ptr;
+	int err = 0;
+
+	if (get_user(count, &values32->count) ||
+	    get_user(ptr, &values32->pvalues))
+		return -EFAULT;
+	if (count > MAX_MULTI_VALUES)
+		return -EINVAL;
+	if (count == 0)
+		goto out;
+	data32 = compat_ptr(ptr);
+	types = kcalloc(count, sizeof(*types), GFP_KERNEL);
+	data = vzalloc(count * sizeof(*data));
+	if (types == NULL || data == NULL) {
+		err = -ENOMEM;
+		goto error;
+	}
+	for (i = 0; i < count; i++) {
+		err = copy_ctl_value_from_user(file->card, &data[i],
+					       &data32[i], &types[i].type,
+					       &types[i].count);
+		if (err < 0)
+			goto error;
+	}
+	err = snd_ctl_elem_multi(file, data, count, &done, write);
+	for (i = 0; i < done; i++) {
+		if (copy_ctl_value_to_user(&data32[i], &data[i],
+					   types[i].type, types[i].count)) {
+			err = -EFAULT;
+			break;
+		}
+	}
+ error:
+	vfree(data);
+	kfree(types);
+ out:
+	if (put_user(done, &values32->done))
+		return -EFAULT;
+	return err < 0 ? err : 0;
+}
+
 /* add or replace a user control */
 static int snd_ctl_elem_add_compat(struct snd_ctl_file *file,
 				   struct snd_ctl_elem_info32 __user *data32,
@@ -393,6 +455,8 @@ enum {
 	SNDRV_CTL_IOCTL_ELEM_WRITE32 = _IOWR('U', 0x13, struct snd_ctl_elem_value32),
 	SNDRV_CTL_IOCTL_ELEM_ADD32 = _IOWR('U', 0x17, struct snd_ctl_elem_info32),
 	SNDRV_CTL_IOCTL_ELEM_REPLACE32 = _IOWR('U', 0x18, struct snd_ctl_elem_info32),
+	SNDRV_CTL_IOCTL_ELEM_READ_MULTI32 = _IOWR('U', 0x1d, struct snd_ctl_elem_values32),
+	SNDRV_CTL_IOCTL_ELEM_WRITE_MULTI32 = _IOWR('U', 0x1e, struct snd_ctl_elem_values32),
 };
 
 static inline long snd_ctl_ioctl_compat(struct file *file, unsigned int cmd, unsigned long arg)
@@ -431,6 +495,10 @@ static inline long snd_ctl_ioctl_compat(struct file *file, unsigned int cmd, uns
 		return snd_ctl_elem_add_compat(ctl, argp, 0);
 	case SNDRV_CTL_IOCTL_ELEM_REPLACE32:
 		return snd_ctl_elem_add_compat(ctl, argp, 1);
+	case SNDRV_CTL_IOCTL_ELEM_READ_MULTI32:
+		return snd_ctl_elem_multi_user_compat(ctl, argp, 0);
+	case SNDRV_CTL_IOCTL_ELEM_WRITE_MULTI32:
+		return snd_ctl_elem_multi_user_compat(ctl, argp, 1);
 	}
 
 	down_read(&snd_ioctl_rwsem);
@@ -208,6 +208,7 @@ int snd_card_create(int idx, const char *xid,
 	init_rwsem(&card->controls_rwsem);
 	rwlock_init(&card->ctl_files_rwlock);
 	INIT_LIST_HEAD(&card->controls);
+	INIT_RADIX_TREE(&card->ctl_numids, GFP_KERNEL);
 	INIT_LIST_HEAD(&card->ctl_files);
 	spin_lock_init(&card->files_lock);
 	INIT_LIST_HEAD(&card->files_list);
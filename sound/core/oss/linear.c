@@ -37,6 +37,7 @@ struct linear_priv {
 	unsigned int dst_bytes;		/* byte size of destination format */
 	unsigned int copy_bytes;	/* bytes to copy per conversion */
 	unsigned int flip; /* MSB flip for signeness, done after endian conv */
+	int s16_s32;	/* CPU-endian S16 <-> S32: 1 widen, -1 narrow */
 };
 
 static inline void do_convert(struct linear_priv *data,
@@ -76,6 +77,20 @@ static void convert(struct snd_pcm_plugin *plugin,
 		dst = dst_channels[channel].area.addr + dst_channels[channel].area.first / 8;
 		src_step = src_channels[channel].area.step / 8;
 		dst_step = dst_channels[channel].area.step / 8;
+		if (data->s16_s32 > 0 &&
+		    !(((unsigned long)src | src_step) & 1) &&
+		    !(((unsigned long)dst | dst_step) & 3)) {
+			snd_pcm_s16_to_s32((s32 *)dst, dst_step / 4,
+					   (s16 *)src, src_step / 2, frames);
+			continue;
+		}
+		if (data->s16_s32 < 0 &&
+		    !(((unsigned long)src | src_step) & 3) &&
+		    !(((unsigned long)dst | dst_step) & 1)) {
+			snd_pcm_s32_to_s16((s16 *)dst, dst_step / 2,
+					   (s32 *)src, src_step / 4, frames);
+			continue;
+		}
 		frames1 = frames;
 		while (frames1-- > 0) {
 			do_convert(data, dst, src);
@@ -142,6 +157,12 @@ static void init_data(struct linear_priv *data,
 		else
 			data->flip = (__force u32)cpu_to_be32(0x80000000);
 	}
+	if (src_format == SNDRV_PCM_FORMAT_S16 &&
+	    dst_format == SNDRV_PCM_FORMAT_S32)
+		data->s16_s32 = 1;
+	else if (src_format == SNDRV_PCM_FORMAT_S32 &&
+		 dst_format == SNDRV_PCM_FORMAT_S16)
+		data->s16_s32 = -1;
 }
 
 int snd_pcm_plugin_build_linear(struct snd_pcm_substream *plug,
@@ -681,11 +681,8 @@ int snd_pcm_area_silence(const struct snd_pcm_channel_area *dst_area, size_t dst
 			}
 		}
 	} else {
-		width /= 8;
-		while (samples-- > 0) {
-			memcpy(dst, silence, width);
-			dst += dst_step;
-		}
+		snd_pcm_sample_copy(dst, dst_step, silence, 0, width / 8,
+				    samples);
 	}
 	return 0;
 }
@@ -745,12 +742,8 @@ int snd_pcm_area_copy(const struct snd_pcm_channel_area *src_area, size_t src_of
 			}
 		}
 	} else {
-		width /= 8;
-		while (samples-- > 0) {
-			memcpy(dst, src, width);
-			src += src_step;
-			dst += dst_step;
-		}
+		snd_pcm_sample_copy(dst, dst_step, src, src_step, width / 8,
+				    samples);
 	}
 	return 0;
 }
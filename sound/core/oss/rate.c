@@ -20,6 +20,8 @@
  */
   
 #include <linux/time.h>
+#include <linux/slab.h>
+#include <linux/math64.h>
 #include <sound/core.h>
 #include <sound/pcm.h>
 #include "pcm_plugin.h"
@@ -28,6 +30,14 @@
 #define BITS	(1<<SHIFT)
 #define R_MASK	(BITS-1)
 
+/* polyphase filter: HQ_PHASES sub-sample positions of HQ_TAPS taps */
+#define HQ_PHASE_BITS	8
+#define HQ_PHASES	(1 << HQ_PHASE_BITS)
+#define HQ_TAPS		32
+#define HQ_FRAC_BITS	16
+#define HQ_ONE		(1 << HQ_FRAC_BITS)
+#define HQ_COEF_SHIFT	14
+
 /*
  *  Basic rate conversion plugin
  */
@@ -35,6 +45,8 @@
 struct rate_channel {
 	signed short last_S1;
 	signed short last_S2;
+	/* polyphase history, stored twice to keep the window contiguous */
+	signed short hist[2 * HQ_TAPS];
 };
  
 typedef void (*rate_f)(struct snd_pcm_plugin *plugin,
@@ -46,6 +58,9 @@ struct rate_priv {
 	unsigned int pitch;
 	unsigned int pos;
 	rate_f func;
+	signed short *coef;		/* polyphase table, HQ_PHASES rows */
+	unsigned int hq_pos;		/* HQ_FRAC_BITS fraction of input */
+	unsigned int hq_head;		/* oldest sample in hist[] */
 	snd_pcm_sframes_t old_src_frames, old_dst_frames;
 	struct rate_channel channels[0];
 };
@@ -55,9 +70,13 @@ static void rate_init(struct snd_pcm_plugin *plugin)
 	unsigned int channel;
 	struct rate_priv *data = (struct rate_priv *)plugin->extra_data;
 	data->pos = 0;
+	data->hq_pos = 0;
+	data->hq_head = 0;
 	for (channel = 0; channel < plugin->src_format.channels; channel++) {
 		data->channels[channel].last_S1 = 0;
 		data->channels[channel].last_S2 = 0;
+		memset(data->channels[channel].hist, 0,
+		       sizeof(data->channels[channel].hist));
 	}
 }
 
@@ -180,6 +199,176 @@ static void resample_shrink(struct snd_pcm_plugin *plugin,
 	data->pos = pos;
 }
 
+/*
+ *  Polyphase FIR rate conversion
+ *
+ *  The filter is a Blackman windowed sinc, computed in fixed point at
+ *  plugin build time.  Each output frame picks the row of HQ_TAPS
+ *  coefficients nearest to its sub-sample position and runs it over
+ *  the last HQ_TAPS input samples of the channel.
+ */
+
+/* sine of an angle given in 1/2^32 turns, Q30 */
+static s32 rate_sin(u32 turn)
+{
+	unsigned int quad = turn >> 30;
+	s64 x = turn & 0x3fffffff;
+	s64 r, r2, term, sum;
+
+	if (quad & 1)
+		x = 0x40000000 - x;
+	r = (x * 1686629713LL) >> 30;	/* x * pi/2, Q30 */
+	r2 = (r * r) >> 30;
+	sum = term = r;
+	term = -div_s64((term * r2) >> 30, 6);
+	sum += term;
+	term = -div_s64((term * r2) >> 30, 20);
+	sum += term;
+	term = -div_s64((term * r2) >> 30, 42);
+	sum += term;
+	term = -div_s64((term * r2) >> 30, 72);
+	sum += term;
+	if (sum > 0x40000000)
+		sum = 0x40000000;
+	return quad & 2 ? -sum : sum;
+}
+
+static inline s32 rate_cos(u32 turn)
+{
+	return rate_sin(turn + 0x40000000);
+}
+
+static signed short *rate_build_coef(unsigned int src_rate,
+				     unsigned int dst_rate)
+{
+	signed short *coef;
+	s64 h[HQ_TAPS], sum;
+	unsigned int fc, phase, k;
+
+	coef = kmalloc(HQ_PHASES * HQ_TAPS * sizeof(*coef), GFP_KERNEL);
+	if (!coef)
+		return NULL;
+	/* cutoff relative to the input nyquist in Q16, with some roll-off */
+	fc = HQ_ONE;
+	if (dst_rate < src_rate)
+		fc = div_u64((u64)dst_rate << HQ_FRAC_BITS, src_rate);
+	fc = fc * 15 / 16;
+
+	for (phase = 0; phase < HQ_PHASES; phase++) {
+		sum = 0;
+		for (k = 0; k < HQ_TAPS; k++) {
+			/* distance from the output position in 1/HQ_PHASES */
+			s64 dn = (s64)(k - (HQ_TAPS / 2 - 1)) * HQ_PHASES - phase;
+			s64 sinc, win, pix;
+
+			if (dn) {
+				/* sin(pi * x) / (pi * x), x = fc * dn */
+				pix = (3373259426LL * fc * dn) >> 30;
+				sinc = div64_s64((s64)rate_sin((u32)(fc * dn << 7)) << 24,
+						 pix);
+			} else {
+				sinc = 0x40000000;
+			}
+			win = 450971566 +	/* 0.42 */
+			      rate_cos((u32)(dn << 19)) / 2 +
+			      div_s64((s64)rate_cos((u32)(dn << 20)) * 2, 25);
+			h[k] = (sinc * win) >> 30;
+			sum += h[k];
+		}
+		/* unity gain for every phase */
+		for (k = 0; k < HQ_TAPS; k++)
+			coef[phase * HQ_TAPS + k] =
+				div64_s64(h[k] << HQ_COEF_SHIFT, sum);
+	}
+	return coef;
+}
+
+static inline void resample_push(signed short *hist, unsigned int *head,
+				 signed short val)
+{
+	hist[*head] = hist[*head + HQ_TAPS] = val;
+	*head = (*head + 1) & (HQ_TAPS - 1);
+}
+
+static void resample_polyphase(struct snd_pcm_plugin *plugin,
+			       const struct snd_pcm_plugin_channel *src_channels,
+			       struct snd_pcm_plugin_channel *dst_channels,
+			       int src_frames, int dst_frames)
+{
+	unsigned int pos = 0, head = 0, step;
+	signed int val;
+	signed short *src, *dst, *hist;
+	const signed short *coef, *win;
+	unsigned int channel, k;
+	int src_step, dst_step;
+	int src_frames1, dst_frames1;
+	struct rate_priv *data = (struct rate_priv *)plugin->extra_data;
+	struct rate_channel *rchannels = data->channels;
+
+	if (dst_frames <= 0)
+		return;
+	/* consume exactly the frames the plugin chain accounted for */
+	step = div_u64((u64)src_frames << HQ_FRAC_BITS, dst_frames);
+
+	for (channel = 0; channel < plugin->src_format.channels; channel++, rchannels++) {
+		pos = data->hq_pos;
+		head = data->hq_head;
+		if (!src_channels[channel].enabled) {
+			if (dst_channels[channel].wanted)
+				snd_pcm_area_silence(&dst_channels[channel].area, 0, dst_frames, plugin->dst_format.format);
+			dst_channels[channel].enabled = 0;
+			continue;
+		}
+		dst_channels[channel].enabled = 1;
+		src = (signed short *)src_channels[channel].area.addr +
+			src_channels[channel].area.first / 8 / 2;
+		dst = (signed short *)dst_channels[channel].area.addr +
+			dst_channels[channel].area.first / 8 / 2;
+		src_step = src_channels[channel].area.step / 8 / 2;
+		dst_step = dst_channels[channel].area.step / 8 / 2;
+		hist = rchannels->hist;
+		src_frames1 = src_frames;
+		dst_frames1 = dst_frames;
+		while (dst_frames1-- > 0) {
+			coef = data->coef +
+				(pos >> (HQ_FRAC_BITS - HQ_PHASE_BITS)) * HQ_TAPS;
+			win = hist + head;
+			val = 0;
+			for (k = 0; k < HQ_TAPS; k += 4)
+				val += coef[k] * win[k] +
+				       coef[k + 1] * win[k + 1] +
+				       coef[k + 2] * win[k + 2] +
+				       coef[k + 3] * win[k + 3];
+			val = (val + (1 << (HQ_COEF_SHIFT - 1))) >> HQ_COEF_SHIFT;
+			if (val < -32768)
+				val = -32768;
+			else if (val > 32767)
+				val = 32767;
+			*dst = val;
+			dst += dst_step;
+			pos += step;
+			while (pos >= HQ_ONE) {
+				pos -= HQ_ONE;
+				if (src_frames1-- > 0) {
+					resample_push(hist, &head, *src);
+					src += src_step;
+				} else {
+					resample_push(hist, &head,
+						      hist[head + HQ_TAPS - 1]);
+				}
+			}
+		}
+		/* rounding of step may leave the last frame unconsumed */
+		while (src_frames1-- > 0) {
+			resample_push(hist, &head, *src);
+			src += src_step;
+			pos = 0;
+		}
+	}
+	data->hq_pos = pos;
+	data->hq_head = head;
+}
+
 static snd_pcm_sframes_t rate_src_frames(struct snd_pcm_plugin *plugin, snd_pcm_uframes_t frames)
 {
 	struct rate_priv *data;
@@ -297,6 +486,13 @@ static int rate_action(struct snd_pcm_plugin *plugin,
 	return 0;	/* silenty ignore other actions */
 }
 
+static void rate_private_free(struct snd_pcm_plugin *plugin)
+{
+	struct rate_priv *data = (struct rate_priv *)plugin->extra_data;
+
+	kfree(data->coef);
+}
+
 int snd_pcm_plugin_build_rate(struct snd_pcm_substream *plug,
 			      struct snd_pcm_plugin_format *src_format,
 			      struct snd_pcm_plugin_format *dst_format,
@@ -336,6 +532,13 @@ int snd_pcm_plugin_build_rate(struct snd_pcm_substream *plug,
 		data->pitch = ((dst_format->rate << SHIFT) + (src_format->rate >> 1)) / src_format->rate;
 		data->func = resample_shrink;
 	}
+	if (plug->oss.setup.hqrate) {
+		data->coef = rate_build_coef(src_format->rate, dst_format->rate);
+		if (data->coef) {
+			data->func = resample_polyphase;
+			plugin->private_free = rate_private_free;
+		}
+	}
 	data->pos = 0;
 	rate_init(plugin);
 	data->old_src_frames = data->old_dst_frames = 0;
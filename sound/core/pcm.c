@@ -469,6 +469,50 @@ static void snd_pcm_substream_proc_status_read(struct snd_info_entry *entry,
 	mutex_unlock(&substream->pcm->open_mutex);
 }
 
+static void snd_pcm_proc_print_hist(struct snd_info_buffer *buffer,
+				    const char *title,
+				    const unsigned int *hist, unsigned int max)
+{
+	int i;
+
+	snd_iprintf(buffer, "%s (us):\n", title);
+	snd_iprintf(buffer, "  <1     : %u\n", hist[0]);
+	for (i = 1; i < SNDRV_PCM_HIST_BUCKETS - 1; i++)
+		snd_iprintf(buffer, "  <%-6u: %u\n", 1 << i, hist[i]);
+	snd_iprintf(buffer, "  >=%-5u: %u\n",
+		    1 << (SNDRV_PCM_HIST_BUCKETS - 2), hist[i]);
+	snd_iprintf(buffer, "  max    : %u\n", max);
+}
+
+static void snd_pcm_substream_proc_latency_read(struct snd_info_entry *entry,
+						struct snd_info_buffer *buffer)
+{
+	struct snd_pcm_substream *substream = entry->private_data;
+	struct snd_pcm_latency_hist hist;
+
+	snd_pcm_stream_lock_irq(substream);
+	hist = substream->latency;
+	snd_pcm_stream_unlock_irq(substream);
+	snd_pcm_proc_print_hist(buffer, "period to wakeup latency",
+				hist.wakeup, hist.wakeup_max);
+	snd_pcm_proc_print_hist(buffer, "hw_ptr jitter",
+				hist.jitter, hist.jitter_max);
+}
+
+static void snd_pcm_substream_proc_latency_write(struct snd_info_entry *entry,
+						 struct snd_info_buffer *buffer)
+{
+	struct snd_pcm_substream *substream = entry->private_data;
+	char line[16];
+
+	/* any write resets the statistics */
+	if (snd_info_get_line(buffer, line, sizeof(line)))
+		return;
+	snd_pcm_stream_lock_irq(substream);
+	memset(&substream->latency, 0, sizeof(substream->latency));
+	snd_pcm_stream_unlock_irq(substream);
+}
+
 #ifdef CONFIG_SND_PCM_XRUN_DEBUG
 static void snd_pcm_xrun_debug_read(struct snd_info_entry *entry,
 				    struct snd_info_buffer *buffer)
@@ -601,6 +645,18 @@ static int snd_pcm_substream_proc_init(struct snd_pcm_substream *substream)
 	}
 	substream->proc_status_entry = entry;
 
+	if ((entry = snd_info_create_card_entry(card, "latency", substream->proc_root)) != NULL) {
+		snd_info_set_text_ops(entry, substream,
+				      snd_pcm_substream_proc_latency_read);
+		entry->c.text.write = snd_pcm_substream_proc_latency_write;
+		entry->mode |= S_IWUSR;
+		if (snd_info_register(entry) < 0) {
+			snd_info_free_entry(entry);
+			entry = NULL;
+		}
+	}
+	substream->proc_latency_entry = entry;
+
 	return 0;
 }
 
@@ -614,6 +670,8 @@ static int snd_pcm_substream_proc_done(struct snd_pcm_substream *substream)
 	substream->proc_sw_params_entry = NULL;
 	snd_info_free_entry(substream->proc_status_entry);
 	substream->proc_status_entry = NULL;
+	snd_info_free_entry(substream->proc_latency_entry);
+	substream->proc_latency_entry = NULL;
 	snd_info_free_entry(substream->proc_root);
 	substream->proc_root = NULL;
 	return 0;
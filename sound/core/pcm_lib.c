@@ -31,6 +31,9 @@
 #include <sound/pcm_params.h>
 #include <sound/timer.h>
 
+#define CREATE_TRACE_POINTS
+#include "pcm_trace.h"
+
 /*
  * fill ring buffer with silence
  * runtime->silence_start: starting pointer to silence area
@@ -167,6 +170,7 @@ static void xrun(struct snd_pcm_substream *substream)
 {
 	struct snd_pcm_runtime *runtime = substream->runtime;
 
+	trace_xrun(substream);
 	if (runtime->tstamp_mode == SNDRV_PCM_TSTAMP_ENABLE)
 		snd_pcm_gettime(runtime, (struct timespec *)&runtime->status->tstamp);
 	snd_pcm_stop(substream, SNDRV_PCM_STATE_XRUN);
@@ -179,8 +183,9 @@ static void xrun(struct snd_pcm_substream *substream)
 }
 
 #ifdef CONFIG_SND_PCM_XRUN_DEBUG
-#define hw_ptr_error(substream, fmt, args...)				\
+#define hw_ptr_error(substream, why, fmt, args...)			\
 	do {								\
+		trace_hw_ptr_error(substream, why);			\
 		if (xrun_debug(substream, XRUN_DEBUG_BASIC)) {		\
 			xrun_log_show(substream);			\
 			if (printk_ratelimit()) {			\
@@ -269,7 +274,8 @@ static void xrun_log_show(struct snd_pcm_substream *substream)
 
 #else /* ! CONFIG_SND_PCM_XRUN_DEBUG */
 
-#define hw_ptr_error(substream, fmt, args...) do { } while (0)
+#define hw_ptr_error(substream, why, fmt, args...) \
+	trace_hw_ptr_error(substream, why)
 #define xrun_log(substream, pos, in_interrupt)	do { } while (0)
 #define xrun_log_show(substream)	do { } while (0)
 
@@ -305,6 +311,50 @@ int snd_pcm_update_state(struct snd_pcm_substream *substream,
 	return 0;
 }
 
+static inline unsigned int snd_pcm_hist_bucket(u64 us)
+{
+	if (us >= 1 << (SNDRV_PCM_HIST_BUCKETS - 2))
+		return SNDRV_PCM_HIST_BUCKETS - 1;
+	return fls((unsigned int)us);
+}
+
+static void snd_pcm_hist_add(unsigned int *hist, unsigned int *max, u64 us)
+{
+	hist[snd_pcm_hist_bucket(us)]++;
+	if (us > *max)
+		*max = min_t(u64, us, UINT_MAX);
+}
+
+/*
+ * Account the deviation of the hw_ptr progress from the elapsed time
+ * between two period updates, and remember the update time for the
+ * wakeup latency of a waiting task.
+ */
+static void snd_pcm_period_stats(struct snd_pcm_substream *substream,
+				 snd_pcm_uframes_t new_hw_ptr)
+{
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	struct snd_pcm_latency_hist *hist = &substream->latency;
+	u64 now = ktime_to_ns(ktime_get());
+	snd_pcm_sframes_t frames;
+	s64 dev;
+
+	if (runtime->period_irq_ns && runtime->rate) {
+		frames = new_hw_ptr - runtime->period_irq_hw_ptr;
+		if (frames < 0)
+			frames += runtime->boundary;
+		dev = now - runtime->period_irq_ns -
+			div_u64((u64)frames * NSEC_PER_SEC, runtime->rate);
+		if (dev < 0)
+			dev = -dev;
+		snd_pcm_hist_add(hist->jitter, &hist->jitter_max,
+				 div_u64(dev, NSEC_PER_USEC));
+	}
+	runtime->period_irq_ns = now;
+	runtime->period_irq_hw_ptr = new_hw_ptr;
+	runtime->period_wake_pending = 1;
+}
+
 static int snd_pcm_update_hw_ptr0(struct snd_pcm_substream *substream,
 				  unsigned int in_interrupt)
 {
@@ -333,6 +383,7 @@ static int snd_pcm_update_hw_ptr0(struct snd_pcm_substream *substream,
 		pos = 0;
 	}
 	pos -= pos % runtime->min_align;
+	trace_hwptr(substream, pos, in_interrupt);
 	if (xrun_debug(substream, XRUN_DEBUG_LOG))
 		xrun_log(substream, pos, in_interrupt);
 	hw_base = runtime->hw_ptr_base;
@@ -406,7 +457,7 @@ static int snd_pcm_update_hw_ptr0(struct snd_pcm_substream *substream,
 
 	/* something must be really wrong */
 	if (delta >= runtime->buffer_size + runtime->period_size) {
-		hw_ptr_error(substream,
+		hw_ptr_error(substream, "Unexpected hw_pointer value",
 			       "Unexpected hw_pointer value %s"
 			       "(stream=%i, pos=%ld, new_hw_ptr=%ld, "
 			       "old_hw_ptr=%ld)\n",
@@ -447,7 +498,7 @@ static int snd_pcm_update_hw_ptr0(struct snd_pcm_substream *substream,
 			delta--;
 		}
 		/* align hw_base to buffer_size */
-		hw_ptr_error(substream,
+		hw_ptr_error(substream, "hw_ptr skipping",
 			     "hw_ptr skipping! %s"
 			     "(pos=%ld, delta=%ld, period=%ld, "
 			     "jdelta=%lu/%lu/%lu, hw_ptr=%ld/%ld)\n",
@@ -463,7 +514,7 @@ static int snd_pcm_update_hw_ptr0(struct snd_pcm_substream *substream,
 	}
  no_jiffies_check:
 	if (delta > runtime->period_size + runtime->period_size / 2) {
-		hw_ptr_error(substream,
+		hw_ptr_error(substream, "Lost interrupts?",
 			     "Lost interrupts? %s"
 			     "(stream=%i, delta=%ld, new_hw_ptr=%ld, "
 			     "old_hw_ptr=%ld)\n",
@@ -482,6 +533,7 @@ static int snd_pcm_update_hw_ptr0(struct snd_pcm_substream *substream,
 		snd_pcm_playback_silence(substream, new_hw_ptr);
 
 	if (in_interrupt) {
+		snd_pcm_period_stats(substream, new_hw_ptr);
 		delta = new_hw_ptr - runtime->hw_ptr_interrupt;
 		if (delta < 0)
 			delta += runtime->boundary;
@@ -1757,6 +1809,7 @@ void snd_pcm_period_elapsed(struct snd_pcm_substream *substream)
 		runtime->transfer_ack_begin(substream);
 
 	snd_pcm_stream_lock_irqsave(substream, flags);
+	trace_period_elapsed(substream);
 	if (!snd_pcm_running(substream) ||
 	    snd_pcm_update_hw_ptr0(substream, 1) < 0)
 		goto _end;
@@ -1802,6 +1855,8 @@ static int wait_for_avail(struct snd_pcm_substream *substream,
 		}
 		wait_time = msecs_to_jiffies(wait_time * 1000);
 	}
+	/* account only the period updates happening while we sleep */
+	runtime->period_wake_pending = 0;
 
 	for (;;) {
 		if (signal_pending(current)) {
@@ -1827,6 +1882,15 @@ static int wait_for_avail(struct snd_pcm_substream *substream,
 		tout = schedule_timeout(wait_time);
 
 		snd_pcm_stream_lock_irq(substream);
+		if (tout && runtime->period_wake_pending) {
+			struct snd_pcm_latency_hist *hist = &substream->latency;
+			u64 lat = ktime_to_ns(ktime_get()) -
+				runtime->period_irq_ns;
+
+			snd_pcm_hist_add(hist->wakeup, &hist->wakeup_max,
+					 div_u64(lat, NSEC_PER_USEC));
+			runtime->period_wake_pending = 0;
+		}
 		set_current_state(TASK_INTERRUPTIBLE);
 		switch (runtime->status->state) {
 		case SNDRV_PCM_STATE_SUSPENDED:
@@ -26,6 +26,9 @@
 #include <linux/moduleparam.h>
 #include <linux/vmalloc.h>
 #include <linux/export.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/shrinker.h>
 #include <sound/core.h>
 #include <sound/pcm.h>
 #include <sound/info.h>
@@ -33,7 +36,11 @@
 
 static int preallocate_dma = 1;
 module_param(preallocate_dma, int, 0444);
-MODULE_PARM_DESC(preallocate_dma, "Preallocate DMA memory when the PCM devices are initialized.");
+MODULE_PARM_DESC(preallocate_dma, "Preallocate DMA memory when the PCM devices are initialized (2 = on demand).");
+
+static int buffer_pool = 10;
+module_param(buffer_pool, int, 0644);
+MODULE_PARM_DESC(buffer_pool, "Seconds a freed DMA buffer is kept for reuse (0 = off).");
 
 static int maximum_substreams = 4;
 module_param(maximum_substreams, int, 0444);
@@ -41,6 +48,242 @@ MODULE_PARM_DESC(maximum_substreams, "Maximum substreams with preallocated DMA m
 
 static const size_t snd_minimum_buffer = 16384;
 
+/*
+ * Per-card pool of DMA buffers released by snd_pcm_lib_free_pages().
+ *
+ * hw_params takes the best fitting buffer of the same device back from
+ * the pool before going to the page allocator, so a stream being set
+ * up again doesn't have to find contiguous memory each time.  Buffers
+ * from the page allocator are allocated in the power of two sizes it
+ * rounds to anyway, other buffers are only rounded to pages since the
+ * DMA API may give the tail pages back (as ARM does).  Unused buffers
+ * are released after buffer_pool seconds, or earlier through the
+ * shrinker.
+ */
+struct snd_pcm_pool_buf {
+	struct list_head list;
+	struct snd_dma_buffer dmab;
+	unsigned long stamp;		/* jiffies when put back */
+	struct snd_pcm_buffer_pool *pool;
+};
+
+struct snd_pcm_buffer_pool {
+	struct snd_card *card;
+	struct list_head list;		/* in pool_list */
+	int users;			/* substreams, protected by pool_mutex */
+	spinlock_t lock;
+	struct list_head free;		/* unused buffers, most recent first */
+	size_t cached;			/* bytes held in free */
+	struct delayed_work reclaim;
+};
+
+static DEFINE_MUTEX(pool_mutex);
+static LIST_HEAD(pool_list);
+
+#define POOL_RELEASE_ALL	((size_t)-1)
+
+static size_t pool_class_size(int type, size_t size)
+{
+	if (type == SNDRV_DMA_TYPE_CONTINUOUS)
+		return PAGE_SIZE << get_order(size);
+	return PAGE_ALIGN(size);
+}
+
+/*
+ * release unused buffers which were put back at least age jiffies ago,
+ * oldest first, until more than max bytes are freed
+ */
+static size_t pool_release(struct snd_pcm_buffer_pool *pool,
+			   unsigned long age, size_t max)
+{
+	struct snd_pcm_pool_buf *buf, *next;
+	LIST_HEAD(release);
+	size_t freed = 0;
+
+	spin_lock(&pool->lock);
+	list_for_each_entry_safe_reverse(buf, next, &pool->free, list) {
+		if (freed >= max)
+			break;
+		if (time_before(jiffies, buf->stamp + age))
+			break;
+		list_move(&buf->list, &release);
+		pool->cached -= buf->dmab.bytes;
+		freed += buf->dmab.bytes;
+	}
+	spin_unlock(&pool->lock);
+
+	list_for_each_entry_safe(buf, next, &release, list) {
+		snd_dma_free_pages(&buf->dmab);
+		kfree(buf);
+	}
+	return freed;
+}
+
+/* release the unused buffers of all cards */
+static size_t pool_release_all(void)
+{
+	struct snd_pcm_buffer_pool *pool;
+	size_t freed = 0;
+
+	mutex_lock(&pool_mutex);
+	list_for_each_entry(pool, &pool_list, list)
+		freed += pool_release(pool, 0, POOL_RELEASE_ALL);
+	mutex_unlock(&pool_mutex);
+	return freed;
+}
+
+static void pool_reclaim_work(struct work_struct *work)
+{
+	struct snd_pcm_buffer_pool *pool =
+		container_of(work, struct snd_pcm_buffer_pool, reclaim.work);
+	unsigned long age = buffer_pool * HZ;
+
+	pool_release(pool, age, POOL_RELEASE_ALL);
+	if (pool->cached)
+		schedule_delayed_work(&pool->reclaim, age ? age : HZ);
+}
+
+static int pool_shrink(struct shrinker *shrinker, struct shrink_control *sc)
+{
+	struct snd_pcm_buffer_pool *pool;
+	unsigned long pages = 0, freed = 0;
+
+	if (!mutex_trylock(&pool_mutex))
+		return -1;
+	list_for_each_entry(pool, &pool_list, list) {
+		if (freed < sc->nr_to_scan)
+			freed += pool_release(pool, 0,
+				(sc->nr_to_scan - freed) << PAGE_SHIFT) >>
+				PAGE_SHIFT;
+		pages += pool->cached >> PAGE_SHIFT;
+	}
+	mutex_unlock(&pool_mutex);
+	return pages;
+}
+
+static struct shrinker pool_shrinker = {
+	.shrink = pool_shrink,
+	.seeks = DEFAULT_SEEKS,
+};
+
+static struct snd_pcm_buffer_pool *pool_get(struct snd_card *card)
+{
+	struct snd_pcm_buffer_pool *pool;
+
+	mutex_lock(&pool_mutex);
+	list_for_each_entry(pool, &pool_list, list) {
+		if (pool->card == card)
+			goto found;
+	}
+	pool = kzalloc(sizeof(*pool), GFP_KERNEL);
+	if (!pool)
+		goto unlock;
+	pool->card = card;
+	spin_lock_init(&pool->lock);
+	INIT_LIST_HEAD(&pool->free);
+	INIT_DELAYED_WORK(&pool->reclaim, pool_reclaim_work);
+	if (list_empty(&pool_list))
+		register_shrinker(&pool_shrinker);
+	list_add_tail(&pool->list, &pool_list);
+ found:
+	pool->users++;
+ unlock:
+	mutex_unlock(&pool_mutex);
+	return pool;
+}
+
+static void pool_put(struct snd_pcm_buffer_pool *pool)
+{
+	mutex_lock(&pool_mutex);
+	if (--pool->users) {
+		mutex_unlock(&pool_mutex);
+		return;
+	}
+	list_del(&pool->list);
+	if (list_empty(&pool_list))
+		unregister_shrinker(&pool_shrinker);
+	mutex_unlock(&pool_mutex);
+
+	cancel_delayed_work_sync(&pool->reclaim);
+	pool_release(pool, 0, POOL_RELEASE_ALL);
+	kfree(pool);
+}
+
+/* take a buffer of at least size bytes out of the pool */
+static struct snd_pcm_pool_buf *pool_take(struct snd_pcm_buffer_pool *pool,
+					  struct snd_dma_device *dev,
+					  size_t size)
+{
+	struct snd_pcm_pool_buf *buf, *best = NULL;
+	size_t limit = 2 * pool_class_size(dev->type, size);
+
+	spin_lock(&pool->lock);
+	list_for_each_entry(buf, &pool->free, list) {
+		if (buf->dmab.dev.type != dev->type ||
+		    buf->dmab.dev.dev != dev->dev ||
+		    buf->dmab.bytes < size || buf->dmab.bytes > limit)
+			continue;
+		if (!best || buf->dmab.bytes < best->dmab.bytes)
+			best = buf;
+	}
+	if (best) {
+		list_del(&best->list);
+		pool->cached -= best->dmab.bytes;
+	}
+	spin_unlock(&pool->lock);
+	return best;
+}
+
+static struct snd_pcm_pool_buf *
+pool_alloc(struct snd_pcm_substream *substream, size_t size)
+{
+	struct snd_pcm_buffer_pool *pool = substream->buffer_pool;
+	struct snd_dma_device *dev = &substream->dma_buffer.dev;
+	struct snd_pcm_pool_buf *buf;
+	int err;
+
+	if (pool && buffer_pool > 0) {
+		buf = pool_take(pool, dev, size);
+		if (buf)
+			return buf;
+		size = pool_class_size(dev->type, size);
+	}
+
+	buf = kzalloc(sizeof(*buf), GFP_KERNEL);
+	if (!buf)
+		return NULL;
+	buf->dmab.dev = *dev;
+	buf->pool = pool;
+	err = snd_dma_alloc_pages(dev->type, dev->dev, size, &buf->dmab);
+	if (err == -ENOMEM && pool_release_all()) {
+		/* try once more with the unused buffers given back */
+		err = snd_dma_alloc_pages(dev->type, dev->dev, size,
+					  &buf->dmab);
+	}
+	if (err < 0) {
+		kfree(buf);
+		return NULL;
+	}
+	return buf;
+}
+
+static void pool_free(struct snd_pcm_pool_buf *buf)
+{
+	struct snd_pcm_buffer_pool *pool = buf->pool;
+
+	if (!pool || buffer_pool <= 0) {
+		snd_dma_free_pages(&buf->dmab);
+		kfree(buf);
+		return;
+	}
+	buf->stamp = jiffies;
+	spin_lock(&pool->lock);
+	list_add(&buf->list, &pool->free);
+	pool->cached += buf->dmab.bytes;
+	spin_unlock(&pool->lock);
+	schedule_delayed_work(&pool->reclaim, buffer_pool * HZ);
+}
+
 
 /*
  * try to allocate as the large pages as possible.
@@ -100,6 +343,10 @@ static void snd_pcm_lib_preallocate_dma_free(struct snd_pcm_substream *substream
 int snd_pcm_lib_preallocate_free(struct snd_pcm_substream *substream)
 {
 	snd_pcm_lib_preallocate_dma_free(substream);
+	if (substream->buffer_pool) {
+		pool_put(substream->buffer_pool);
+		substream->buffer_pool = NULL;
+	}
 #ifdef CONFIG_SND_VERBOSE_PROCFS
 	snd_info_free_entry(substream->proc_prealloc_max_entry);
 	substream->proc_prealloc_max_entry = NULL;
@@ -239,11 +486,17 @@ static int snd_pcm_lib_preallocate_pages1(struct snd_pcm_substream *substream,
 					  size_t size, size_t max)
 {
 
-	if (size > 0 && preallocate_dma && substream->number < maximum_substreams)
+	if (size > 0 && preallocate_dma == 1 &&
+	    substream->number < maximum_substreams)
 		preallocate_pcm_pages(substream, size);
 
 	if (substream->dma_buffer.bytes > 0)
 		substream->buffer_bytes_max = substream->dma_buffer.bytes;
+	else if (size > 0 && preallocate_dma == 2)
+		/* allocated in hw_params, keep the same limit */
+		substream->buffer_bytes_max = size;
+	if (!substream->buffer_pool)
+		substream->buffer_pool = pool_get(substream->pcm->card);
 	substream->dma_max = max;
 	preallocate_info_init(substream);
 	return 0;
@@ -370,6 +623,7 @@ int snd_pcm_lib_malloc_pages(struct snd_pcm_substream *substream, size_t size)
 {
 	struct snd_pcm_runtime *runtime;
 	struct snd_dma_buffer *dmab = NULL;
+	struct snd_pcm_pool_buf *buf;
 
 	if (PCM_RUNTIME_CHECK(substream))
 		return -EINVAL;
@@ -392,16 +646,10 @@ int snd_pcm_lib_malloc_pages(struct snd_pcm_substream *substream, size_t size)
 	    substream->dma_buffer.bytes >= size) {
 		dmab = &substream->dma_buffer; /* use the pre-allocated buffer */
 	} else {
-		dmab = kzalloc(sizeof(*dmab), GFP_KERNEL);
-		if (! dmab)
+		buf = pool_alloc(substream, size);
+		if (!buf)
 			return -ENOMEM;
-		dmab->dev = substream->dma_buffer.dev;
-		if (snd_dma_alloc_pages(substream->dma_buffer.dev.type,
-					substream->dma_buffer.dev.dev,
-					size, dmab) < 0) {
-			kfree(dmab);
-			return -ENOMEM;
-		}
+		dmab = &buf->dmab;
 	}
 	snd_pcm_set_runtime_buffer(substream, dmab);
 	runtime->dma_bytes = size;
@@ -428,9 +676,9 @@ int snd_pcm_lib_free_pages(struct snd_pcm_substream *substream)
 	if (runtime->dma_area == NULL)
 		return 0;
 	if (runtime->dma_buffer_p != &substream->dma_buffer) {
-		/* it's a newly allocated buffer.  release it now. */
-		snd_dma_free_pages(runtime->dma_buffer_p);
-		kfree(runtime->dma_buffer_p);
+		/* it's a newly allocated buffer.  release it to the pool. */
+		pool_free(container_of(runtime->dma_buffer_p,
+				       struct snd_pcm_pool_buf, dmab));
 	}
 	snd_pcm_set_runtime_buffer(substream, NULL);
 	return 0;
@@ -385,6 +385,7 @@ int snd_pcm_format_set_silence(snd_pcm_format_t format, void *data, unsigned int
 {
 	int width;
 	unsigned char *dst, *pat;
+	unsigned int bytes, filled, chunk;
 
 	if ((INT)format < 0 || (INT)format > (INT)SNDRV_PCM_FORMAT_LAST)
 		return -EINVAL;
@@ -396,51 +397,131 @@ int snd_pcm_format_set_silence(snd_pcm_format_t format, void *data, unsigned int
 		return -EINVAL;
 	/* signed or 1 byte data */
 	if (pcm_formats[(INT)format].signd == 1 || width <= 8) {
-		unsigned int bytes = samples * width / 8;
+		bytes = samples * width / 8;
 		memset(data, *pat, bytes);
 		return 0;
 	}
-	/* non-zero samples, fill using a loop */
+	/* non-zero samples: put one sample, then keep doubling the filled
+	 * area so that the bulk is done by the (word-wide) memcpy
+	 */
 	width /= 8;
 	dst = data;
-#if 0
-	while (samples--) {
-		memcpy(dst, pat, width);
-		dst += width;
-	}
-#else
-	/* a bit optimization for constant width */
-	switch (width) {
-	case 2:
-		while (samples--) {
-			memcpy(dst, pat, 2);
-			dst += 2;
+	bytes = samples * width;
+	for (filled = 0; filled < bytes; filled += chunk) {
+		if (!filled) {
+			chunk = width;
+			memcpy(dst, pat, chunk);
+		} else {
+			chunk = min(filled, bytes - filled);
+			memcpy(dst + filled, dst, chunk);
 		}
+	}
+	return 0;
+}
+
+EXPORT_SYMBOL(snd_pcm_format_set_silence);
+
+/**
+ * snd_pcm_sample_copy - copy samples between strided buffers
+ * @dst: the destination buffer
+ * @dst_step: the distance between destination samples in bytes
+ * @src: the source buffer
+ * @src_step: the distance between source samples in bytes, zero to
+ *	repeat a single sample
+ * @width: the physical sample width in bytes
+ * @samples: the number of samples to copy
+ *
+ * Copies samples between (de)interleaved buffers, e.g. one channel of
+ * an interleaved buffer to a non-interleaved one.  Naturally aligned
+ * samples of 1, 2, 4 and 8 bytes are moved as single words.
+ */
+void snd_pcm_sample_copy(void *dst, unsigned int dst_step,
+			 const void *src, unsigned int src_step,
+			 unsigned int width, size_t samples)
+{
+	unsigned char *d = dst;
+	const unsigned char *s = src;
+	unsigned int word = width;
+
+	if (((unsigned long)d | (unsigned long)s | dst_step | src_step) &
+	    (width - 1))
+		word = 0;	/* misaligned, use memcpy */
+
+	switch (word) {
+	case 1:
+		for (; samples--; d += dst_step, s += src_step)
+			*d = *s;
 		break;
-	case 3:
-		while (samples--) {
-			memcpy(dst, pat, 3);
-			dst += 3;
-		}
+	case 2:
+		for (; samples--; d += dst_step, s += src_step)
+			*(u16 *)d = *(const u16 *)s;
 		break;
 	case 4:
-		while (samples--) {
-			memcpy(dst, pat, 4);
-			dst += 4;
-		}
+		for (; samples--; d += dst_step, s += src_step)
+			*(u32 *)d = *(const u32 *)s;
 		break;
 	case 8:
-		while (samples--) {
-			memcpy(dst, pat, 8);
-			dst += 8;
-		}
+		for (; samples--; d += dst_step, s += src_step)
+			*(u64 *)d = *(const u64 *)s;
+		break;
+	default:
+		for (; samples--; d += dst_step, s += src_step)
+			memcpy(d, s, width);
 		break;
 	}
-#endif
-	return 0;
 }
 
-EXPORT_SYMBOL(snd_pcm_format_set_silence);
+EXPORT_SYMBOL(snd_pcm_sample_copy);
+
+/**
+ * snd_pcm_s16_to_s32 - convert CPU-endian S16 samples to S32
+ * @dst: the destination buffer
+ * @dst_step: the distance between destination samples in samples
+ * @src: the source buffer
+ * @src_step: the distance between source samples in samples
+ * @samples: the number of samples to convert
+ *
+ * The 16 bits end up in the most significant half, as the generic
+ * linear conversion does.
+ */
+void snd_pcm_s16_to_s32(s32 *dst, unsigned int dst_step,
+			const s16 *src, unsigned int src_step, size_t samples)
+{
+	if (dst_step == 1 && src_step == 1) {
+		while (samples--)
+			*dst++ = (u32)(u16)*src++ << 16;
+		return;
+	}
+	for (; samples--; dst += dst_step, src += src_step)
+		*dst = (u32)(u16)*src << 16;
+}
+
+EXPORT_SYMBOL(snd_pcm_s16_to_s32);
+
+/**
+ * snd_pcm_s32_to_s16 - convert CPU-endian S32 samples to S16
+ * @dst: the destination buffer
+ * @dst_step: the distance between destination samples in samples
+ * @src: the source buffer
+ * @src_step: the distance between source samples in samples
+ * @samples: the number of samples to convert
+ *
+ * Keeps the most significant 16 bits, as the generic linear conversion
+ * does.
+ */
+void snd_pcm_s32_to_s16(s16 *dst, unsigned int dst_step,
+			const s32 *src, unsigned int src_step, size_t samples)
+{
+	if (dst_step == 1 && src_step == 1) {
+		while (samples--)
+			*dst++ = *src++ >> 16;
+		return;
+	}
+	for (; samples--; dst += dst_step, src += src_step)
+		*dst = *src >> 16;
+}
+
+EXPORT_SYMBOL(snd_pcm_s32_to_s16);
 
 /**
  * snd_pcm_limit_hw_rates - determine rate_min/rate_max fields
@@ -24,6 +24,8 @@
 #include <linux/init.h>
 #include <linux/sched.h>
 #include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
 #include <linux/time.h>
 #include <linux/wait.h>
 #include <linux/mutex.h>
@@ -100,6 +102,86 @@ static void snd_rawmidi_input_event_work(struct work_struct *work)
 		runtime->event(runtime->substream);
 }
 
+/*
+ * mmap support; the status page and the buffer are shared with the
+ * application, all helpers below must be called with runtime->lock held.
+ */
+
+/* Put the status page in line with the current buffer state */
+static void snd_rawmidi_mmap_reset(struct snd_rawmidi_runtime *runtime)
+{
+	struct snd_rawmidi_mmap_status *status = runtime->status;
+	size_t queued;
+
+	if (!status)
+		return;
+	runtime->boundary = runtime->buffer_size;
+	while (runtime->boundary * 2 <= 0x7fffffffUL - runtime->buffer_size)
+		runtime->boundary *= 2;
+	runtime->mmap_appl = runtime->appl_ptr;
+	status->buffer_size = runtime->buffer_size;
+	status->boundary = runtime->boundary;
+	status->appl_ptr = runtime->appl_ptr;
+	/* input data is queued ahead of appl_ptr, output data behind it */
+	if (runtime->substream->stream == SNDRV_RAWMIDI_STREAM_INPUT) {
+		queued = runtime->avail;
+		status->hw_ptr = (runtime->appl_ptr + queued) %
+				 runtime->boundary;
+	} else {
+		queued = runtime->buffer_size - runtime->avail;
+		status->hw_ptr = (runtime->appl_ptr + runtime->boundary -
+				  queued) % runtime->boundary;
+	}
+	status->xruns = runtime->xruns;
+}
+
+/* Take over whatever the application consumed or produced via mmap */
+static void snd_rawmidi_mmap_sync(struct snd_rawmidi_runtime *runtime)
+{
+	struct snd_rawmidi_mmap_status *status = runtime->status;
+	size_t appl, delta;
+
+	if (!status)
+		return;
+	appl = ACCESS_ONCE(status->appl_ptr);
+	if (appl >= runtime->boundary)
+		return;
+	delta = (appl + runtime->boundary - runtime->mmap_appl) %
+		runtime->boundary;
+	if (!delta || delta > runtime->avail)
+		return;
+	runtime->appl_ptr = (runtime->appl_ptr + delta) % runtime->buffer_size;
+	runtime->avail -= delta;
+	runtime->mmap_appl = appl;
+}
+
+/* read() or write() moved appl_ptr */
+static inline void snd_rawmidi_mmap_appl(struct snd_rawmidi_runtime *runtime,
+					 size_t count)
+{
+	if (!runtime->status)
+		return;
+	runtime->mmap_appl = (runtime->mmap_appl + count) % runtime->boundary;
+	runtime->status->appl_ptr = runtime->mmap_appl;
+}
+
+/* the device moved hw_ptr */
+static inline void snd_rawmidi_mmap_hw(struct snd_rawmidi_runtime *runtime,
+				       size_t count)
+{
+	struct snd_rawmidi_mmap_status *status = runtime->status;
+
+	if (!status)
+		return;
+	status->xruns = runtime->xruns;
+	if (!count)
+		return;
+	status->hw_ptr = (status->hw_ptr + count) % runtime->boundary;
+	ktime_get_ts(&runtime->tstamp);
+	status->tstamp_sec = runtime->tstamp.tv_sec;
+	status->tstamp_nsec = runtime->tstamp.tv_nsec;
+}
+
 static int snd_rawmidi_runtime_create(struct snd_rawmidi_substream *substream)
 {
 	struct snd_rawmidi_runtime *runtime;
@@ -108,6 +190,7 @@ static int snd_rawmidi_runtime_create(struct snd_rawmidi_substream *substream)
 		return -ENOMEM;
 	runtime->substream = substream;
 	spin_lock_init(&runtime->lock);
+	mutex_init(&runtime->mmap_mutex);
 	init_waitqueue_head(&runtime->sleep);
 	INIT_WORK(&runtime->event_work, snd_rawmidi_input_event_work);
 	runtime->event = NULL;
@@ -117,7 +200,7 @@ static int snd_rawmidi_runtime_create(struct snd_rawmidi_substream *substream)
 		runtime->avail = 0;
 	else
 		runtime->avail = runtime->buffer_size;
-	if ((runtime->buffer = kmalloc(runtime->buffer_size, GFP_KERNEL)) == NULL) {
+	if ((runtime->buffer = vmalloc_user(runtime->buffer_size)) == NULL) {
 		kfree(runtime);
 		return -ENOMEM;
 	}
@@ -130,7 +213,8 @@ static int snd_rawmidi_runtime_free(struct snd_rawmidi_substream *substream)
 {
 	struct snd_rawmidi_runtime *runtime = substream->runtime;
 
-	kfree(runtime->buffer);
+	vfree(runtime->buffer);
+	vfree(runtime->status);
 	kfree(runtime);
 	substream->runtime = NULL;
 	return 0;
@@ -162,6 +246,7 @@ int snd_rawmidi_drop_output(struct snd_rawmidi_substream *substream)
 	spin_lock_irqsave(&runtime->lock, flags);
 	runtime->appl_ptr = runtime->hw_ptr = 0;
 	runtime->avail = runtime->buffer_size;
+	snd_rawmidi_mmap_reset(runtime);
 	spin_unlock_irqrestore(&runtime->lock, flags);
 	return 0;
 }
@@ -205,6 +290,7 @@ int snd_rawmidi_drain_input(struct snd_rawmidi_substream *substream)
 	spin_lock_irqsave(&runtime->lock, flags);
 	runtime->appl_ptr = runtime->hw_ptr = 0;
 	runtime->avail = 0;
+	snd_rawmidi_mmap_reset(runtime);
 	spin_unlock_irqrestore(&runtime->lock, flags);
 	return 0;
 }
@@ -613,55 +699,85 @@ static int snd_rawmidi_info_select_user(struct snd_card *card,
 int snd_rawmidi_output_params(struct snd_rawmidi_substream *substream,
 			      struct snd_rawmidi_params * params)
 {
-	char *newbuf;
+	char *newbuf, *oldbuf;
 	struct snd_rawmidi_runtime *runtime = substream->runtime;
+	int err = 0;
 	
 	if (substream->append && substream->use_count > 1)
 		return -EBUSY;
-	snd_rawmidi_drain_output(substream);
 	if (params->buffer_size < 32 || params->buffer_size > 1024L * 1024L) {
 		return -EINVAL;
 	}
 	if (params->avail_min < 1 || params->avail_min > params->buffer_size) {
 		return -EINVAL;
 	}
+	/* keep the buffer from being mapped while it may be replaced */
+	mutex_lock(&runtime->mmap_mutex);
+	if (atomic_read(&runtime->mmap_count)) {
+		err = -EBUSY;
+		goto unlock;
+	}
+	snd_rawmidi_drain_output(substream);
 	if (params->buffer_size != runtime->buffer_size) {
-		newbuf = krealloc(runtime->buffer, params->buffer_size,
-				  GFP_KERNEL);
-		if (!newbuf)
-			return -ENOMEM;
+		newbuf = vmalloc_user(params->buffer_size);
+		if (!newbuf) {
+			err = -ENOMEM;
+			goto unlock;
+		}
+		spin_lock_irq(&runtime->lock);
+		oldbuf = runtime->buffer;
 		runtime->buffer = newbuf;
 		runtime->buffer_size = params->buffer_size;
 		runtime->avail = runtime->buffer_size;
+		snd_rawmidi_mmap_reset(runtime);
+		spin_unlock_irq(&runtime->lock);
+		vfree(oldbuf);
 	}
 	runtime->avail_min = params->avail_min;
 	substream->active_sensing = !params->no_active_sensing;
-	return 0;
+ unlock:
+	mutex_unlock(&runtime->mmap_mutex);
+	return err;
 }
 
 int snd_rawmidi_input_params(struct snd_rawmidi_substream *substream,
 			     struct snd_rawmidi_params * params)
 {
-	char *newbuf;
+	char *newbuf, *oldbuf;
 	struct snd_rawmidi_runtime *runtime = substream->runtime;
+	int err = 0;
 
-	snd_rawmidi_drain_input(substream);
 	if (params->buffer_size < 32 || params->buffer_size > 1024L * 1024L) {
 		return -EINVAL;
 	}
 	if (params->avail_min < 1 || params->avail_min > params->buffer_size) {
 		return -EINVAL;
 	}
+	/* keep the buffer from being mapped while it may be replaced */
+	mutex_lock(&runtime->mmap_mutex);
+	if (atomic_read(&runtime->mmap_count)) {
+		err = -EBUSY;
+		goto unlock;
+	}
+	snd_rawmidi_drain_input(substream);
 	if (params->buffer_size != runtime->buffer_size) {
-		newbuf = krealloc(runtime->buffer, params->buffer_size,
-				  GFP_KERNEL);
-		if (!newbuf)
-			return -ENOMEM;
+		newbuf = vmalloc_user(params->buffer_size);
+		if (!newbuf) {
+			err = -ENOMEM;
+			goto unlock;
+		}
+		spin_lock_irq(&runtime->lock);
+		oldbuf = runtime->buffer;
 		runtime->buffer = newbuf;
 		runtime->buffer_size = params->buffer_size;
+		snd_rawmidi_mmap_reset(runtime);
+		spin_unlock_irq(&runtime->lock);
+		vfree(oldbuf);
 	}
 	runtime->avail_min = params->avail_min;
-	return 0;
+ unlock:
+	mutex_unlock(&runtime->mmap_mutex);
+	return err;
 }
 
 static int snd_rawmidi_output_status(struct snd_rawmidi_substream *substream,
@@ -672,6 +788,8 @@ static int snd_rawmidi_output_status(struct snd_rawmidi_substream *substream,
 	memset(status, 0, sizeof(*status));
 	status->stream = SNDRV_RAWMIDI_STREAM_OUTPUT;
 	spin_lock_irq(&runtime->lock);
+	snd_rawmidi_mmap_sync(runtime);
+	status->tstamp = runtime->tstamp;
 	status->avail = runtime->avail;
 	spin_unlock_irq(&runtime->lock);
 	return 0;
@@ -685,10 +803,35 @@ static int snd_rawmidi_input_status(struct snd_rawmidi_substream *substream,
 	memset(status, 0, sizeof(*status));
 	status->stream = SNDRV_RAWMIDI_STREAM_INPUT;
 	spin_lock_irq(&runtime->lock);
+	snd_rawmidi_mmap_sync(runtime);
+	status->tstamp = runtime->tstamp;
 	status->avail = runtime->avail;
 	status->xruns = runtime->xruns;
 	runtime->xruns = 0;
+	snd_rawmidi_mmap_hw(runtime, 0);
+	spin_unlock_irq(&runtime->lock);
+	return 0;
+}
+
+/*
+ * Pick up the application pointer of an mmapped stream and get the
+ * device going, the output in case there is something to send.
+ */
+static int snd_rawmidi_mmap_commit(struct snd_rawmidi_substream *substream)
+{
+	struct snd_rawmidi_runtime *runtime = substream->runtime;
+	int pending;
+
+	if (!runtime->status)
+		return -EBADFD;
+	spin_lock_irq(&runtime->lock);
+	snd_rawmidi_mmap_sync(runtime);
+	pending = runtime->avail < runtime->buffer_size;
 	spin_unlock_irq(&runtime->lock);
+	if (substream->stream == SNDRV_RAWMIDI_STREAM_INPUT)
+		snd_rawmidi_input_trigger(substream, 1);
+	else if (pending)
+		snd_rawmidi_output_trigger(substream, 1);
 	return 0;
 }
 
@@ -794,6 +937,24 @@ static long snd_rawmidi_ioctl(struct file *file, unsigned int cmd, unsigned long
 			return -EINVAL;
 		}
 	}
+	case SNDRV_RAWMIDI_IOCTL_MMAP_SYNC:
+	{
+		int val;
+		if (get_user(val, (int __user *) argp))
+			return -EFAULT;
+		switch (val) {
+		case SNDRV_RAWMIDI_STREAM_OUTPUT:
+			if (rfile->output == NULL)
+				return -EINVAL;
+			return snd_rawmidi_mmap_commit(rfile->output);
+		case SNDRV_RAWMIDI_STREAM_INPUT:
+			if (rfile->input == NULL)
+				return -EINVAL;
+			return snd_rawmidi_mmap_commit(rfile->input);
+		default:
+			return -EINVAL;
+		}
+	}
 #ifdef CONFIG_SND_DEBUG
 	default:
 		snd_printk(KERN_WARNING "rawmidi: unknown command = 0x%x\n", cmd);
@@ -871,6 +1032,7 @@ int snd_rawmidi_receive(struct snd_rawmidi_substream *substream,
 		return -EINVAL;
 	}
 	spin_lock_irqsave(&runtime->lock, flags);
+	snd_rawmidi_mmap_sync(runtime);
 	if (count == 1) {	/* special case, faster code */
 		substream->bytes++;
 		if (runtime->avail < runtime->buffer_size) {
@@ -909,6 +1071,7 @@ int snd_rawmidi_receive(struct snd_rawmidi_substream *substream,
 			}
 		}
 	}
+	snd_rawmidi_mmap_hw(runtime, result);
 	if (result > 0) {
 		if (runtime->event)
 			schedule_work(&runtime->event_work);
@@ -927,6 +1090,9 @@ static long snd_rawmidi_kernel_read1(struct snd_rawmidi_substream *substream,
 	long result = 0, count1;
 	struct snd_rawmidi_runtime *runtime = substream->runtime;
 
+	spin_lock_irqsave(&runtime->lock, flags);
+	snd_rawmidi_mmap_sync(runtime);
+	spin_unlock_irqrestore(&runtime->lock, flags);
 	while (count > 0 && runtime->avail) {
 		count1 = runtime->buffer_size - runtime->appl_ptr;
 		if (count1 > count)
@@ -947,6 +1113,7 @@ static long snd_rawmidi_kernel_read1(struct snd_rawmidi_substream *substream,
 		runtime->appl_ptr += count1;
 		runtime->appl_ptr %= runtime->buffer_size;
 		runtime->avail -= count1;
+		snd_rawmidi_mmap_appl(runtime, count1);
 		spin_unlock_irqrestore(&runtime->lock, flags);
 		result += count1;
 		count -= count1;
@@ -979,6 +1146,7 @@ static ssize_t snd_rawmidi_read(struct file *file, char __user *buf, size_t coun
 	result = 0;
 	while (count > 0) {
 		spin_lock_irq(&runtime->lock);
+		snd_rawmidi_mmap_sync(runtime);
 		while (!snd_rawmidi_ready(substream)) {
 			wait_queue_t wait;
 			if ((file->f_flags & O_NONBLOCK) != 0 || result > 0) {
@@ -1028,6 +1196,7 @@ int snd_rawmidi_transmit_empty(struct snd_rawmidi_substream *substream)
 		return 1;
 	}
 	spin_lock_irqsave(&runtime->lock, flags);
+	snd_rawmidi_mmap_sync(runtime);
 	result = runtime->avail >= runtime->buffer_size;
 	spin_unlock_irqrestore(&runtime->lock, flags);
 	return result;		
@@ -1060,6 +1229,7 @@ int snd_rawmidi_transmit_peek(struct snd_rawmidi_substream *substream,
 	}
 	result = 0;
 	spin_lock_irqsave(&runtime->lock, flags);
+	snd_rawmidi_mmap_sync(runtime);
 	if (runtime->avail >= runtime->buffer_size) {
 		/* warning: lowlevel layer MUST trigger down the hardware */
 		goto __skip;
@@ -1114,6 +1284,7 @@ int snd_rawmidi_transmit_ack(struct snd_rawmidi_substream *substream, int count)
 	runtime->hw_ptr %= runtime->buffer_size;
 	runtime->avail += count;
 	substream->bytes += count;
+	snd_rawmidi_mmap_hw(runtime, count);
 	if (count > 0) {
 		if (runtime->drain || snd_rawmidi_ready(substream))
 			wake_up(&runtime->sleep);
@@ -1159,6 +1330,7 @@ static long snd_rawmidi_kernel_write1(struct snd_rawmidi_substream *substream,
 
 	result = 0;
 	spin_lock_irqsave(&runtime->lock, flags);
+	snd_rawmidi_mmap_sync(runtime);
 	if (substream->append) {
 		if ((long)runtime->avail < count) {
 			spin_unlock_irqrestore(&runtime->lock, flags);
@@ -1187,6 +1359,7 @@ static long snd_rawmidi_kernel_write1(struct snd_rawmidi_substream *substream,
 		runtime->appl_ptr += count1;
 		runtime->appl_ptr %= runtime->buffer_size;
 		runtime->avail -= count1;
+		snd_rawmidi_mmap_appl(runtime, count1);
 		result += count1;
 		count -= count1;
 	}
@@ -1222,6 +1395,7 @@ static ssize_t snd_rawmidi_write(struct file *file, const char __user *buf,
 	result = 0;
 	while (count > 0) {
 		spin_lock_irq(&runtime->lock);
+		snd_rawmidi_mmap_sync(runtime);
 		while (!snd_rawmidi_ready_append(substream, count)) {
 			wait_queue_t wait;
 			if (file->f_flags & O_NONBLOCK) {
@@ -1290,16 +1464,139 @@ static unsigned int snd_rawmidi_poll(struct file *file, poll_table * wait)
 	}
 	mask = 0;
 	if (rfile->input != NULL) {
+		runtime = rfile->input->runtime;
+		spin_lock_irq(&runtime->lock);
+		snd_rawmidi_mmap_sync(runtime);
+		spin_unlock_irq(&runtime->lock);
 		if (snd_rawmidi_ready(rfile->input))
 			mask |= POLLIN | POLLRDNORM;
 	}
 	if (rfile->output != NULL) {
+		runtime = rfile->output->runtime;
+		spin_lock_irq(&runtime->lock);
+		snd_rawmidi_mmap_sync(runtime);
+		spin_unlock_irq(&runtime->lock);
 		if (snd_rawmidi_ready(rfile->output))
 			mask |= POLLOUT | POLLWRNORM;
 	}
 	return mask;
 }
 
+/*
+ * mmap of the stream buffers and their status pages
+ */
+static void snd_rawmidi_mmap_data_open(struct vm_area_struct *area)
+{
+	struct snd_rawmidi_substream *substream = area->vm_private_data;
+
+	atomic_inc(&substream->runtime->mmap_count);
+}
+
+static void snd_rawmidi_mmap_data_close(struct vm_area_struct *area)
+{
+	struct snd_rawmidi_substream *substream = area->vm_private_data;
+
+	atomic_dec(&substream->runtime->mmap_count);
+}
+
+static const struct vm_operations_struct snd_rawmidi_vm_ops_data = {
+	.open =		snd_rawmidi_mmap_data_open,
+	.close =	snd_rawmidi_mmap_data_close,
+};
+
+static int snd_rawmidi_mmap_status(struct snd_rawmidi_substream *substream,
+				   struct vm_area_struct *area)
+{
+	struct snd_rawmidi_runtime *runtime = substream->runtime;
+	struct snd_rawmidi_mmap_status *status;
+
+	if (!(area->vm_flags & VM_READ))
+		return -EINVAL;
+	if (area->vm_end - area->vm_start !=
+	    PAGE_ALIGN(sizeof(struct snd_rawmidi_mmap_status)))
+		return -EINVAL;
+	if (!runtime->status) {
+		status = vmalloc_user(sizeof(*status));
+		if (!status)
+			return -ENOMEM;
+		spin_lock_irq(&runtime->lock);
+		if (!runtime->status) {
+			runtime->status = status;
+			status = NULL;
+			snd_rawmidi_mmap_reset(runtime);
+		}
+		spin_unlock_irq(&runtime->lock);
+		vfree(status);
+	}
+	return remap_vmalloc_range(area, runtime->status, 0);
+}
+
+static int snd_rawmidi_mmap_data(struct snd_rawmidi_substream *substream,
+				 struct vm_area_struct *area,
+				 unsigned long offset)
+{
+	struct snd_rawmidi_runtime *runtime = substream->runtime;
+	unsigned long size;
+	int err;
+
+	if (substream->stream == SNDRV_RAWMIDI_STREAM_OUTPUT) {
+		if (!(area->vm_flags & (VM_WRITE|VM_READ)))
+			return -EINVAL;
+	} else {
+		if (!(area->vm_flags & VM_READ))
+			return -EINVAL;
+	}
+	size = area->vm_end - area->vm_start;
+	mutex_lock(&runtime->mmap_mutex);
+	if (size > PAGE_ALIGN(runtime->buffer_size) ||
+	    offset > PAGE_ALIGN(runtime->buffer_size) - size) {
+		err = -EINVAL;
+		goto unlock;
+	}
+	err = remap_vmalloc_range(area, runtime->buffer, offset >> PAGE_SHIFT);
+	if (err < 0)
+		goto unlock;
+	area->vm_ops = &snd_rawmidi_vm_ops_data;
+	area->vm_private_data = substream;
+	atomic_inc(&runtime->mmap_count);
+ unlock:
+	mutex_unlock(&runtime->mmap_mutex);
+	return err;
+}
+
+static int snd_rawmidi_mmap(struct file *file, struct vm_area_struct *area)
+{
+	struct snd_rawmidi_file *rfile = file->private_data;
+	struct snd_rawmidi_substream *substream;
+	unsigned long offset;
+
+	offset = area->vm_pgoff << PAGE_SHIFT;
+	switch (offset) {
+	case SNDRV_RAWMIDI_MMAP_OFFSET_OUTPUT_STATUS:
+		substream = rfile->output;
+		break;
+	case SNDRV_RAWMIDI_MMAP_OFFSET_INPUT_STATUS:
+		substream = rfile->input;
+		break;
+	default:
+		if (offset >= SNDRV_RAWMIDI_MMAP_OFFSET_OUTPUT_STATUS)
+			return -EINVAL;
+		if (offset >= SNDRV_RAWMIDI_MMAP_OFFSET_INPUT) {
+			substream = rfile->input;
+			offset -= SNDRV_RAWMIDI_MMAP_OFFSET_INPUT;
+		} else {
+			substream = rfile->output;
+		}
+		/* the application pointer of a merged stream isn't ours */
+		if (substream == NULL || substream->append)
+			return -ENXIO;
+		return snd_rawmidi_mmap_data(substream, area, offset);
+	}
+	if (substream == NULL || substream->append)
+		return -ENXIO;
+	return snd_rawmidi_mmap_status(substream, area);
+}
+
 /*
  */
 #ifdef CONFIG_COMPAT
@@ -1386,6 +1683,7 @@ static const struct file_operations snd_rawmidi_f_ops =
 	.release =	snd_rawmidi_release,
 	.llseek =	no_llseek,
 	.poll =		snd_rawmidi_poll,
+	.mmap =		snd_rawmidi_mmap,
 	.unlocked_ioctl =	snd_rawmidi_ioctl,
 	.compat_ioctl =	snd_rawmidi_ioctl_compat,
 };
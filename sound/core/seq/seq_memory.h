@@ -23,6 +23,7 @@
 
 #include <sound/seq_kernel.h>
 #include <linux/poll.h>
+#include <linux/rbtree.h>
 
 struct snd_info_buffer;
 
@@ -31,6 +32,8 @@ struct snd_seq_event_cell {
 	struct snd_seq_event event;
 	struct snd_seq_pool *pool;				/* used pool */
 	struct snd_seq_event_cell *next;	/* next cell */
+	struct rb_node node;			/* prioq tree node */
+	u64 order;				/* prioq order of equal times */
 };
 
 /* design note: the pool is a contiguous block of memory, if we dynamicly
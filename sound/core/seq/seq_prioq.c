@@ -26,29 +26,16 @@
 #include "seq_prioq.h"
 
 
-/* Implementation is a simple linked list for now...
-
-   This priority queue orders the events on timestamp. For events with an
-   equeal timestamp the queue behaves as a FIFO. 
-
-   *
-   *           +-------+
-   *  Head --> | first |
-   *           +-------+
-   *                 |next
-   *           +-----v-+
-   *           |       |
-   *           +-------+
-   *                 |
-   *           +-----v-+
-   *           |       |
-   *           +-------+
-   *                 |
-   *           +-----v-+
-   *  Tail --> | last  |
-   *           +-------+
-   *
-
+/* The cells are kept in an rbtree sorted by timestamp, so that
+   inserting and removing an event costs O(log n) also with thousands
+   of scheduled events.  For events with an equal timestamp the queue
+   behaves as a FIFO: each cell gets an order number from a counter
+   running upwards, while high-priority cells take their number from a
+   counter running downwards, so that they precede all the cells of the
+   same time queued before them.
+
+   The leftmost cell is cached in head, which keeps peeking at the next
+   event to dispatch O(1).
  */
 
 
@@ -65,8 +52,10 @@ struct snd_seq_prioq *snd_seq_prioq_new(void)
 	}
 	
 	spin_lock_init(&f->lock);
+	f->root = RB_ROOT;
 	f->head = NULL;
-	f->tail = NULL;
+	f->order_head = 1ULL << 63;
+	f->order_tail = f->order_head + 1;
 	f->cells = 0;
 	
 	return f;
@@ -98,20 +87,6 @@ void snd_seq_prioq_delete(struct snd_seq_prioq **fifo)
 
 
 
-/* compare timestamp between events */
-/* return 1 if a >= b; 0 */
-static inline int compare_timestamp(struct snd_seq_event *a,
-				    struct snd_seq_event *b)
-{
-	if ((a->flags & SNDRV_SEQ_TIME_STAMP_MASK) == SNDRV_SEQ_TIME_STAMP_TICK) {
-		/* compare ticks */
-		return (snd_seq_compare_tick_time(&a->time.tick, &b->time.tick));
-	} else {
-		/* compare real time */
-		return (snd_seq_compare_real_time(&a->time.time, &b->time.time));
-	}
-}
-
 /* compare timestamp between events */
 /* return negative if a < b;
  *        zero     if a = b;
@@ -144,13 +119,37 @@ static inline int compare_timestamp_rel(struct snd_seq_event *a,
 	}
 }
 
+/* compare the position of two cells in the prioq */
+static inline int compare_cell(struct snd_seq_event_cell *a,
+			       struct snd_seq_event_cell *b)
+{
+	int rel = compare_timestamp_rel(&a->event, &b->event);
+
+	if (rel)
+		return rel;
+	return a->order < b->order ? -1 : 1;
+}
+
+/* unlink the cell from the tree; f->lock must be held */
+static void prioq_erase(struct snd_seq_prioq *f,
+			struct snd_seq_event_cell *cell)
+{
+	if (f->head == cell) {
+		struct rb_node *next = rb_next(&cell->node);
+		f->head = next ? rb_entry(next, struct snd_seq_event_cell, node)
+			: NULL;
+	}
+	rb_erase(&cell->node, &f->root);
+	f->cells--;
+}
+
 /* enqueue cell to prioq */
 int snd_seq_prioq_cell_in(struct snd_seq_prioq * f,
 			  struct snd_seq_event_cell * cell)
 {
-	struct snd_seq_event_cell *cur, *prev;
+	struct rb_node **p, *parent = NULL;
 	unsigned long flags;
-	int count;
+	int leftmost = 1;
 	int prior;
 
 	if (snd_BUG_ON(!f || !cell))
@@ -161,56 +160,30 @@ int snd_seq_prioq_cell_in(struct snd_seq_prioq * f,
 
 	spin_lock_irqsave(&f->lock, flags);
 
-	/* check if this element needs to inserted at the end (ie. ordered 
-	   data is inserted) This will be very likeley if a sequencer 
-	   application or midi file player is feeding us (sequential) data */
-	if (f->tail && !prior) {
-		if (compare_timestamp(&cell->event, &f->tail->event)) {
-			/* add new cell to tail of the fifo */
-			f->tail->next = cell;
-			f->tail = cell;
-			cell->next = NULL;
-			f->cells++;
-			spin_unlock_irqrestore(&f->lock, flags);
-			return 0;
-		}
-	}
-	/* traverse list of elements to find the place where the new cell is
-	   to be inserted... Note that this is a order n process ! */
-
-	prev = NULL;		/* previous cell */
-	cur = f->head;		/* cursor */
-
-	count = 10000; /* FIXME: enough big, isn't it? */
-	while (cur != NULL) {
-		/* compare timestamps */
-		int rel = compare_timestamp_rel(&cell->event, &cur->event);
-		if (rel < 0)
-			/* new cell has earlier schedule time, */
-			break;
-		else if (rel == 0 && prior)
-			/* equal schedule time and prior to others */
-			break;
-		/* new cell has equal or larger schedule time, */
-		/* move cursor to next cell */
-		prev = cur;
-		cur = cur->next;
-		if (! --count) {
-			spin_unlock_irqrestore(&f->lock, flags);
-			snd_printk(KERN_ERR "cannot find a pointer.. infinite loop?\n");
-			return -EINVAL;
+	if (prior)
+		cell->order = f->order_head--;
+	else
+		cell->order = f->order_tail++;
+
+	p = &f->root.rb_node;
+	while (*p) {
+		struct snd_seq_event_cell *cur;
+
+		parent = *p;
+		cur = rb_entry(parent, struct snd_seq_event_cell, node);
+		if (compare_cell(cell, cur) < 0) {
+			p = &parent->rb_left;
+		} else {
+			p = &parent->rb_right;
+			leftmost = 0;
 		}
 	}
+	rb_link_node(&cell->node, parent, p);
+	rb_insert_color(&cell->node, &f->root);
+	cell->next = NULL;
 
-	/* insert it before cursor */
-	if (prev != NULL)
-		prev->next = cell;
-	cell->next = cur;
-
-	if (f->head == cur) /* this is the first cell, set head to it */
+	if (leftmost) /* this is the first cell, set head to it */
 		f->head = cell;
-	if (cur == NULL) /* reached end of the list */
-		f->tail = cell;
 	f->cells++;
 	spin_unlock_irqrestore(&f->lock, flags);
 	return 0;
@@ -229,16 +202,8 @@ struct snd_seq_event_cell *snd_seq_prioq_cell_out(struct snd_seq_prioq *f)
 	spin_lock_irqsave(&f->lock, flags);
 
 	cell = f->head;
-	if (cell) {
-		f->head = cell->next;
-
-		/* reset tail if this was the last element */
-		if (f->tail == cell)
-			f->tail = NULL;
-
-		cell->next = NULL;
-		f->cells--;
-	}
+	if (cell)
+		prioq_erase(f, cell);
 
 	spin_unlock_irqrestore(&f->lock, flags);
 	return cell;
@@ -291,26 +256,19 @@ static inline int prioq_match(struct snd_seq_event_cell *cell,
 /* remove cells for left client */
 void snd_seq_prioq_leave(struct snd_seq_prioq * f, int client, int timestamp)
 {
-	register struct snd_seq_event_cell *cell, *next;
+	struct snd_seq_event_cell *cell;
+	struct rb_node *node, *next;
 	unsigned long flags;
-	struct snd_seq_event_cell *prev = NULL;
 	struct snd_seq_event_cell *freefirst = NULL, *freeprev = NULL, *freenext;
 
 	/* collect all removed cells */
 	spin_lock_irqsave(&f->lock, flags);
-	cell = f->head;
-	while (cell) {
-		next = cell->next;
+	for (node = rb_first(&f->root); node; node = next) {
+		next = rb_next(node);
+		cell = rb_entry(node, struct snd_seq_event_cell, node);
 		if (prioq_match(cell, client, timestamp)) {
 			/* remove cell from prioq */
-			if (cell == f->head) {
-				f->head = cell->next;
-			} else {
-				prev->next = cell->next;
-			}
-			if (cell == f->tail)
-				f->tail = cell->next;
-			f->cells--;
+			prioq_erase(f, cell);
 			/* add cell to free list */
 			cell->next = NULL;
 			if (freefirst == NULL) {
@@ -328,9 +286,7 @@ void snd_seq_prioq_leave(struct snd_seq_prioq * f, int client, int timestamp)
 				cell->event.dest.client,
 				client);
 #endif
-			prev = cell;
 		}
-		cell = next;		
 	}
 	spin_unlock_irqrestore(&f->lock, flags);	
 
@@ -401,30 +357,21 @@ static int prioq_remove_match(struct snd_seq_remove_events *info,
 void snd_seq_prioq_remove_events(struct snd_seq_prioq * f, int client,
 				 struct snd_seq_remove_events *info)
 {
-	struct snd_seq_event_cell *cell, *next;
+	struct snd_seq_event_cell *cell;
+	struct rb_node *node, *next;
 	unsigned long flags;
-	struct snd_seq_event_cell *prev = NULL;
 	struct snd_seq_event_cell *freefirst = NULL, *freeprev = NULL, *freenext;
 
 	/* collect all removed cells */
 	spin_lock_irqsave(&f->lock, flags);
-	cell = f->head;
-
-	while (cell) {
-		next = cell->next;
+	for (node = rb_first(&f->root); node; node = next) {
+		next = rb_next(node);
+		cell = rb_entry(node, struct snd_seq_event_cell, node);
 		if (cell->event.source.client == client &&
 			prioq_remove_match(info, &cell->event)) {
 
 			/* remove cell from prioq */
-			if (cell == f->head) {
-				f->head = cell->next;
-			} else {
-				prev->next = cell->next;
-			}
-
-			if (cell == f->tail)
-				f->tail = cell->next;
-			f->cells--;
+			prioq_erase(f, cell);
 
 			/* add cell to free list */
 			cell->next = NULL;
@@ -435,10 +382,7 @@ void snd_seq_prioq_remove_events(struct snd_seq_prioq * f, int client,
 			}
 
 			freeprev = cell;
-		} else {
-			prev = cell;
 		}
-		cell = next;		
 	}
 	spin_unlock_irqrestore(&f->lock, flags);	
 
@@ -27,8 +27,10 @@
 /* === PRIOQ === */
 
 struct snd_seq_prioq {
+	struct rb_root root;		      /* cells sorted by time */
 	struct snd_seq_event_cell *head;      /* pointer to head of prioq */
-	struct snd_seq_event_cell *tail;      /* pointer to tail of prioq */
+	u64 order_head;			      /* order for prior cells */
+	u64 order_tail;			      /* order for normal cells */
 	int cells;
 	spinlock_t lock;
 };
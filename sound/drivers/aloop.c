@@ -34,6 +34,9 @@
 #include <linux/slab.h>
 #include <linux/time.h>
 #include <linux/wait.h>
+#include <linux/hrtimer.h>
+#include <linux/interrupt.h>
+#include <linux/math64.h>
 #include <linux/module.h>
 #include <linux/platform_device.h>
 #include <sound/core.h>
@@ -54,6 +57,11 @@ static char *id[SNDRV_CARDS] = SNDRV_DEFAULT_STR;	/* ID for this card */
 static bool enable[SNDRV_CARDS] = {1, [1 ... (SNDRV_CARDS - 1)] = 0};
 static int pcm_substreams[SNDRV_CARDS] = {[0 ... (SNDRV_CARDS - 1)] = 8};
 static int pcm_notify[SNDRV_CARDS];
+static int pcm_convert[SNDRV_CARDS];
+static int pcm_mix[SNDRV_CARDS];
+#ifdef CONFIG_HIGH_RES_TIMERS
+static bool hrtimer;
+#endif
 
 module_param_array(index, int, NULL, 0444);
 MODULE_PARM_DESC(index, "Index value for loopback soundcard.");
@@ -65,9 +73,25 @@ module_param_array(pcm_substreams, int, NULL, 0444);
 MODULE_PARM_DESC(pcm_substreams, "PCM substreams # (1-8) for loopback driver.");
 module_param_array(pcm_notify, int, NULL, 0444);
 MODULE_PARM_DESC(pcm_notify, "Break capture when PCM format/rate/channels changes.");
+module_param_array(pcm_convert, int, NULL, 0444);
+MODULE_PARM_DESC(pcm_convert, "Convert format/rate/channels between cable ends.");
+module_param_array(pcm_mix, int, NULL, 0444);
+MODULE_PARM_DESC(pcm_mix, "Mix playback substreams into one capture substream.");
+#ifdef CONFIG_HIGH_RES_TIMERS
+module_param(hrtimer, bool, 0644);
+MODULE_PARM_DESC(hrtimer, "Use hrtimer as the timer source for new cables.");
+#endif
 
 #define NO_PITCH 100000
 
+#define CONV_MAX_CHANNELS	32
+/* Largest resampler phase error, in frames, before it is reset */
+#define CONV_MAX_PHASE		8
+
+/* Inputs of a mixing cable use the running/valid bits from here on */
+#define MIX_INPUT_SHIFT		2
+#define MIX_GAIN_UNITY		0x10000
+
 struct loopback_pcm;
 
 struct loopback_cable {
@@ -78,11 +102,22 @@ struct loopback_cable {
 	unsigned int valid;
 	unsigned int running;
 	unsigned int pause;
+	unsigned int hrtimer :1;	/* both streams paced by hrtimers */
+	/* conversion between the cable ends, see copy_convert_buf() */
+	unsigned int convert :1;
+	s32 (*conv_get)(const void *src);
+	void (*conv_put)(void *dst, s32 val);
+	s64 conv_phase;			/* Q16 capture pos from playback pos */
+	s32 conv_frame[3][CONV_MAX_CHANNELS];
+	/* mixing cable, playback substreams are summed into the capture */
+	unsigned int mix :1;
+	struct loopback_pcm *inputs[MAX_PCM_SUBSTREAMS];
 };
 
 struct loopback_setup {
 	unsigned int notify: 1;
 	unsigned int rate_shift;
+	unsigned int mix_gain;
 	unsigned int format;
 	unsigned int rate;
 	unsigned int channels;
@@ -98,6 +133,8 @@ struct loopback {
 	struct loopback_cable *cables[MAX_PCM_SUBSTREAMS][2];
 	struct snd_pcm *pcm[2];
 	struct loopback_setup setup[MAX_PCM_SUBSTREAMS][2];
+	unsigned int convert :1;	/* cable ends may differ */
+	unsigned int mix :1;		/* N playbacks to one capture */
 };
 
 struct loopback_pcm {
@@ -115,34 +152,55 @@ struct loopback_pcm {
 	/* flags */
 	unsigned int period_update_pending :1;
 	/* timer stuff */
-	unsigned int irq_pos;		/* fractional IRQ position */
-	unsigned int period_size_frac;
+	u64 irq_pos;			/* fractional IRQ position */
+	u64 period_size_frac;
 	unsigned long last_jiffies;
 	struct timer_list timer;
+	/* hrtimer stuff */
+	ktime_t last_time;
+	struct hrtimer hrtimer;
+	struct tasklet_struct tasklet;
 };
 
 static struct platform_device *devices[SNDRV_CARDS];
 
-static inline unsigned int byte_pos(struct loopback_pcm *dpcm, unsigned int x)
+/*
+ * Positions are tracked in bytes scaled by the timer tick rate: jiffies
+ * for the system timer and microseconds for hrtimers.  Time for the
+ * latter is measured in nanoseconds, the remainder below a microsecond
+ * is carried over to the next update.
+ */
+static inline unsigned int tick_hz(struct loopback_pcm *dpcm)
+{
+	return dpcm->cable->hrtimer ? USEC_PER_SEC : HZ;
+}
+
+static inline unsigned int byte_pos(struct loopback_pcm *dpcm, u64 x)
 {
+	unsigned int bytes;
+
 	if (dpcm->pcm_rate_shift == NO_PITCH) {
-		x /= HZ;
+		bytes = div_u64(x, tick_hz(dpcm));
 	} else {
-		x = div_u64(NO_PITCH * (unsigned long long)x,
-			    HZ * (unsigned long long)dpcm->pcm_rate_shift);
+		bytes = div64_u64(NO_PITCH * x,
+				  tick_hz(dpcm) * (u64)dpcm->pcm_rate_shift);
 	}
-	return x - (x % dpcm->pcm_salign);
+	return bytes - (bytes % dpcm->pcm_salign);
 }
 
-static inline unsigned int frac_pos(struct loopback_pcm *dpcm, unsigned int x)
+static inline u64 frac_pos(struct loopback_pcm *dpcm, unsigned int x)
 {
-	if (dpcm->pcm_rate_shift == NO_PITCH) {	/* no pitch */
-		return x * HZ;
-	} else {
-		x = div_u64(dpcm->pcm_rate_shift * (unsigned long long)x * HZ,
-			    NO_PITCH);
-	}
-	return x;
+	if (dpcm->pcm_rate_shift == NO_PITCH)	/* no pitch */
+		return (u64)x * tick_hz(dpcm);
+	return div_u64(dpcm->pcm_rate_shift * (u64)x * tick_hz(dpcm),
+		       NO_PITCH);
+}
+
+static inline u64 frac_mod(u64 x, u64 period)
+{
+	if (x < period)
+		return x;
+	return x - div64_u64(x, period) * period;
 }
 
 static inline struct loopback_setup *get_setup(struct loopback_pcm *dpcm)
@@ -164,9 +222,19 @@ static inline unsigned int get_rate_shift(struct loopback_pcm *dpcm)
 	return get_setup(dpcm)->rate_shift;
 }
 
+/* Bit of this end in the cable valid, running and pause masks */
+static inline unsigned int stream_bit(struct loopback_pcm *dpcm)
+{
+	struct snd_pcm_substream *substream = dpcm->substream;
+
+	if (dpcm->cable->mix && substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
+		return 1 << (MIX_INPUT_SHIFT + substream->number);
+	return 1 << substream->stream;
+}
+
 static void loopback_timer_start(struct loopback_pcm *dpcm)
 {
-	unsigned long tick;
+	u64 tick;
 	unsigned int rate_shift = get_rate_shift(dpcm);
 
 	if (rate_shift != dpcm->pcm_rate_shift) {
@@ -174,25 +242,161 @@ static void loopback_timer_start(struct loopback_pcm *dpcm)
 		dpcm->period_size_frac = frac_pos(dpcm, dpcm->pcm_period_size);
 	}
 	if (dpcm->period_size_frac <= dpcm->irq_pos) {
-		dpcm->irq_pos %= dpcm->period_size_frac;
+		dpcm->irq_pos = frac_mod(dpcm->irq_pos, dpcm->period_size_frac);
 		dpcm->period_update_pending = 1;
 	}
 	tick = dpcm->period_size_frac - dpcm->irq_pos;
-	tick = (tick + dpcm->pcm_bps - 1) / dpcm->pcm_bps;
+	tick = div_u64(tick + dpcm->pcm_bps - 1, dpcm->pcm_bps);
+	if (dpcm->cable->hrtimer) {
+		hrtimer_start(&dpcm->hrtimer, ns_to_ktime(tick * NSEC_PER_USEC),
+			      HRTIMER_MODE_REL);
+		return;
+	}
 	dpcm->timer.expires = jiffies + tick;
 	add_timer(&dpcm->timer);
 }
 
 static inline void loopback_timer_stop(struct loopback_pcm *dpcm)
 {
+	if (dpcm->cable->hrtimer) {
+		hrtimer_cancel(&dpcm->hrtimer);
+		return;
+	}
 	del_timer(&dpcm->timer);
 	dpcm->timer.expires = 0;
 }
 
+/* Wait for anything still running from the timer, must not be atomic */
+static inline void loopback_timer_sync(struct loopback_pcm *dpcm)
+{
+	if (dpcm->cable->hrtimer) {
+		hrtimer_cancel(&dpcm->hrtimer);
+		tasklet_kill(&dpcm->tasklet);
+		return;
+	}
+	del_timer_sync(&dpcm->timer);
+}
+
+/* Note the start of a running period for position tracking */
+static inline void loopback_timer_mark(struct loopback_pcm *dpcm)
+{
+	if (dpcm->cable->hrtimer)
+		dpcm->last_time = ktime_get();
+	else
+		dpcm->last_jiffies = jiffies;
+}
+
+/* Timer ticks elapsed since the last update */
+static unsigned long loopback_timer_delta(struct loopback_pcm *dpcm,
+					  ktime_t now)
+{
+	unsigned long delta;
+
+	if (dpcm->cable->hrtimer) {
+		delta = div_u64(ktime_to_ns(ktime_sub(now, dpcm->last_time)),
+				NSEC_PER_USEC);
+		dpcm->last_time = ktime_add_ns(dpcm->last_time,
+					       (u64)delta * NSEC_PER_USEC);
+	} else {
+		delta = jiffies - dpcm->last_jiffies;
+		dpcm->last_jiffies += delta;
+	}
+
+	return delta;
+}
+
 #define CABLE_VALID_PLAYBACK	(1 << SNDRV_PCM_STREAM_PLAYBACK)
 #define CABLE_VALID_CAPTURE	(1 << SNDRV_PCM_STREAM_CAPTURE)
 #define CABLE_VALID_BOTH	(CABLE_VALID_PLAYBACK|CABLE_VALID_CAPTURE)
 
+/*
+ * Sample access for the cable conversion.  Samples are handled as
+ * left justified 32 bit values; floats can't be converted without the
+ * FPU so the cable ends must match for those.
+ */
+static s32 conv_get_s16_le(const void *src)
+{
+	return (s16)le16_to_cpup(src) << 16;
+}
+
+static s32 conv_get_s16_be(const void *src)
+{
+	return (s16)be16_to_cpup(src) << 16;
+}
+
+static s32 conv_get_s32_le(const void *src)
+{
+	return le32_to_cpup(src);
+}
+
+static s32 conv_get_s32_be(const void *src)
+{
+	return be32_to_cpup(src);
+}
+
+static void conv_put_s16_le(void *dst, s32 val)
+{
+	*(__le16 *)dst = cpu_to_le16(val >> 16);
+}
+
+static void conv_put_s16_be(void *dst, s32 val)
+{
+	*(__be16 *)dst = cpu_to_be16(val >> 16);
+}
+
+static void conv_put_s32_le(void *dst, s32 val)
+{
+	*(__le32 *)dst = cpu_to_le32(val);
+}
+
+static void conv_put_s32_be(void *dst, s32 val)
+{
+	*(__be32 *)dst = cpu_to_be32(val);
+}
+
+static const struct loopback_conv_format {
+	snd_pcm_format_t format;
+	s32 (*get)(const void *src);
+	void (*put)(void *dst, s32 val);
+} conv_formats[] = {
+	{ SNDRV_PCM_FORMAT_S16_LE, conv_get_s16_le, conv_put_s16_le },
+	{ SNDRV_PCM_FORMAT_S16_BE, conv_get_s16_be, conv_put_s16_be },
+	{ SNDRV_PCM_FORMAT_S32_LE, conv_get_s32_le, conv_put_s32_le },
+	{ SNDRV_PCM_FORMAT_S32_BE, conv_get_s32_be, conv_put_s32_be },
+};
+
+static const struct loopback_conv_format *
+conv_find_format(snd_pcm_format_t format)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(conv_formats); i++)
+		if (conv_formats[i].format == format)
+			return &conv_formats[i];
+	return NULL;
+}
+
+static int loopback_conv_setup(struct loopback_cable *cable,
+			       struct snd_pcm_runtime *play,
+			       struct snd_pcm_runtime *capt)
+{
+	const struct loopback_conv_format *src, *dst;
+	unsigned long flags;
+
+	src = conv_find_format(play->format);
+	dst = conv_find_format(capt->format);
+	if (!src || !dst)
+		return -EINVAL;
+
+	spin_lock_irqsave(&cable->lock, flags);
+	cable->conv_get = src->get;
+	cable->conv_put = dst->put;
+	cable->conv_phase = 0;
+	cable->convert = 1;
+	spin_unlock_irqrestore(&cable->lock, flags);
+	return 0;
+}
+
 static int loopback_check_format(struct loopback_cable *cable, int stream)
 {
 	struct snd_pcm_runtime *runtime, *cruntime;
@@ -212,8 +416,14 @@ static int loopback_check_format(struct loopback_cable *cable, int stream)
 	check = runtime->format != cruntime->format ||
 		runtime->rate != cruntime->rate ||
 		runtime->channels != cruntime->channels;
-	if (!check)
+	if (!check) {
+		cable->convert = 0;
 		return 0;
+	}
+	if (cable->streams[stream]->loopback->convert &&
+	    loopback_conv_setup(cable, runtime, cruntime) == 0)
+		return 0;
+	cable->convert = 0;
 	if (stream == SNDRV_PCM_STREAM_CAPTURE) {
 		return -EIO;
 	} else {
@@ -243,6 +453,23 @@ static int loopback_check_format(struct loopback_cable *cable, int stream)
 	return 0;
 }
 
+/*
+ * All ends of a mixing cable share the parameters the first one was
+ * prepared with, see params_change().
+ */
+static int loopback_mix_check_format(struct loopback_pcm *dpcm)
+{
+	struct snd_pcm_runtime *runtime = dpcm->substream->runtime;
+	struct snd_pcm_hardware *hw = &dpcm->cable->hw;
+
+	if (!(hw->formats & (1ULL << runtime->format)) ||
+	    runtime->rate < hw->rate_min || runtime->rate > hw->rate_max ||
+	    runtime->channels < hw->channels_min ||
+	    runtime->channels > hw->channels_max)
+		return -EIO;
+	return 0;
+}
+
 static void loopback_active_notify(struct loopback_pcm *dpcm)
 {
 	snd_ctl_notify(dpcm->loopback->card,
@@ -255,18 +482,22 @@ static int loopback_trigger(struct snd_pcm_substream *substream, int cmd)
 	struct snd_pcm_runtime *runtime = substream->runtime;
 	struct loopback_pcm *dpcm = runtime->private_data;
 	struct loopback_cable *cable = dpcm->cable;
-	int err, stream = 1 << substream->stream;
+	int err, stream = stream_bit(dpcm);
 
 	switch (cmd) {
 	case SNDRV_PCM_TRIGGER_START:
-		err = loopback_check_format(cable, substream->stream);
+		if (cable->mix)
+			err = loopback_mix_check_format(dpcm);
+		else
+			err = loopback_check_format(cable, substream->stream);
 		if (err < 0)
 			return err;
-		dpcm->last_jiffies = jiffies;
+		loopback_timer_mark(dpcm);
 		dpcm->pcm_rate_shift = 0;
 		spin_lock(&cable->lock);	
 		cable->running |= stream;
 		cable->pause &= ~stream;
+		cable->conv_phase = 0;
 		spin_unlock(&cable->lock);
 		loopback_timer_start(dpcm);
 		if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
@@ -289,7 +520,7 @@ static int loopback_trigger(struct snd_pcm_substream *substream, int cmd)
 		break;
 	case SNDRV_PCM_TRIGGER_PAUSE_RELEASE:
 		spin_lock(&cable->lock);
-		dpcm->last_jiffies = jiffies;
+		loopback_timer_mark(dpcm);
 		cable->pause &= ~stream;
 		spin_unlock(&cable->lock);
 		loopback_timer_start(dpcm);
@@ -318,6 +549,7 @@ static void params_change(struct snd_pcm_substream *substream)
 	struct snd_pcm_runtime *runtime = substream->runtime;
 	struct loopback_pcm *dpcm = runtime->private_data;
 	struct loopback_cable *cable = dpcm->cable;
+	int i;
 
 	cable->hw.formats = (1ULL << runtime->format);
 	cable->hw.rate_min = runtime->rate;
@@ -328,6 +560,9 @@ static void params_change(struct snd_pcm_substream *substream)
 				runtime);
 	params_change_substream(cable->streams[SNDRV_PCM_STREAM_CAPTURE],
 				runtime);
+	if (cable->mix)
+		for (i = 0; i < MAX_PCM_SUBSTREAMS; i++)
+			params_change_substream(cable->inputs[i], runtime);
 }
 
 static int loopback_prepare(struct snd_pcm_substream *substream)
@@ -359,11 +594,12 @@ static int loopback_prepare(struct snd_pcm_substream *substream)
 	dpcm->pcm_period_size = frames_to_bytes(runtime, runtime->period_size);
 
 	mutex_lock(&dpcm->loopback->cable_lock);
-	if (!(cable->valid & ~(1 << substream->stream)) ||
-            (get_setup(dpcm)->notify &&
-	     substream->stream == SNDRV_PCM_STREAM_PLAYBACK))
+	if (!dpcm->loopback->convert &&
+	    (!(cable->valid & ~stream_bit(dpcm)) ||
+	     (get_setup(dpcm)->notify && !cable->mix &&
+	      substream->stream == SNDRV_PCM_STREAM_PLAYBACK)))
 		params_change(substream);
-	cable->valid |= 1 << substream->stream;
+	cable->valid |= stream_bit(dpcm);
 	mutex_unlock(&dpcm->loopback->cable_lock);
 
 	return 0;
@@ -395,19 +631,13 @@ static void clear_capture_buf(struct loopback_pcm *dpcm, unsigned int bytes)
 	}
 }
 
-static void copy_play_buf(struct loopback_pcm *play,
-			  struct loopback_pcm *capt,
-			  unsigned int bytes)
+/* check if playback is draining, trim the number of bytes which can be
+ * read when our pointer is at the end of playback ring buffer */
+static unsigned int play_avail_bytes(struct loopback_pcm *play,
+				     unsigned int bytes)
 {
 	struct snd_pcm_runtime *runtime = play->substream->runtime;
-	char *src = runtime->dma_area;
-	char *dst = capt->substream->runtime->dma_area;
-	unsigned int src_off = play->buf_pos;
-	unsigned int dst_off = capt->buf_pos;
-	unsigned int clear_bytes = 0;
 
-	/* check if playback is draining, trim the capture copy size
-	 * when our pointer is at the end of playback ring buffer */
 	if (runtime->status->state == SNDRV_PCM_STATE_DRAINING &&
 	    snd_pcm_playback_hw_avail(runtime) < runtime->buffer_size) { 
 	    	snd_pcm_uframes_t appl_ptr, appl_ptr1, diff;
@@ -417,10 +647,28 @@ static void copy_play_buf(struct loopback_pcm *play,
 		if (appl_ptr < appl_ptr1)
 			appl_ptr1 -= runtime->buffer_size;
 		diff = (appl_ptr - appl_ptr1) * play->pcm_salign;
-		if (diff < bytes) {
-			clear_bytes = bytes - diff;
-			bytes = diff;
-		}
+		if (diff < bytes)
+			return diff;
+	}
+	return bytes;
+}
+
+static void copy_play_buf(struct loopback_pcm *play,
+			  struct loopback_pcm *capt,
+			  unsigned int bytes)
+{
+	struct snd_pcm_runtime *runtime = play->substream->runtime;
+	char *src = runtime->dma_area;
+	char *dst = capt->substream->runtime->dma_area;
+	unsigned int src_off = play->buf_pos;
+	unsigned int dst_off = capt->buf_pos;
+	unsigned int clear_bytes = 0;
+	unsigned int avail;
+
+	avail = play_avail_bytes(play, bytes);
+	if (avail < bytes) {
+		clear_bytes = bytes - avail;
+		bytes = avail;
 	}
 
 	for (;;) {
@@ -444,24 +692,139 @@ static void copy_play_buf(struct loopback_pcm *play,
 	}
 }
 
+static inline unsigned int pitch_shift(struct loopback_pcm *dpcm)
+{
+	return dpcm->pcm_rate_shift ? dpcm->pcm_rate_shift : NO_PITCH;
+}
+
+/*
+ * Fill the capture buffer from playback through a format conversion,
+ * channel remap and linear interpolating resampler.  The resampler
+ * position is kept as a Q16 frame offset from the playback pointer; it
+ * steps at the ratio of the two (pitch shifted) rates with a gentle
+ * correction keeping it from drifting away from the playback pointer.
+ */
+static void copy_convert_buf(struct loopback_pcm *play,
+			     struct loopback_pcm *capt,
+			     unsigned int bytes)
+{
+	struct loopback_cable *cable = play->cable;
+	struct snd_pcm_runtime *prt = play->substream->runtime;
+	struct snd_pcm_runtime *crt = capt->substream->runtime;
+	unsigned int src_ch = prt->channels, dst_ch = crt->channels;
+	unsigned int src_width = play->pcm_salign / src_ch;
+	unsigned int dst_width = capt->pcm_salign / dst_ch;
+	unsigned int src_frames = play->pcm_buffer_size / play->pcm_salign;
+	unsigned int src_base = play->buf_pos / play->pcm_salign;
+	unsigned int frames = bytes / capt->pcm_salign;
+	unsigned int avail, dst_off = capt->buf_pos;
+	s32 *a = cable->conv_frame[0], *b = cable->conv_frame[1];
+	s32 *out = cable->conv_frame[2];
+	s64 pos = cable->conv_phase;
+	s64 step;
+	unsigned int c, k, n;
+	int ipos, idx;
+	s64 sum;
+	u32 frac;
+	char *src;
+
+	if (src_ch > CONV_MAX_CHANNELS || dst_ch > CONV_MAX_CHANNELS)
+		return;
+
+	avail = play_avail_bytes(play, play->pcm_buffer_size) /
+		play->pcm_salign;
+
+	step = div64_u64(((u64)prt->rate * pitch_shift(capt)) << 16,
+			 (u64)crt->rate * pitch_shift(play));
+	if (frames)
+		step -= div_s64(cable->conv_phase, (s64)frames << 6);
+
+	for (; frames; frames--) {
+		ipos = pos >> 16;
+		frac = pos & 0xffff;
+		if (ipos + 1 >= (int)avail)
+			break;
+
+		idx = ((int)src_base + ipos) % (int)src_frames;
+		if (idx < 0)
+			idx += src_frames;
+		src = prt->dma_area + idx * play->pcm_salign;
+		for (c = 0; c < src_ch; c++)
+			a[c] = cable->conv_get(src + c * src_width);
+		if (++idx == src_frames)
+			idx = 0;
+		src = prt->dma_area + idx * play->pcm_salign;
+		for (c = 0; c < src_ch; c++) {
+			b[c] = cable->conv_get(src + c * src_width);
+			a[c] += ((s64)b[c] - a[c]) * frac >> 16;
+		}
+
+		/* fold down by averaging, or repeat channels to fill */
+		for (c = 0; c < dst_ch; c++) {
+			if (dst_ch >= src_ch) {
+				out[c] = a[c % src_ch];
+				continue;
+			}
+			for (sum = 0, n = 0, k = c; k < src_ch; k += dst_ch, n++)
+				sum += a[k];
+			out[c] = div_s64(sum, n);
+		}
+
+		for (c = 0; c < dst_ch; c++)
+			cable->conv_put(crt->dma_area + dst_off + c * dst_width,
+					out[c]);
+		dst_off += capt->pcm_salign;
+		if (dst_off >= capt->pcm_buffer_size)
+			dst_off = 0;
+		pos += step;
+	}
+	cable->conv_phase = pos;
+
+	/* playback ran dry while draining */
+	for (; frames; frames--) {
+		for (c = 0; c < dst_ch; c++)
+			cable->conv_put(crt->dma_area + dst_off + c * dst_width,
+					0);
+		dst_off += capt->pcm_salign;
+		if (dst_off >= capt->pcm_buffer_size)
+			dst_off = 0;
+	}
+
+	capt->silent_size = 0;
+}
+
+/* The playback pointer moved on, keep the resampler relative to it */
+static void loopback_conv_advance(struct loopback_cable *cable,
+				  unsigned int frames)
+{
+	cable->conv_phase -= (s64)frames << 16;
+	if (cable->conv_phase > ((s64)CONV_MAX_PHASE << 16) ||
+	    cable->conv_phase < -((s64)CONV_MAX_PHASE << 16))
+		cable->conv_phase = 0;
+}
+
 #define BYTEPOS_UPDATE_POSONLY	0
 #define BYTEPOS_UPDATE_CLEAR	1
 #define BYTEPOS_UPDATE_COPY	2
 
-static void loopback_bytepos_update(struct loopback_pcm *dpcm,
-				    unsigned int delta,
-				    unsigned int cmd)
+static unsigned int loopback_bytepos_update(struct loopback_pcm *dpcm,
+					    unsigned int delta,
+					    unsigned int cmd)
 {
 	unsigned int count;
 	unsigned long last_pos;
 
 	last_pos = byte_pos(dpcm, dpcm->irq_pos);
-	dpcm->irq_pos += delta * dpcm->pcm_bps;
+	dpcm->irq_pos += (u64)delta * dpcm->pcm_bps;
 	count = byte_pos(dpcm, dpcm->irq_pos) - last_pos;
 	if (!count)
-		return;
+		return 0;
 	if (cmd == BYTEPOS_UPDATE_CLEAR)
 		clear_capture_buf(dpcm, count);
+	else if (cmd == BYTEPOS_UPDATE_COPY && dpcm->cable->convert)
+		copy_convert_buf(dpcm->cable->streams[SNDRV_PCM_STREAM_PLAYBACK],
+				 dpcm->cable->streams[SNDRV_PCM_STREAM_CAPTURE],
+				 count);
 	else if (cmd == BYTEPOS_UPDATE_COPY)
 		copy_play_buf(dpcm->cable->streams[SNDRV_PCM_STREAM_PLAYBACK],
 			      dpcm->cable->streams[SNDRV_PCM_STREAM_CAPTURE],
@@ -469,9 +832,187 @@ static void loopback_bytepos_update(struct loopback_pcm *dpcm,
 	dpcm->buf_pos += count;
 	dpcm->buf_pos %= dpcm->pcm_buffer_size;
 	if (dpcm->irq_pos >= dpcm->period_size_frac) {
-		dpcm->irq_pos %= dpcm->period_size_frac;
+		dpcm->irq_pos = frac_mod(dpcm->irq_pos, dpcm->period_size_frac);
 		dpcm->period_update_pending = 1;
 	}
+	return count;
+}
+
+/*
+ * Mixing kernels for the native endian formats a mixing cable accepts.
+ * Each input is added to the capture buffer with saturation; the unity
+ * gain case is unrolled as it is by far the most common one.
+ */
+static inline s16 mix_sat16(s32 v)
+{
+	return clamp_t(s32, v, SHRT_MIN, SHRT_MAX);
+}
+
+static inline s32 mix_sat32(s64 v)
+{
+	return clamp_t(s64, v, INT_MIN, INT_MAX);
+}
+
+static void mix_s16(void *dst, const void *src, unsigned int samples,
+		    unsigned int gain)
+{
+	s16 *d = dst;
+	const s16 *s = src;
+	unsigned int i = 0;
+
+	if (gain == MIX_GAIN_UNITY) {
+		for (; i + 4 <= samples; i += 4) {
+			d[i] = mix_sat16(d[i] + s[i]);
+			d[i + 1] = mix_sat16(d[i + 1] + s[i + 1]);
+			d[i + 2] = mix_sat16(d[i + 2] + s[i + 2]);
+			d[i + 3] = mix_sat16(d[i + 3] + s[i + 3]);
+		}
+		for (; i < samples; i++)
+			d[i] = mix_sat16(d[i] + s[i]);
+		return;
+	}
+	for (; i < samples; i++)
+		d[i] = mix_sat16(d[i] + ((s[i] * (s32)gain) >> 16));
+}
+
+static void mix_s32(void *dst, const void *src, unsigned int samples,
+		    unsigned int gain)
+{
+	s32 *d = dst;
+	const s32 *s = src;
+	unsigned int i = 0;
+
+	if (gain == MIX_GAIN_UNITY) {
+		for (; i + 4 <= samples; i += 4) {
+			d[i] = mix_sat32((s64)d[i] + s[i]);
+			d[i + 1] = mix_sat32((s64)d[i + 1] + s[i + 1]);
+			d[i + 2] = mix_sat32((s64)d[i + 2] + s[i + 2]);
+			d[i + 3] = mix_sat32((s64)d[i + 3] + s[i + 3]);
+		}
+		for (; i < samples; i++)
+			d[i] = mix_sat32((s64)d[i] + s[i]);
+		return;
+	}
+	for (; i < samples; i++)
+		d[i] = mix_sat32(d[i] + (((s64)s[i] * gain) >> 16));
+}
+
+#define MIX_FORMATS	(SNDRV_PCM_FMTBIT_S16 | SNDRV_PCM_FMTBIT_S32)
+
+/* Add bytes from the playback ring at src_off into the capture ring */
+static void mix_play_buf(struct loopback_pcm *play,
+			 struct loopback_pcm *capt,
+			 unsigned int src_off, unsigned int dst_off,
+			 unsigned int bytes)
+{
+	struct snd_pcm_runtime *runtime = capt->substream->runtime;
+	char *src = play->substream->runtime->dma_area;
+	char *dst = runtime->dma_area;
+	unsigned int gain = get_setup(play)->mix_gain;
+	unsigned int width = snd_pcm_format_physical_width(runtime->format) / 8;
+	void (*mix)(void *dst, const void *src, unsigned int samples,
+		    unsigned int gain);
+
+	if (!gain)
+		return;
+	mix = width == 2 ? mix_s16 : mix_s32;
+
+	while (bytes) {
+		unsigned int size = bytes;
+		if (src_off + size > play->pcm_buffer_size)
+			size = play->pcm_buffer_size - src_off;
+		if (dst_off + size > capt->pcm_buffer_size)
+			size = capt->pcm_buffer_size - dst_off;
+		mix(dst + dst_off, src + src_off, size / width, gain);
+		bytes -= size;
+		src_off = (src_off + size) % play->pcm_buffer_size;
+		dst_off = (dst_off + size) % capt->pcm_buffer_size;
+	}
+}
+
+/* Silence capture bytes at dst_off, the mixed formats are all signed */
+static void zero_capture_buf(struct loopback_pcm *capt,
+			     unsigned int dst_off, unsigned int bytes)
+{
+	char *dst = capt->substream->runtime->dma_area;
+
+	while (bytes) {
+		unsigned int size = bytes;
+		if (dst_off + size > capt->pcm_buffer_size)
+			size = capt->pcm_buffer_size - dst_off;
+		memset(dst + dst_off, 0, size);
+		bytes -= size;
+		dst_off = 0;
+	}
+	capt->silent_size = 0;
+}
+
+/*
+ * A mixing cable advances every running input together with the
+ * capture.  Input time not covered by the capture only moves the input
+ * pointer, as for an ordinary cable; an input which started later than
+ * the capture is mixed into the tail of the capture span.
+ */
+static unsigned int loopback_mix_pos_update(struct loopback_cable *cable)
+{
+	struct loopback_pcm *capt = cable->streams[SNDRV_PCM_STREAM_CAPTURE];
+	struct loopback_pcm *play;
+	unsigned long delta[MAX_PCM_SUBSTREAMS];
+	unsigned long delta_capt = 0;
+	unsigned int running, inputs, count, bytes, avail;
+	unsigned int capt_off, play_off;
+	unsigned long flags;
+	int i;
+	ktime_t now = cable->hrtimer ? ktime_get() : ktime_set(0, 0);
+
+	spin_lock_irqsave(&cable->lock, flags);
+	running = cable->running ^ cable->pause;
+	if (running & (1 << SNDRV_PCM_STREAM_CAPTURE))
+		delta_capt = loopback_timer_delta(capt, now);
+
+	inputs = 0;
+	for (i = 0; i < MAX_PCM_SUBSTREAMS; i++) {
+		delta[i] = 0;
+		play = cable->inputs[i];
+		if (!(running & (1 << (MIX_INPUT_SHIFT + i))))
+			continue;
+		delta[i] = loopback_timer_delta(play, now);
+		if (delta[i] > delta_capt) {
+			loopback_bytepos_update(play, delta[i] - delta_capt,
+						BYTEPOS_UPDATE_POSONLY);
+			delta[i] = delta_capt;
+		}
+		if (delta[i])
+			inputs |= 1 << i;
+	}
+
+	if (!delta_capt)
+		goto unlock;
+	if (!inputs) {
+		loopback_bytepos_update(capt, delta_capt, BYTEPOS_UPDATE_CLEAR);
+		goto unlock;
+	}
+
+	capt_off = capt->buf_pos;
+	count = loopback_bytepos_update(capt, delta_capt,
+					BYTEPOS_UPDATE_POSONLY);
+	zero_capture_buf(capt, capt_off, count);
+	for (i = 0; i < MAX_PCM_SUBSTREAMS; i++) {
+		if (!(inputs & (1 << i)))
+			continue;
+		play = cable->inputs[i];
+		play_off = play->buf_pos;
+		avail = play_avail_bytes(play, play->pcm_buffer_size);
+		bytes = loopback_bytepos_update(play, delta[i],
+						BYTEPOS_UPDATE_POSONLY);
+		bytes = min(bytes, count);
+		mix_play_buf(play, capt, play_off,
+			     (capt_off + count - bytes) % capt->pcm_buffer_size,
+			     min(bytes, avail));
+	}
+ unlock:
+	spin_unlock_irqrestore(&cable->lock, flags);
+	return running;
 }
 
 static unsigned int loopback_pos_update(struct loopback_cable *cable)
@@ -481,20 +1022,21 @@ static unsigned int loopback_pos_update(struct loopback_cable *cable)
 	struct loopback_pcm *dpcm_capt =
 			cable->streams[SNDRV_PCM_STREAM_CAPTURE];
 	unsigned long delta_play = 0, delta_capt = 0;
-	unsigned int running;
+	unsigned int running, count;
 	unsigned long flags;
+	ktime_t now;
 
+	if (cable->mix)
+		return loopback_mix_pos_update(cable);
+
+	now = cable->hrtimer ? ktime_get() : ktime_set(0, 0);
 	spin_lock_irqsave(&cable->lock, flags);
 	running = cable->running ^ cable->pause;
-	if (running & (1 << SNDRV_PCM_STREAM_PLAYBACK)) {
-		delta_play = jiffies - dpcm_play->last_jiffies;
-		dpcm_play->last_jiffies += delta_play;
-	}
+	if (running & (1 << SNDRV_PCM_STREAM_PLAYBACK))
+		delta_play = loopback_timer_delta(dpcm_play, now);
 
-	if (running & (1 << SNDRV_PCM_STREAM_CAPTURE)) {
-		delta_capt = jiffies - dpcm_capt->last_jiffies;
-		dpcm_capt->last_jiffies += delta_capt;
-	}
+	if (running & (1 << SNDRV_PCM_STREAM_CAPTURE))
+		delta_capt = loopback_timer_delta(dpcm_capt, now);
 
 	if (delta_play == 0 && delta_capt == 0)
 		goto unlock;
@@ -514,19 +1056,35 @@ static unsigned int loopback_pos_update(struct loopback_cable *cable)
 
 	/* note delta_capt == delta_play at this moment */
 	loopback_bytepos_update(dpcm_capt, delta_capt, BYTEPOS_UPDATE_COPY);
-	loopback_bytepos_update(dpcm_play, delta_play, BYTEPOS_UPDATE_POSONLY);
+	count = loopback_bytepos_update(dpcm_play, delta_play,
+					BYTEPOS_UPDATE_POSONLY);
+	if (cable->convert)
+		loopback_conv_advance(cable, count / dpcm_play->pcm_salign);
  unlock:
 	spin_unlock_irqrestore(&cable->lock, flags);
 	return running;
 }
 
+/*
+ * The hrtimer only kicks the tasklet; the buffer copy and period
+ * handling are the same as for the system timer.
+ */
+static enum hrtimer_restart loopback_hrtimer_callback(struct hrtimer *timer)
+{
+	struct loopback_pcm *dpcm;
+
+	dpcm = container_of(timer, struct loopback_pcm, hrtimer);
+	tasklet_schedule(&dpcm->tasklet);
+	return HRTIMER_NORESTART;
+}
+
 static void loopback_timer_function(unsigned long data)
 {
 	struct loopback_pcm *dpcm = (struct loopback_pcm *)data;
 	unsigned int running;
 
 	running = loopback_pos_update(dpcm->cable);
-	if (running & (1 << dpcm->substream->stream)) {
+	if (running & stream_bit(dpcm)) {
 		loopback_timer_start(dpcm);
 		if (dpcm->period_update_pending) {
 			dpcm->period_update_pending = 0;
@@ -586,11 +1144,20 @@ static int loopback_hw_free(struct snd_pcm_substream *substream)
 	struct loopback_cable *cable = dpcm->cable;
 
 	mutex_lock(&dpcm->loopback->cable_lock);
-	cable->valid &= ~(1 << substream->stream);
+	cable->valid &= ~stream_bit(dpcm);
 	mutex_unlock(&dpcm->loopback->cable_lock);
 	return snd_pcm_lib_free_vmalloc_buffer(substream);
 }
 
+/* All playback substreams of a mixing card share the first cable */
+static inline unsigned int
+get_cable_substream(struct snd_pcm_substream *substream)
+{
+	struct loopback *loopback = substream->private_data;
+
+	return loopback->mix ? 0 : substream->number;
+}
+
 static unsigned int get_cable_index(struct snd_pcm_substream *substream)
 {
 	if (!substream->pcm->device)
@@ -659,8 +1226,12 @@ static int loopback_open(struct snd_pcm_substream *substream)
 	dpcm->substream = substream;
 	setup_timer(&dpcm->timer, loopback_timer_function,
 		    (unsigned long)dpcm);
+	hrtimer_init(&dpcm->hrtimer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	dpcm->hrtimer.function = loopback_hrtimer_callback;
+	tasklet_init(&dpcm->tasklet, loopback_timer_function,
+		     (unsigned long)dpcm);
 
-	cable = loopback->cables[substream->number][dev];
+	cable = loopback->cables[get_cable_substream(substream)][dev];
 	if (!cable) {
 		cable = kzalloc(sizeof(*cable), GFP_KERNEL);
 		if (!cable) {
@@ -670,10 +1241,20 @@ static int loopback_open(struct snd_pcm_substream *substream)
 		}
 		spin_lock_init(&cable->lock);
 		cable->hw = loopback_pcm_hardware;
-		loopback->cables[substream->number][dev] = cable;
+#ifdef CONFIG_HIGH_RES_TIMERS
+		cable->hrtimer = hrtimer;
+#endif
+		if (loopback->mix) {
+			cable->mix = 1;
+			cable->hw.formats &= MIX_FORMATS;
+		}
+		loopback->cables[get_cable_substream(substream)][dev] = cable;
 	}
 	dpcm->cable = cable;
-	cable->streams[substream->stream] = dpcm;
+	if (cable->mix && substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
+		cable->inputs[substream->number] = dpcm;
+	else
+		cable->streams[substream->stream] = dpcm;
 
 	snd_pcm_hw_constraint_integer(runtime, SNDRV_PCM_HW_PARAM_PERIODS);
 
@@ -701,7 +1282,7 @@ static int loopback_open(struct snd_pcm_substream *substream)
 
 	runtime->private_data = dpcm;
 	runtime->private_free = loopback_runtime_free;
-	if (get_notify(dpcm))
+	if (!cable->mix && (get_notify(dpcm) || loopback->convert))
 		runtime->hw = loopback_pcm_hardware;
 	else
 		runtime->hw = cable->hw;
@@ -710,22 +1291,39 @@ static int loopback_open(struct snd_pcm_substream *substream)
 	return err;
 }
 
+static bool cable_in_use(struct loopback_cable *cable)
+{
+	int i;
+
+	if (cable->streams[0] || cable->streams[1])
+		return true;
+	for (i = 0; i < MAX_PCM_SUBSTREAMS; i++)
+		if (cable->inputs[i])
+			return true;
+	return false;
+}
+
 static int loopback_close(struct snd_pcm_substream *substream)
 {
 	struct loopback *loopback = substream->private_data;
 	struct loopback_pcm *dpcm = substream->runtime->private_data;
 	struct loopback_cable *cable;
 	int dev = get_cable_index(substream);
+	int sub = get_cable_substream(substream);
+	unsigned long flags;
 
-	loopback_timer_stop(dpcm);
+	loopback_timer_sync(dpcm);
 	mutex_lock(&loopback->cable_lock);
-	cable = loopback->cables[substream->number][dev];
-	if (cable->streams[!substream->stream]) {
-		/* other stream is still alive */
+	cable = loopback->cables[sub][dev];
+	spin_lock_irqsave(&cable->lock, flags);
+	if (cable->mix && substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
+		cable->inputs[substream->number] = NULL;
+	else
 		cable->streams[substream->stream] = NULL;
-	} else {
+	spin_unlock_irqrestore(&cable->lock, flags);
+	if (!cable_in_use(cable)) {
 		/* free the cable */
-		loopback->cables[substream->number][dev] = NULL;
+		loopback->cables[sub][dev] = NULL;
 		kfree(cable);
 	}
 	mutex_unlock(&loopback->cable_lock);
@@ -765,7 +1363,7 @@ static int __devinit loopback_pcm_new(struct loopback *loopback,
 	int err;
 
 	err = snd_pcm_new(loopback->card, "Loopback PCM", device,
-			  substreams, substreams, &pcm);
+			  substreams, loopback->mix ? 1 : substreams, &pcm);
 	if (err < 0)
 		return err;
 	snd_pcm_set_ops(pcm, SNDRV_PCM_STREAM_PLAYBACK, &loopback_playback_ops);
@@ -824,6 +1422,44 @@ static int loopback_rate_shift_put(struct snd_kcontrol *kcontrol,
 	return change;
 }
 
+static int loopback_mix_gain_info(struct snd_kcontrol *kcontrol,
+				  struct snd_ctl_elem_info *uinfo)
+{
+	uinfo->type = SNDRV_CTL_ELEM_TYPE_INTEGER;
+	uinfo->count = 1;
+	uinfo->value.integer.min = 0;
+	uinfo->value.integer.max = MIX_GAIN_UNITY;
+	uinfo->value.integer.step = 1;
+	return 0;
+}
+
+static int loopback_mix_gain_get(struct snd_kcontrol *kcontrol,
+				 struct snd_ctl_elem_value *ucontrol)
+{
+	struct loopback *loopback = snd_kcontrol_chip(kcontrol);
+
+	ucontrol->value.integer.value[0] =
+		loopback->setup[kcontrol->id.subdevice]
+			       [kcontrol->id.device].mix_gain;
+	return 0;
+}
+
+static int loopback_mix_gain_put(struct snd_kcontrol *kcontrol,
+				 struct snd_ctl_elem_value *ucontrol)
+{
+	struct loopback *loopback = snd_kcontrol_chip(kcontrol);
+	struct loopback_setup *setup;
+	unsigned int val;
+
+	val = clamp_t(long, ucontrol->value.integer.value[0],
+		      0, MIX_GAIN_UNITY);
+	setup = &loopback->setup[kcontrol->id.subdevice][kcontrol->id.device];
+	if (val == setup->mix_gain)
+		return 0;
+	setup->mix_gain = val;
+	return 1;
+}
+
 static int loopback_notify_get(struct snd_kcontrol *kcontrol,
 			       struct snd_ctl_elem_value *ucontrol)
 {
@@ -856,13 +1492,19 @@ static int loopback_active_get(struct snd_kcontrol *kcontrol,
 			       struct snd_ctl_elem_value *ucontrol)
 {
 	struct loopback *loopback = snd_kcontrol_chip(kcontrol);
-	struct loopback_cable *cable = loopback->cables
-			[kcontrol->id.subdevice][kcontrol->id.device ^ 1];
+	struct loopback_cable *cable;
+	unsigned int bit = 1 << SNDRV_PCM_STREAM_PLAYBACK;
 	unsigned int val = 0;
 
+	if (loopback->mix) {
+		cable = loopback->cables[0][kcontrol->id.device ^ 1];
+		bit = 1 << (MIX_INPUT_SHIFT + kcontrol->id.subdevice);
+	} else {
+		cable = loopback->cables[kcontrol->id.subdevice]
+					[kcontrol->id.device ^ 1];
+	}
 	if (cable != NULL)
-		val = (cable->running & (1 << SNDRV_PCM_STREAM_PLAYBACK)) ?
-									1 : 0;
+		val = (cable->running & bit) ? 1 : 0;
 	ucontrol->value.integer.value[0] = val;
 	return 0;
 }
@@ -982,6 +1624,14 @@ static struct snd_kcontrol_new loopback_controls[]  __devinitdata = {
 }
 };
 
+static struct snd_kcontrol_new loopback_mix_gain_control __devinitdata = {
+	.iface =        SNDRV_CTL_ELEM_IFACE_PCM,
+	.name =         "PCM Mix Gain 65536",
+	.info =         loopback_mix_gain_info,
+	.get =          loopback_mix_gain_get,
+	.put =          loopback_mix_gain_put,
+};
+
 static int __devinit loopback_mixer_new(struct loopback *loopback, int notify)
 {
 	struct snd_card *card = loopback->card;
@@ -994,11 +1644,12 @@ static int __devinit loopback_mixer_new(struct loopback *loopback, int notify)
 	for (dev = 0; dev < 2; dev++) {
 		pcm = loopback->pcm[dev];
 		substr_count =
-		    pcm->streams[SNDRV_PCM_STREAM_CAPTURE].substream_count;
+		    pcm->streams[SNDRV_PCM_STREAM_PLAYBACK].substream_count;
 		for (substr = 0; substr < substr_count; substr++) {
 			setup = &loopback->setup[substr][dev];
 			setup->notify = notify;
 			setup->rate_shift = NO_PITCH;
+			setup->mix_gain = MIX_GAIN_UNITY;
 			setup->format = SNDRV_PCM_FORMAT_S16_LE;
 			setup->rate = 48000;
 			setup->channels = 2;
@@ -1030,6 +1681,17 @@ static int __devinit loopback_mixer_new(struct loopback *loopback, int notify)
 				if (err < 0)
 					return err;
 			}
+			if (!loopback->mix)
+				continue;
+			kctl = snd_ctl_new1(&loopback_mix_gain_control,
+					    loopback);
+			if (!kctl)
+				return -ENOMEM;
+			kctl->id.device = dev;
+			kctl->id.subdevice = substr;
+			err = snd_ctl_add(card, kctl);
+			if (err < 0)
+				return err;
 		}
 	}
 	return 0;
@@ -1055,8 +1717,18 @@ static void print_dpcm_info(struct snd_info_buffer *buffer,
 	snd_iprintf(buffer, "    rate_shift:\t\t%u\n", dpcm->pcm_rate_shift);
 	snd_iprintf(buffer, "    update_pending:\t%u\n",
 						dpcm->period_update_pending);
-	snd_iprintf(buffer, "    irq_pos:\t\t%u\n", dpcm->irq_pos);
-	snd_iprintf(buffer, "    period_frac:\t%u\n", dpcm->period_size_frac);
+	snd_iprintf(buffer, "    irq_pos:\t\t%llu\n",
+		    (unsigned long long)dpcm->irq_pos);
+	snd_iprintf(buffer, "    period_frac:\t%llu\n",
+		    (unsigned long long)dpcm->period_size_frac);
+	if (dpcm->cable->hrtimer) {
+		snd_iprintf(buffer, "    last_time:\t\t%lld (%lld)\n",
+			    ktime_to_ns(dpcm->last_time),
+			    ktime_to_ns(ktime_get()));
+		snd_iprintf(buffer, "    hrtimer_active:\t%d\n",
+			    hrtimer_active(&dpcm->hrtimer));
+		return;
+	}
 	snd_iprintf(buffer, "    last_jiffies:\t%lu (%lu)\n",
 					dpcm->last_jiffies, jiffies);
 	snd_iprintf(buffer, "    timer_expires:\t%lu\n", dpcm->timer.expires);
@@ -1077,7 +1749,23 @@ static void print_substream_info(struct snd_info_buffer *buffer,
 	snd_iprintf(buffer, "  valid: %u\n", cable->valid);
 	snd_iprintf(buffer, "  running: %u\n", cable->running);
 	snd_iprintf(buffer, "  pause: %u\n", cable->pause);
-	print_dpcm_info(buffer, cable->streams[0], "Playback");
+	snd_iprintf(buffer, "  convert: %u\n", cable->convert);
+	if (cable->convert)
+		snd_iprintf(buffer, "  convert_phase: %lld\n",
+			    (long long)cable->conv_phase);
+	if (cable->mix) {
+		char name[16];
+		int i;
+
+		for (i = 0; i < MAX_PCM_SUBSTREAMS; i++) {
+			if (!cable->inputs[i])
+				continue;
+			sprintf(name, "Playback %i", i);
+			print_dpcm_info(buffer, cable->inputs[i], name);
+		}
+	} else {
+		print_dpcm_info(buffer, cable->streams[0], "Playback");
+	}
 	print_dpcm_info(buffer, cable->streams[1], "Capture");
 }
 
@@ -1135,6 +1823,9 @@ static int __devinit loopback_probe(struct platform_device *devptr)
 		pcm_substreams[dev] = MAX_PCM_SUBSTREAMS;
 	
 	loopback->card = card;
+	loopback->mix = pcm_mix[dev] ? 1 : 0;
+	/* a mixing cable has no single playback end to convert from */
+	loopback->convert = pcm_convert[dev] && !pcm_mix[dev] ? 1 : 0;
 	mutex_init(&loopback->cable_lock);
 
 	err = loopback_pcm_new(loopback, 0, pcm_substreams[dev]);
@@ -200,8 +200,7 @@ static int snd_soc_dapm_put_volsw_aic3x(struct snd_kcontrol *kcontrol,
 				/* old connection must be powered down */
 				path->connect = invert ? 1 : 0;
 
-			dapm_mark_dirty(path->source, "tlv320aic3x source");
-			dapm_mark_dirty(path->sink, "tlv320aic3x sink");
+			dapm_mark_path_dirty(path, "tlv320aic3x");
 
 			break;
 		}
@@ -832,7 +831,11 @@ static int aic3x_hw_params(struct snd_pcm_substream *substream,
 	int codec_clk = 0, bypass_pll = 0, fsref, last_clk = 0;
 	u8 data, j, r, p, pll_q, pll_p = 1, pll_r = 1, pll_j = 1;
 	u16 d, pll_d = 1;
-	int clk;
+	int clk, ret = 0, err;
+	bool deferred;
+
+	/* Combine the clocking setup into as few bus writes as possible */
+	deferred = snd_soc_codec_defer_writes(codec) == 0;
 
 	/* select data word length */
 	data = snd_soc_read(codec, AIC3X_ASD_INTF_CTRLB) & (~(0x3 << 4));
@@ -894,7 +897,7 @@ static int aic3x_hw_params(struct snd_pcm_substream *substream,
 	snd_soc_write(codec, AIC3X_SAMPLE_RATE_SEL_REG, data);
 
 	if (bypass_pll)
-		return 0;
+		goto out;
 
 	/* Use PLL, compute appropriate setup for j, d, r and p, the closest
 	 * one wins the game. Try with d==0 first, next with d!=0.
@@ -956,7 +959,8 @@ static int aic3x_hw_params(struct snd_pcm_substream *substream,
 
 	if (last_clk == 0) {
 		printk(KERN_ERR "%s(): unable to setup PLL\n", __func__);
-		return -EINVAL;
+		ret = -EINVAL;
+		goto out;
 	}
 
 found:
@@ -971,7 +975,13 @@ found:
 	snd_soc_write(codec, AIC3X_PLL_PROGD_REG,
 		      (pll_d & 0x3F) << PLLD_LSB_SHIFT);
 
-	return 0;
+out:
+	if (deferred) {
+		err = snd_soc_codec_end_writes(codec);
+		if (ret == 0)
+			ret = err;
+	}
+	return ret;
 }
 
 static int aic3x_mute(struct snd_soc_dai *dai, int mute)
@@ -1474,6 +1484,7 @@ static struct snd_soc_codec_driver soc_codec_dev_aic3x = {
 	.reg_cache_size = ARRAY_SIZE(aic3x_reg),
 	.reg_word_size = sizeof(u8),
 	.reg_cache_default = aic3x_reg,
+	.write_combine = true,
 	.probe = aic3x_probe,
 	.remove = aic3x_remove,
 	.suspend = aic3x_suspend,
@@ -284,6 +284,22 @@ static inline void twl4030_check_defaults(struct snd_soc_codec *codec)
 		 difference, difference ? "Not OK" : "OK");
 }
 
+/*
+ * write a range of consecutive registers from the reg_cache to the chip
+ * in a single I2C transaction
+ */
+static int twl4030_write_block(struct snd_soc_codec *codec, u8 first, u8 last)
+{
+	u8 *cache = codec->reg_cache;
+	/* first byte is reserved for the register address */
+	u8 buf[TWL4030_CACHEREGNUM + 1];
+	unsigned int count = last - first + 1;
+
+	memcpy(&buf[1], &cache[first], count);
+
+	return twl_i2c_write(TWL4030_MODULE_AUDIO_VOICE, buf, first, count);
+}
+
 static inline void twl4030_reset_registers(struct snd_soc_codec *codec)
 {
 	int i;
@@ -291,8 +307,19 @@ static inline void twl4030_reset_registers(struct snd_soc_codec *codec)
 	/* set all audio section registers to reasonable defaults */
 	for (i = TWL4030_REG_OPTION; i <= TWL4030_REG_MISC_SET_2; i++)
 		if (i != TWL4030_REG_APLL_CTL)
-			twl4030_write(codec, i, twl4030_reg[i]);
+			twl4030_write_reg_cache(codec, i, twl4030_reg[i]);
 
+	/*
+	 * and push them in three bursts, skipping APLL_CTL and the unused
+	 * 0x40 - 0x42 range. The gated output gain registers are written as
+	 * well, their defaults keep the outputs powered down.
+	 */
+	twl4030_write_block(codec, TWL4030_REG_OPTION,
+			    TWL4030_REG_APLL_CTL - 1);
+	twl4030_write_block(codec, TWL4030_REG_APLL_CTL + 1,
+			    TWL4030_REG_PCMBTMUX);
+	twl4030_write_block(codec, TWL4030_REG_RX_PATH_SEL,
+			    TWL4030_REG_MISC_SET_2);
 }
 
 static void twl4030_init_chip(struct snd_soc_codec *codec)
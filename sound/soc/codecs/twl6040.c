@@ -26,6 +26,7 @@
 #include <linux/pm.h>
 #include <linux/platform_device.h>
 #include <linux/slab.h>
+#include <linux/regmap.h>
 #include <linux/i2c/twl.h>
 #include <linux/mfd/twl6040.h>
 
@@ -103,78 +104,47 @@ struct twl6040_data {
 	struct mutex mutex;
 	struct twl6040_output headset;
 	struct twl6040_output handsfree;
+	struct regmap *regmap;
+	u8 sw_shadow;
+	u8 trim[TWL6040_TRIM_INVAL];
 };
 
 /*
  * twl6040 register cache & default register settings
+ *
+ * Only the registers owned by the codec are cached, the power, PLL,
+ * interrupt, trim and vibra control registers are shared with the core
+ * driver and always accessed through it.
  */
-static const u8 twl6040_reg[TWL6040_CACHEREGNUM] = {
-	0x00, /* not used	0x00	*/
-	0x4B, /* REG_ASICID	0x01 (ro) */
-	0x00, /* REG_ASICREV	0x02 (ro) */
-	0x00, /* REG_INTID	0x03	*/
-	0x00, /* REG_INTMR	0x04	*/
-	0x00, /* REG_NCPCTRL	0x05	*/
-	0x00, /* REG_LDOCTL	0x06	*/
-	0x60, /* REG_HPPLLCTL	0x07	*/
-	0x00, /* REG_LPPLLCTL	0x08	*/
-	0x4A, /* REG_LPPLLDIV	0x09	*/
-	0x00, /* REG_AMICBCTL	0x0A	*/
-	0x00, /* REG_DMICBCTL	0x0B	*/
-	0x00, /* REG_MICLCTL	0x0C	*/
-	0x00, /* REG_MICRCTL	0x0D	*/
-	0x00, /* REG_MICGAIN	0x0E	*/
-	0x1B, /* REG_LINEGAIN	0x0F	*/
-	0x00, /* REG_HSLCTL	0x10	*/
-	0x00, /* REG_HSRCTL	0x11	*/
-	0x00, /* REG_HSGAIN	0x12	*/
-	0x00, /* REG_EARCTL	0x13	*/
-	0x00, /* REG_HFLCTL	0x14	*/
-	0x00, /* REG_HFLGAIN	0x15	*/
-	0x00, /* REG_HFRCTL	0x16	*/
-	0x00, /* REG_HFRGAIN	0x17	*/
-	0x00, /* REG_VIBCTLL	0x18	*/
-	0x00, /* REG_VIBDATL	0x19	*/
-	0x00, /* REG_VIBCTLR	0x1A	*/
-	0x00, /* REG_VIBDATR	0x1B	*/
-	0x00, /* REG_HKCTL1	0x1C	*/
-	0x00, /* REG_HKCTL2	0x1D	*/
-	0x00, /* REG_GPOCTL	0x1E	*/
-	0x00, /* REG_ALB	0x1F	*/
-	0x00, /* REG_DLB	0x20	*/
-	0x00, /* not used	0x21	*/
-	0x00, /* not used	0x22	*/
-	0x00, /* not used	0x23	*/
-	0x00, /* not used	0x24	*/
-	0x00, /* not used	0x25	*/
-	0x00, /* not used	0x26	*/
-	0x00, /* not used	0x27	*/
-	0x00, /* REG_TRIM1	0x28	*/
-	0x00, /* REG_TRIM2	0x29	*/
-	0x00, /* REG_TRIM3	0x2A	*/
-	0x00, /* REG_HSOTRIM	0x2B	*/
-	0x00, /* REG_HFOTRIM	0x2C	*/
-	0x09, /* REG_ACCCTL	0x2D	*/
-	0x00, /* REG_STATUS	0x2E (ro) */
-
-	0x00, /* REG_SW_SHADOW	0x2F - Shadow, non HW register */
+static const struct reg_default twl6040_reg_defaults[] = {
+	{ TWL6040_REG_AMICBCTL,	0x00 },
+	{ TWL6040_REG_DMICBCTL,	0x00 },
+	{ TWL6040_REG_MICLCTL,	0x00 },
+	{ TWL6040_REG_MICRCTL,	0x00 },
+	{ TWL6040_REG_MICGAIN,	0x00 },
+	{ TWL6040_REG_LINEGAIN,	0x1B },
+	{ TWL6040_REG_HSLCTL,	0x00 },
+	{ TWL6040_REG_HSRCTL,	0x00 },
+	{ TWL6040_REG_HSGAIN,	0x00 },
+	{ TWL6040_REG_EARCTL,	0x00 },
+	{ TWL6040_REG_HFLCTL,	0x00 },
+	{ TWL6040_REG_HFLGAIN,	0x00 },
+	{ TWL6040_REG_HFRCTL,	0x00 },
+	{ TWL6040_REG_HFRGAIN,	0x00 },
+	{ TWL6040_REG_HKCTL1,	0x00 },
+	{ TWL6040_REG_HKCTL2,	0x00 },
+	{ TWL6040_REG_GPOCTL,	0x00 },
+	{ TWL6040_REG_ALB,	0x00 },
+	{ TWL6040_REG_DLB,	0x00 },
 };
 
-/* List of registers to be restored after power up */
-static const int twl6040_restore_list[] = {
-	TWL6040_REG_MICLCTL,
-	TWL6040_REG_MICRCTL,
-	TWL6040_REG_MICGAIN,
-	TWL6040_REG_LINEGAIN,
-	TWL6040_REG_HSLCTL,
-	TWL6040_REG_HSRCTL,
-	TWL6040_REG_HSGAIN,
-	TWL6040_REG_EARCTL,
-	TWL6040_REG_HFLCTL,
-	TWL6040_REG_HFLGAIN,
-	TWL6040_REG_HFRCTL,
-	TWL6040_REG_HFRGAIN,
-};
+/*
+ * Registers restored after power up, MICLCTL - HFRGAIN are consecutive so
+ * they are written back in a single I2C transaction.
+ */
+#define TWL6040_RESTORE_FIRST	TWL6040_REG_MICLCTL
+#define TWL6040_RESTORE_LAST	TWL6040_REG_HFRGAIN
+#define TWL6040_RESTORE_NUM	(TWL6040_RESTORE_LAST - TWL6040_RESTORE_FIRST + 1)
 
 /* set of rates for each pll: low-power and high-performance */
 static unsigned int lp_rates[] = {
@@ -202,51 +172,116 @@ static struct snd_pcm_hw_constraint_list sysclk_constraints[] = {
 	{ .count = ARRAY_SIZE(hp_rates), .list = hp_rates, },
 };
 
+static bool twl6040_codec_reg(struct device *dev, unsigned int reg)
+{
+	switch (reg) {
+	case TWL6040_REG_AMICBCTL ... TWL6040_REG_HFRGAIN:
+	case TWL6040_REG_HKCTL1 ... TWL6040_REG_DLB:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* registers changed by the hardware, these must not be cached */
+static bool twl6040_volatile_reg(struct device *dev, unsigned int reg)
+{
+	switch (reg) {
+	case TWL6040_REG_ASICID:
+	case TWL6040_REG_ASICREV:
+	case TWL6040_REG_INTID:
+	case TWL6040_REG_HPPLLCTL:
+	case TWL6040_REG_LPPLLCTL:
+	case TWL6040_REG_STATUS:
+		return true;
+	default:
+		return false;
+	}
+}
+
 /*
- * read twl6040 register cache
+ * regmap bus for the codec registers, accesses go through the core driver
+ * so they are serialized with its own and can span several registers.
  */
-static inline unsigned int twl6040_read_reg_cache(struct snd_soc_codec *codec,
-						unsigned int reg)
+static int twl6040_regmap_gather_write(struct device *dev,
+				       const void *reg, size_t reg_len,
+				       const void *val, size_t val_len)
 {
-	u8 *cache = codec->reg_cache;
+	struct twl6040 *twl6040 = dev_get_drvdata(dev->parent);
+	/* first byte is reserved for the register address */
+	u8 buf[TWL6040_REG_DLB + 2];
 
-	if (reg >= TWL6040_CACHEREGNUM)
-		return -EIO;
+	if (reg_len != 1 || val_len >= sizeof(buf))
+		return -EINVAL;
+
+	memcpy(&buf[1], val, val_len);
 
-	return cache[reg];
+	return twl6040_block_write(twl6040, *(u8 *)reg, buf, val_len);
 }
 
-/*
- * write twl6040 register cache
- */
-static inline void twl6040_write_reg_cache(struct snd_soc_codec *codec,
-						u8 reg, u8 value)
+static int twl6040_regmap_write(struct device *dev, const void *data,
+				size_t count)
 {
-	u8 *cache = codec->reg_cache;
+	return twl6040_regmap_gather_write(dev, data, 1, data + 1, count - 1);
+}
 
-	if (reg >= TWL6040_CACHEREGNUM)
-		return;
-	cache[reg] = value;
+static int twl6040_regmap_read(struct device *dev,
+			       const void *reg, size_t reg_size,
+			       void *val, size_t val_size)
+{
+	struct twl6040 *twl6040 = dev_get_drvdata(dev->parent);
+
+	if (reg_size != 1)
+		return -EINVAL;
+
+	return twl6040_block_read(twl6040, *(u8 *)reg, val, val_size);
 }
 
+static const struct regmap_bus twl6040_regmap_bus = {
+	.write = twl6040_regmap_write,
+	.gather_write = twl6040_regmap_gather_write,
+	.read = twl6040_regmap_read,
+};
+
+static const struct regmap_config twl6040_regmap_config = {
+	.reg_bits = 8,
+	.val_bits = 8,
+
+	.max_register = TWL6040_REG_DLB,
+	.readable_reg = twl6040_codec_reg,
+	.writeable_reg = twl6040_codec_reg,
+	.volatile_reg = twl6040_volatile_reg,
+
+	.reg_defaults = twl6040_reg_defaults,
+	.num_reg_defaults = ARRAY_SIZE(twl6040_reg_defaults),
+	.cache_type = REGCACHE_RBTREE,
+
+	.sync_raw = true,
+};
+
 /*
- * read from twl6040 hardware register
+ * read from the twl6040 register space
  */
-static int twl6040_read_reg_volatile(struct snd_soc_codec *codec,
-			unsigned int reg)
+static unsigned int twl6040_read(struct snd_soc_codec *codec,
+				 unsigned int reg)
 {
+	struct twl6040_data *priv = snd_soc_codec_get_drvdata(codec);
 	struct twl6040 *twl6040 = codec->control_data;
-	u8 value;
+	unsigned int value;
+	int ret;
 
 	if (reg >= TWL6040_CACHEREGNUM)
 		return -EIO;
 
-	if (likely(reg < TWL6040_REG_SW_SHADOW)) {
-		value = twl6040_reg_read(twl6040, reg);
-		twl6040_write_reg_cache(codec, reg, value);
-	} else {
-		value = twl6040_read_reg_cache(codec, reg);
-	}
+	if (unlikely(reg == TWL6040_REG_SW_SHADOW))
+		return priv->sw_shadow;
+
+	if (!twl6040_codec_reg(codec->dev, reg))
+		return twl6040_reg_read(twl6040, reg);
+
+	ret = regmap_read(priv->regmap, reg, &value);
+	if (ret < 0)
+		return ret;
 
 	return value;
 }
@@ -257,59 +292,72 @@ static int twl6040_read_reg_volatile(struct snd_soc_codec *codec,
 static int twl6040_write(struct snd_soc_codec *codec,
 			unsigned int reg, unsigned int value)
 {
+	struct twl6040_data *priv = snd_soc_codec_get_drvdata(codec);
 	struct twl6040 *twl6040 = codec->control_data;
 
 	if (reg >= TWL6040_CACHEREGNUM)
 		return -EIO;
 
-	twl6040_write_reg_cache(codec, reg, value);
-	if (likely(reg < TWL6040_REG_SW_SHADOW))
-		return twl6040_reg_write(twl6040, reg, value);
-	else
+	if (unlikely(reg == TWL6040_REG_SW_SHADOW)) {
+		priv->sw_shadow = value;
 		return 0;
+	}
+
+	if (!twl6040_codec_reg(codec->dev, reg))
+		return twl6040_reg_write(twl6040, reg, value);
+
+	return regmap_write(priv->regmap, reg, value);
 }
 
 static void twl6040_init_chip(struct snd_soc_codec *codec)
 {
 	struct twl6040 *twl6040 = codec->control_data;
-	u8 val;
+	struct twl6040_data *priv = snd_soc_codec_get_drvdata(codec);
+	struct regmap *regmap = priv->regmap;
+	int i;
 
-	/* Update reg_cache: ASICREV, and TRIM values */
-	val = twl6040_get_revid(twl6040);
-	twl6040_write_reg_cache(codec, TWL6040_REG_ASICREV, val);
+	/* Update TRIM values */
+	for (i = 0; i < TWL6040_TRIM_INVAL; i++)
+		priv->trim[i] = twl6040_reg_read(twl6040,
+						 TWL6040_REG_TRIM1 + i);
 
-	twl6040_read_reg_volatile(codec, TWL6040_REG_TRIM1);
-	twl6040_read_reg_volatile(codec, TWL6040_REG_TRIM2);
-	twl6040_read_reg_volatile(codec, TWL6040_REG_TRIM3);
-	twl6040_read_reg_volatile(codec, TWL6040_REG_HSOTRIM);
-	twl6040_read_reg_volatile(codec, TWL6040_REG_HFOTRIM);
+	/*
+	 * Change chip defaults, only in the cache: they reach the chip with
+	 * the register restore at power up.
+	 */
+	regcache_cache_only(regmap, true);
 
-	/* Change chip defaults */
 	/* No imput selected for microphone amplifiers */
-	twl6040_write_reg_cache(codec, TWL6040_REG_MICLCTL, 0x18);
-	twl6040_write_reg_cache(codec, TWL6040_REG_MICRCTL, 0x18);
+	regmap_write(regmap, TWL6040_REG_MICLCTL, 0x18);
+	regmap_write(regmap, TWL6040_REG_MICRCTL, 0x18);
 
 	/*
 	 * We need to lower the default gain values, so the ramp code
 	 * can work correctly for the first playback.
 	 * This reduces the pop noise heard at the first playback.
 	 */
-	twl6040_write_reg_cache(codec, TWL6040_REG_HSGAIN, 0xff);
-	twl6040_write_reg_cache(codec, TWL6040_REG_EARCTL, 0x1e);
-	twl6040_write_reg_cache(codec, TWL6040_REG_HFLGAIN, 0x1d);
-	twl6040_write_reg_cache(codec, TWL6040_REG_HFRGAIN, 0x1d);
-	twl6040_write_reg_cache(codec, TWL6040_REG_LINEGAIN, 0);
+	regmap_write(regmap, TWL6040_REG_HSGAIN, 0xff);
+	regmap_write(regmap, TWL6040_REG_EARCTL, 0x1e);
+	regmap_write(regmap, TWL6040_REG_HFLGAIN, 0x1d);
+	regmap_write(regmap, TWL6040_REG_HFRGAIN, 0x1d);
+	regmap_write(regmap, TWL6040_REG_LINEGAIN, 0);
+
+	regcache_cache_only(regmap, false);
 }
 
-static void twl6040_restore_regs(struct snd_soc_codec *codec)
+static int twl6040_restore_regs(struct snd_soc_codec *codec)
 {
-	u8 *cache = codec->reg_cache;
-	int reg, i;
+	struct twl6040_data *priv = snd_soc_codec_get_drvdata(codec);
+	u8 regs[TWL6040_RESTORE_NUM];
+	int ret;
 
-	for (i = 0; i < ARRAY_SIZE(twl6040_restore_list); i++) {
-		reg = twl6040_restore_list[i];
-		twl6040_write(codec, reg, cache[reg]);
-	}
+	ret = regmap_bulk_read(priv->regmap, TWL6040_RESTORE_FIRST, regs,
+			       TWL6040_RESTORE_NUM);
+	if (ret)
+		return ret;
+
+	return regmap_bulk_write(priv->regmap, TWL6040_RESTORE_FIRST, regs,
+				 TWL6040_RESTORE_NUM);
 }
 
 /*
@@ -322,12 +370,13 @@ static inline int twl6040_hs_ramp_step(struct snd_soc_codec *codec,
 	struct twl6040_data *priv = snd_soc_codec_get_drvdata(codec);
 	struct twl6040_output *headset = &priv->headset;
 	int left_complete = 0, right_complete = 0;
-	u8 reg, val;
+	u8 reg, val, gain;
+
+	gain = reg = twl6040_read(codec, TWL6040_REG_HSGAIN);
 
 	/* left channel */
 	left_step = (left_step > 0xF) ? 0xF : left_step;
-	reg = twl6040_read_reg_cache(codec, TWL6040_REG_HSGAIN);
-	val = (~reg & TWL6040_HSL_VOL_MASK);
+	val = (~gain & TWL6040_HSL_VOL_MASK);
 
 	if (headset->ramp == TWL6040_RAMP_UP) {
 		/* ramp step up */
@@ -337,9 +386,8 @@ static inline int twl6040_hs_ramp_step(struct snd_soc_codec *codec,
 			else
 				val += left_step;
 
-			reg &= ~TWL6040_HSL_VOL_MASK;
-			twl6040_write(codec, TWL6040_REG_HSGAIN,
-					(reg | (~val & TWL6040_HSL_VOL_MASK)));
+			gain &= ~TWL6040_HSL_VOL_MASK;
+			gain |= ~val & TWL6040_HSL_VOL_MASK;
 		} else {
 			left_complete = 1;
 		}
@@ -351,9 +399,8 @@ static inline int twl6040_hs_ramp_step(struct snd_soc_codec *codec,
 			else
 				val -= left_step;
 
-			reg &= ~TWL6040_HSL_VOL_MASK;
-			twl6040_write(codec, TWL6040_REG_HSGAIN, reg |
-						(~val & TWL6040_HSL_VOL_MASK));
+			gain &= ~TWL6040_HSL_VOL_MASK;
+			gain |= ~val & TWL6040_HSL_VOL_MASK;
 		} else {
 			left_complete = 1;
 		}
@@ -361,8 +408,7 @@ static inline int twl6040_hs_ramp_step(struct snd_soc_codec *codec,
 
 	/* right channel */
 	right_step = (right_step > 0xF) ? 0xF : right_step;
-	reg = twl6040_read_reg_cache(codec, TWL6040_REG_HSGAIN);
-	val = (~reg & TWL6040_HSR_VOL_MASK) >> TWL6040_HSR_VOL_SHIFT;
+	val = (~gain & TWL6040_HSR_VOL_MASK) >> TWL6040_HSR_VOL_SHIFT;
 
 	if (headset->ramp == TWL6040_RAMP_UP) {
 		/* ramp step up */
@@ -372,9 +418,9 @@ static inline int twl6040_hs_ramp_step(struct snd_soc_codec *codec,
 			else
 				val += right_step;
 
-			reg &= ~TWL6040_HSR_VOL_MASK;
-			twl6040_write(codec, TWL6040_REG_HSGAIN,
-				(reg | (~val << TWL6040_HSR_VOL_SHIFT)));
+			gain &= ~TWL6040_HSR_VOL_MASK;
+			gain |= (~val << TWL6040_HSR_VOL_SHIFT) &
+				TWL6040_HSR_VOL_MASK;
 		} else {
 			right_complete = 1;
 		}
@@ -386,14 +432,18 @@ static inline int twl6040_hs_ramp_step(struct snd_soc_codec *codec,
 			else
 				val -= right_step;
 
-			reg &= ~TWL6040_HSR_VOL_MASK;
-			twl6040_write(codec, TWL6040_REG_HSGAIN,
-					 reg | (~val << TWL6040_HSR_VOL_SHIFT));
+			gain &= ~TWL6040_HSR_VOL_MASK;
+			gain |= (~val << TWL6040_HSR_VOL_SHIFT) &
+				TWL6040_HSR_VOL_MASK;
 		} else {
 			right_complete = 1;
 		}
 	}
 
+	/* Both channels live in HSGAIN, update them with a single write */
+	if (gain != reg)
+		twl6040_write(codec, TWL6040_REG_HSGAIN, gain);
+
 	return left_complete & right_complete;
 }
 
@@ -410,7 +460,7 @@ static inline int twl6040_hf_ramp_step(struct snd_soc_codec *codec,
 
 	/* left channel */
 	left_step = (left_step > 0x1D) ? 0x1D : left_step;
-	reg = twl6040_read_reg_cache(codec, TWL6040_REG_HFLGAIN);
+	reg = twl6040_read(codec, TWL6040_REG_HFLGAIN);
 	reg = 0x1D - reg;
 	val = (reg & TWL6040_HF_VOL_MASK);
 	if (handsfree->ramp == TWL6040_RAMP_UP) {
@@ -445,7 +495,7 @@ static inline int twl6040_hf_ramp_step(struct snd_soc_codec *codec,
 
 	/* right channel */
 	right_step = (right_step > 0x1D) ? 0x1D : right_step;
-	reg = twl6040_read_reg_cache(codec, TWL6040_REG_HFRGAIN);
+	reg = twl6040_read(codec, TWL6040_REG_HFRGAIN);
 	reg = 0x1D - reg;
 	val = (reg & TWL6040_HF_VOL_MASK);
 	if (handsfree->ramp == TWL6040_RAMP_UP) {
@@ -627,48 +677,48 @@ static int out_drv_event(struct snd_soc_dapm_widget *w,
 /* set headset dac and driver power mode */
 static int headset_power_mode(struct snd_soc_codec *codec, int high_perf)
 {
-	int hslctl, hsrctl;
+	struct twl6040_data *priv = snd_soc_codec_get_drvdata(codec);
+	u8 hsctl[2];
 	int mask = TWL6040_HSDRVMODE | TWL6040_HSDACMODE;
+	int ret;
 
-	hslctl = twl6040_read_reg_cache(codec, TWL6040_REG_HSLCTL);
-	hsrctl = twl6040_read_reg_cache(codec, TWL6040_REG_HSRCTL);
+	/* HSLCTL and HSRCTL are consecutive, update both in one go */
+	ret = regmap_bulk_read(priv->regmap, TWL6040_REG_HSLCTL, hsctl, 2);
+	if (ret)
+		return ret;
 
 	if (high_perf) {
-		hslctl &= ~mask;
-		hsrctl &= ~mask;
+		hsctl[0] &= ~mask;
+		hsctl[1] &= ~mask;
 	} else {
-		hslctl |= mask;
-		hsrctl |= mask;
+		hsctl[0] |= mask;
+		hsctl[1] |= mask;
 	}
 
-	twl6040_write(codec, TWL6040_REG_HSLCTL, hslctl);
-	twl6040_write(codec, TWL6040_REG_HSRCTL, hsrctl);
-
-	return 0;
+	return regmap_bulk_write(priv->regmap, TWL6040_REG_HSLCTL, hsctl, 2);
 }
 
 static int twl6040_hs_dac_event(struct snd_soc_dapm_widget *w,
 			struct snd_kcontrol *kcontrol, int event)
 {
 	struct snd_soc_codec *codec = w->codec;
-	u8 hslctl, hsrctl;
+	struct twl6040_data *priv = snd_soc_codec_get_drvdata(codec);
+	u8 hsctl[2];
 
 	/*
 	 * Workaround for Headset DC offset caused pop noise:
 	 * Both HS DAC need to be turned on (before the HS driver) and off at
-	 * the same time.
+	 * the same time, so HSLCTL and HSRCTL are written in one transaction.
 	 */
-	hslctl = twl6040_read_reg_cache(codec, TWL6040_REG_HSLCTL);
-	hsrctl = twl6040_read_reg_cache(codec, TWL6040_REG_HSRCTL);
+	regmap_bulk_read(priv->regmap, TWL6040_REG_HSLCTL, hsctl, 2);
 	if (SND_SOC_DAPM_EVENT_ON(event)) {
-		hslctl |= TWL6040_HSDACENA;
-		hsrctl |= TWL6040_HSDACENA;
+		hsctl[0] |= TWL6040_HSDACENA;
+		hsctl[1] |= TWL6040_HSDACENA;
 	} else {
-		hslctl &= ~TWL6040_HSDACENA;
-		hsrctl &= ~TWL6040_HSDACENA;
+		hsctl[0] &= ~TWL6040_HSDACENA;
+		hsctl[1] &= ~TWL6040_HSDACENA;
 	}
-	twl6040_write(codec, TWL6040_REG_HSLCTL, hslctl);
-	twl6040_write(codec, TWL6040_REG_HSRCTL, hsrctl);
+	regmap_bulk_write(priv->regmap, TWL6040_REG_HSLCTL, hsctl, 2);
 
 	msleep(1);
 	return 0;
@@ -704,7 +754,7 @@ static void twl6040_hs_jack_report(struct snd_soc_codec *codec,
 	mutex_lock(&priv->mutex);
 
 	/* Sync status */
-	status = twl6040_read_reg_volatile(codec, TWL6040_REG_STATUS);
+	status = twl6040_read(codec, TWL6040_REG_STATUS);
 	if (status & TWL6040_PLUGCOMP)
 		snd_soc_jack_report(jack, report, report);
 	else
@@ -823,7 +873,7 @@ static int twl6040_soc_dapm_put_vibra_enum(struct snd_kcontrol *kcontrol,
 	unsigned int val;
 
 	/* Do not allow changes while Input/FF efect is running */
-	val = twl6040_read_reg_volatile(codec, e->reg);
+	val = twl6040_read(codec, e->reg);
 	if (val & TWL6040_VIBENA && !(val & TWL6040_VIBSEL))
 		return -EBUSY;
 
@@ -1045,10 +1095,12 @@ EXPORT_SYMBOL_GPL(twl6040_get_clk_id);
 
 int twl6040_get_trim_value(struct snd_soc_codec *codec, enum twl6040_trim trim)
 {
+	struct twl6040_data *priv = snd_soc_codec_get_drvdata(codec);
+
 	if (unlikely(trim >= TWL6040_TRIM_INVAL))
 		return -EINVAL;
 
-	return twl6040_read_reg_cache(codec, TWL6040_REG_TRIM1 + trim);
+	return priv->trim[trim];
 }
 EXPORT_SYMBOL_GPL(twl6040_get_trim_value);
 
@@ -1529,6 +1581,14 @@ static int twl6040_probe(struct snd_soc_codec *codec)
 	codec->control_data = dev_get_drvdata(codec->dev->parent);
 	codec->ignore_pmdown_time = 1;
 
+	priv->regmap = regmap_init(codec->dev, &twl6040_regmap_bus,
+				   &twl6040_regmap_config);
+	if (IS_ERR(priv->regmap)) {
+		ret = PTR_ERR(priv->regmap);
+		dev_err(codec->dev, "regmap init failed: %d\n", ret);
+		goto regmap_err;
+	}
+
 	if (pdata && pdata->hs_left_step && pdata->hs_right_step) {
 		priv->hs_left_step = pdata->hs_left_step;
 		priv->hs_right_step = pdata->hs_right_step;
@@ -1586,6 +1646,8 @@ static int twl6040_probe(struct snd_soc_codec *codec)
 plugirq_err:
 	destroy_workqueue(priv->workqueue);
 work_err:
+	regmap_exit(priv->regmap);
+regmap_err:
 	kfree(priv);
 	return ret;
 }
@@ -1597,6 +1659,7 @@ static int twl6040_remove(struct snd_soc_codec *codec)
 	twl6040_set_bias_level(codec, SND_SOC_BIAS_OFF);
 	free_irq(priv->plug_irq, codec);
 	destroy_workqueue(priv->workqueue);
+	regmap_exit(priv->regmap);
 	kfree(priv);
 
 	return 0;
@@ -1607,12 +1670,9 @@ static struct snd_soc_codec_driver soc_codec_dev_twl6040 = {
 	.remove = twl6040_remove,
 	.suspend = twl6040_suspend,
 	.resume = twl6040_resume,
-	.read = twl6040_read_reg_cache,
+	.read = twl6040_read,
 	.write = twl6040_write,
 	.set_bias_level = twl6040_set_bias_level,
-	.reg_cache_size = ARRAY_SIZE(twl6040_reg),
-	.reg_word_size = sizeof(u8),
-	.reg_cache_default = twl6040_reg,
 
 	.controls = twl6040_snd_controls,
 	.num_controls = ARRAY_SIZE(twl6040_snd_controls),
@@ -402,12 +402,26 @@ static int omap_dmic_set_dai_sysclk(struct snd_soc_dai *dai, int clk_id,
 	return -EINVAL;
 }
 
+/*
+ * The DMIC FIFO level can't be read back, but it collects up to threshold
+ * frames before the DMA reads them, so report the average fill as delay.
+ */
+static snd_pcm_sframes_t omap_dmic_dai_delay(
+			struct snd_pcm_substream *substream,
+			struct snd_soc_dai *dai)
+{
+	struct omap_dmic *dmic = snd_soc_dai_get_drvdata(dai);
+
+	return (dmic->threshold + 1) / 2;
+}
+
 static const struct snd_soc_dai_ops omap_dmic_dai_ops = {
 	.startup	= omap_dmic_dai_startup,
 	.shutdown	= omap_dmic_dai_shutdown,
 	.hw_params	= omap_dmic_dai_hw_params,
 	.prepare	= omap_dmic_dai_prepare,
 	.trigger	= omap_dmic_dai_trigger,
+	.delay		= omap_dmic_dai_delay,
 	.set_sysclk	= omap_dmic_set_dai_sysclk,
 };
 
@@ -25,6 +25,8 @@
 #include <linux/init.h>
 #include <linux/module.h>
 #include <linux/device.h>
+#include <linux/debugfs.h>
+#include <linux/slab.h>
 #include <sound/core.h>
 #include <sound/pcm.h>
 #include <sound/pcm_params.h>
@@ -46,6 +48,27 @@
 	.private_value = (unsigned long) &(struct soc_mixer_control) \
 	{.min = xmin, .max = xmax} }
 
+/*
+ * Adaptive threshold mode: tune the FIFO threshold of each McBSP direction
+ * from the DMA service latency and xruns seen on previous runs, aiming for
+ * the largest DMA bursts the FIFO can safely take.
+ */
+static bool adaptive_threshold;
+module_param(adaptive_threshold, bool, 0644);
+MODULE_PARM_DESC(adaptive_threshold,
+		 "Tune the McBSP FIFO threshold from observed DMA latency");
+
+/* Smallest adaptive threshold in words, a few sDMA bursts */
+#define OMAP_MCBSP_MIN_THRESHOLD	16
+
+struct omap_mcbsp_thres_stats {
+	u16		target;		/* threshold for the next run, 0: max */
+	u16		in_use;		/* threshold of the current run */
+	u16		min_fill;	/* lowest TX FIFO fill seen in the run */
+	unsigned int	runs;
+	unsigned int	xruns;
+};
+
 struct omap_mcbsp_data {
 	unsigned int			bus_id;
 	struct omap_mcbsp_reg_cfg	regs;
@@ -59,6 +82,10 @@ struct omap_mcbsp_data {
 	unsigned int			in_freq;
 	int				clk_div;
 	int				wlen;
+	struct omap_mcbsp_thres_stats	thres[2];
+#ifdef CONFIG_DEBUG_FS
+	struct dentry			*debugfs;
+#endif
 };
 
 static struct omap_mcbsp_data mcbsp_data[NUM_LINKS];
@@ -100,6 +127,107 @@ static void omap_mcbsp_set_threshold(struct snd_pcm_substream *substream)
 		omap_mcbsp_set_tx_threshold(mcbsp_data->bus_id, words);
 	else
 		omap_mcbsp_set_rx_threshold(mcbsp_data->bus_id, words);
+
+	if (dma_op_mode == MCBSP_DMA_MODE_THRESHOLD) {
+		struct omap_mcbsp_thres_stats *st =
+				&mcbsp_data->thres[substream->stream];
+
+		st->in_use = words;
+		st->min_fill = USHRT_MAX;
+	}
+}
+
+/*
+ * Largest threshold to use for the stream in threshold mode, limited to
+ * the adaptive target if requested
+ */
+static int omap_mcbsp_get_threshold(struct omap_mcbsp_data *mcbsp_data,
+				    int stream, bool adapt)
+{
+	int max_thrsh;
+
+	if (stream == SNDRV_PCM_STREAM_PLAYBACK)
+		max_thrsh = omap_mcbsp_get_max_tx_threshold(mcbsp_data->bus_id);
+	else
+		max_thrsh = omap_mcbsp_get_max_rx_threshold(mcbsp_data->bus_id);
+
+	if (adapt && adaptive_threshold && mcbsp_data->thres[stream].target)
+		max_thrsh = min_t(int, max_thrsh,
+				  mcbsp_data->thres[stream].target);
+
+	return max_thrsh;
+}
+
+/*
+ * Number of sDMA packets per period for the biggest packet size up to
+ * max_thrsh words which divides the period evenly, 0 if there is none
+ */
+static int omap_mcbsp_get_divider(int period_words, int max_thrsh)
+{
+	int divider = DIV_ROUND_UP(period_words, max_thrsh);
+
+	while (period_words % divider && divider < period_words)
+		divider++;
+
+	return divider == period_words ? 0 : divider;
+}
+
+/*
+ * Pick the threshold for the next run of the stream from the run that is
+ * being stopped.
+ * For TX the DMA request is raised once threshold locations are free in the
+ * FIFO; how far the fill level drops below that before the DMA serves the
+ * request is the service latency in words. Twice that latency is kept in the
+ * FIFO as safety margin and the rest is used for the burst.
+ * The RX FIFO level can't be seen above the threshold, so RX only grows
+ * slowly while no overruns happen.
+ * Any xrun halves the threshold, down to OMAP_MCBSP_MIN_THRESHOLD.
+ */
+static void omap_mcbsp_adapt_threshold(struct snd_pcm_substream *substream,
+				       struct omap_mcbsp_data *mcbsp_data)
+{
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	struct omap_mcbsp_thres_stats *st =
+			&mcbsp_data->thres[substream->stream];
+	int fifo_size, max_thrsh, latency, target;
+	snd_pcm_uframes_t avail;
+
+	if (!st->in_use)
+		return;
+
+	st->runs++;
+	fifo_size = omap_mcbsp_get_fifo_size(mcbsp_data->bus_id);
+	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK) {
+		max_thrsh = omap_mcbsp_get_max_tx_threshold(mcbsp_data->bus_id);
+		avail = snd_pcm_playback_avail(runtime);
+	} else {
+		max_thrsh = omap_mcbsp_get_max_rx_threshold(mcbsp_data->bus_id);
+		avail = snd_pcm_capture_avail(runtime);
+	}
+
+	/*
+	 * Same test snd_pcm_update_state() raises the xrun on; the stop
+	 * ending a drain sees the buffer empty as well and is no xrun
+	 */
+	if (runtime->status->state != SNDRV_PCM_STATE_DRAINING &&
+	    avail >= runtime->stop_threshold) {
+		st->xruns++;
+		target = st->in_use / 2;
+	} else if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK) {
+		if (st->min_fill == USHRT_MAX)
+			goto out;
+		latency = fifo_size - st->in_use -
+			  min_t(int, st->min_fill, fifo_size - st->in_use);
+		target = fifo_size - 2 * latency;
+	} else {
+		target = st->in_use + st->in_use / 4 + 1;
+	}
+
+	st->target = clamp_t(int, target,
+			     min(OMAP_MCBSP_MIN_THRESHOLD, max_thrsh),
+			     max_thrsh);
+out:
+	st->in_use = 0;
 }
 
 static int omap_mcbsp_hwrule_min_buffersize(struct snd_pcm_hw_params *params,
@@ -193,6 +321,8 @@ static int omap_mcbsp_dai_trigger(struct snd_pcm_substream *substream, int cmd,
 	case SNDRV_PCM_TRIGGER_STOP:
 	case SNDRV_PCM_TRIGGER_SUSPEND:
 	case SNDRV_PCM_TRIGGER_PAUSE_PUSH:
+		if (adaptive_threshold)
+			omap_mcbsp_adapt_threshold(substream, mcbsp_data);
 		omap_mcbsp_stop(mcbsp_data->bus_id, play, !play);
 		mcbsp_data->active--;
 		break;
@@ -213,10 +343,13 @@ static snd_pcm_sframes_t omap_mcbsp_dai_delay(
 	u16 fifo_use;
 	snd_pcm_sframes_t delay;
 
-	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
+	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK) {
 		fifo_use = omap_mcbsp_get_tx_delay(mcbsp_data->bus_id);
-	else
+		if (fifo_use < mcbsp_data->thres[substream->stream].min_fill)
+			mcbsp_data->thres[substream->stream].min_fill = fifo_use;
+	} else {
 		fifo_use = omap_mcbsp_get_rx_delay(mcbsp_data->bus_id);
+	}
 
 	/*
 	 * Divide the used locations with the channel count to get the
@@ -263,15 +396,12 @@ static int omap_mcbsp_dai_hw_params(struct snd_pcm_substream *substream,
 		/* TODO: Currently, MODE_ELEMENT == MODE_FRAME */
 		if (omap_mcbsp_get_dma_op_mode(bus_id) ==
 						MCBSP_DMA_MODE_THRESHOLD) {
-			int period_words, max_thrsh;
+			int period_words, max_thrsh, divider = 0;
 
 			period_words = params_period_bytes(params) / (wlen / 8);
-			if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
-				max_thrsh = omap_mcbsp_get_max_tx_threshold(
-							    mcbsp_data->bus_id);
-			else
-				max_thrsh = omap_mcbsp_get_max_rx_threshold(
-							    mcbsp_data->bus_id);
+			max_thrsh = omap_mcbsp_get_threshold(mcbsp_data,
+							     substream->stream,
+							     true);
 			/*
 			 * If the period contains less or equal number of words,
 			 * we are using the original threshold mode setup:
@@ -281,21 +411,25 @@ static int omap_mcbsp_dai_hw_params(struct snd_pcm_substream *substream,
 			 * sDMA frame size = period size
 			 */
 			if (period_words > max_thrsh) {
-				int divider = 0;
-
+				divider = omap_mcbsp_get_divider(period_words,
+								 max_thrsh);
 				/*
-				 * Look for the biggest threshold value, which
-				 * divides the period size evenly.
+				 * No packet size up to the adaptive target
+				 * fits the period, use the full threshold
 				 */
-				divider = period_words / max_thrsh;
-				if (period_words % max_thrsh)
-					divider++;
-				while (period_words % divider &&
-					divider < period_words)
-					divider++;
-				if (divider == period_words)
+				if (!divider)
+					max_thrsh = omap_mcbsp_get_threshold(
+						mcbsp_data, substream->stream,
+						false);
+			}
+			if (!divider && period_words > max_thrsh) {
+				divider = omap_mcbsp_get_divider(period_words,
+								 max_thrsh);
+				if (!divider)
 					return -EINVAL;
+			}
 
+			if (divider) {
 				pkt_size = period_words / divider;
 				sync_mode = OMAP_DMA_SYNC_PACKET;
 			} else {
@@ -610,15 +744,96 @@ static const struct snd_soc_dai_ops mcbsp_dai_ops = {
 	.set_sysclk	= omap_mcbsp_dai_set_dai_sysclk,
 };
 
+#ifdef CONFIG_DEBUG_FS
+static ssize_t threshold_read_file(struct file *file, char __user *user_buf,
+				   size_t count, loff_t *ppos)
+{
+	struct omap_mcbsp_data *mcbsp_data = file->private_data;
+	char *buf = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	ssize_t len, ret = 0;
+	int stream;
+
+	if (!buf)
+		return -ENOMEM;
+
+	for (stream = 0; stream < 2; stream++) {
+		struct omap_mcbsp_thres_stats *st = &mcbsp_data->thres[stream];
+
+		len = snprintf(buf + ret, PAGE_SIZE - ret,
+			       "%s: threshold %u target %u min fill %u runs %u xruns %u\n",
+			       stream ? "capture" : "playback", st->in_use,
+			       st->target,
+			       st->min_fill == USHRT_MAX ? 0 : st->min_fill,
+			       st->runs, st->xruns);
+		if (len >= 0)
+			ret += len;
+	}
+
+	ret = simple_read_from_buffer(user_buf, count, ppos, buf, ret);
+
+	kfree(buf);
+
+	return ret;
+}
+
+static int threshold_open_file(struct inode *inode, struct file *file)
+{
+	file->private_data = inode->i_private;
+	return 0;
+}
+
+static const struct file_operations threshold_fops = {
+	.open = threshold_open_file,
+	.read = threshold_read_file,
+	.llseek = default_llseek,
+};
+
+static void omap_mcbsp_debugfs_init(struct snd_soc_dai *dai)
+{
+	struct omap_mcbsp_data *data = &mcbsp_data[dai->id];
+
+	data->debugfs = debugfs_create_dir(dev_name(dai->dev),
+					   snd_soc_debugfs_root);
+	if (!data->debugfs) {
+		dev_warn(dai->dev, "Failed to create debugfs directory\n");
+		return;
+	}
+
+	debugfs_create_file("threshold", 0444, data->debugfs, data,
+			    &threshold_fops);
+}
+
+static void omap_mcbsp_debugfs_exit(struct snd_soc_dai *dai)
+{
+	debugfs_remove_recursive(mcbsp_data[dai->id].debugfs);
+}
+#else
+static inline void omap_mcbsp_debugfs_init(struct snd_soc_dai *dai)
+{
+}
+
+static inline void omap_mcbsp_debugfs_exit(struct snd_soc_dai *dai)
+{
+}
+#endif
+
 static int mcbsp_dai_probe(struct snd_soc_dai *dai)
 {
 	mcbsp_data[dai->id].bus_id = dai->id;
 	snd_soc_dai_set_drvdata(dai, &mcbsp_data[dai->id].bus_id);
+	omap_mcbsp_debugfs_init(dai);
+	return 0;
+}
+
+static int mcbsp_dai_remove(struct snd_soc_dai *dai)
+{
+	omap_mcbsp_debugfs_exit(dai);
 	return 0;
 }
 
 static struct snd_soc_dai_driver omap_mcbsp_dai = {
 	.probe = mcbsp_dai_probe,
+	.remove = mcbsp_dai_remove,
 	.playback = {
 		.channels_min = 1,
 		.channels_max = 16,
@@ -33,6 +33,8 @@
 #include <linux/irq.h>
 #include <linux/slab.h>
 #include <linux/pm_runtime.h>
+#include <linux/debugfs.h>
+#include <linux/moduleparam.h>
 
 #include <sound/core.h>
 #include <sound/pcm.h>
@@ -44,6 +46,15 @@
 #include "omap-mcpdm.h"
 #include "omap-pcm.h"
 
+/*
+ * Stop the stream with an xrun as soon as the McPDM reports an empty DN or
+ * a full UP FIFO, so that the application recovers within a period instead
+ * of the link running on with a corrupted FIFO.
+ */
+static bool xrun_recovery;
+module_param(xrun_recovery, bool, 0644);
+MODULE_PARM_DESC(xrun_recovery, "Stop the stream on McPDM FIFO errors");
+
 struct omap_mcpdm {
 	struct device *dev;
 	unsigned long phys_base;
@@ -52,6 +63,20 @@ struct omap_mcpdm {
 
 	struct mutex mutex;
 
+	/* running substreams, protected by lock */
+	spinlock_t lock;
+	struct snd_pcm_substream *substream[2];
+
+	/* FIFO error counters */
+	unsigned int dn_underruns;
+	unsigned int dn_overruns;
+	unsigned int up_underruns;
+	unsigned int up_overruns;
+
+#ifdef CONFIG_DEBUG_FS
+	struct dentry *debugfs;
+#endif
+
 	/* channel data */
 	u32 dn_channels;
 	u32 up_channels;
@@ -227,6 +252,23 @@ static void omap_mcpdm_close_streams(struct omap_mcpdm *mcpdm)
 		omap_mcpdm_write(mcpdm, MCPDM_REG_DN_OFFSET, 0);
 }
 
+/* Report an xrun on the running substream of the given direction */
+static void omap_mcpdm_xrun(struct omap_mcpdm *mcpdm, int stream)
+{
+	struct snd_pcm_substream *substream;
+	unsigned long flags;
+
+	spin_lock(&mcpdm->lock);
+	substream = mcpdm->substream[stream];
+	if (substream) {
+		snd_pcm_stream_lock_irqsave(substream, flags);
+		if (snd_pcm_running(substream))
+			snd_pcm_stop(substream, SNDRV_PCM_STATE_XRUN);
+		snd_pcm_stream_unlock_irqrestore(substream, flags);
+	}
+	spin_unlock(&mcpdm->lock);
+}
+
 static irqreturn_t omap_mcpdm_irq_handler(int irq, void *dev_id)
 {
 	struct omap_mcpdm *mcpdm = dev_id;
@@ -237,20 +279,32 @@ static irqreturn_t omap_mcpdm_irq_handler(int irq, void *dev_id)
 	/* Acknowledge irq event */
 	omap_mcpdm_write(mcpdm, MCPDM_REG_IRQSTATUS, irq_status);
 
-	if (irq_status & MCPDM_DN_IRQ_FULL)
+	if (irq_status & MCPDM_DN_IRQ_FULL) {
 		dev_dbg(mcpdm->dev, "DN (playback) FIFO Full\n");
+		mcpdm->dn_overruns++;
+	}
 
-	if (irq_status & MCPDM_DN_IRQ_EMPTY)
+	if (irq_status & MCPDM_DN_IRQ_EMPTY) {
 		dev_dbg(mcpdm->dev, "DN (playback) FIFO Empty\n");
+		mcpdm->dn_underruns++;
+		if (xrun_recovery)
+			omap_mcpdm_xrun(mcpdm, SNDRV_PCM_STREAM_PLAYBACK);
+	}
 
 	if (irq_status & MCPDM_DN_IRQ)
 		dev_dbg(mcpdm->dev, "DN (playback) write request\n");
 
-	if (irq_status & MCPDM_UP_IRQ_FULL)
+	if (irq_status & MCPDM_UP_IRQ_FULL) {
 		dev_dbg(mcpdm->dev, "UP (capture) FIFO Full\n");
+		mcpdm->up_overruns++;
+		if (xrun_recovery)
+			omap_mcpdm_xrun(mcpdm, SNDRV_PCM_STREAM_CAPTURE);
+	}
 
-	if (irq_status & MCPDM_UP_IRQ_EMPTY)
+	if (irq_status & MCPDM_UP_IRQ_EMPTY) {
 		dev_dbg(mcpdm->dev, "UP (capture) FIFO Empty\n");
+		mcpdm->up_underruns++;
+	}
 
 	if (irq_status & MCPDM_UP_IRQ)
 		dev_dbg(mcpdm->dev, "UP (capture) write request\n");
@@ -278,6 +332,10 @@ static int omap_mcpdm_dai_startup(struct snd_pcm_substream *substream,
 
 	mutex_unlock(&mcpdm->mutex);
 
+	spin_lock_irq(&mcpdm->lock);
+	mcpdm->substream[substream->stream] = substream;
+	spin_unlock_irq(&mcpdm->lock);
+
 	return 0;
 }
 
@@ -286,6 +344,10 @@ static void omap_mcpdm_dai_shutdown(struct snd_pcm_substream *substream,
 {
 	struct omap_mcpdm *mcpdm = snd_soc_dai_get_drvdata(dai);
 
+	spin_lock_irq(&mcpdm->lock);
+	mcpdm->substream[substream->stream] = NULL;
+	spin_unlock_irq(&mcpdm->lock);
+
 	mutex_lock(&mcpdm->mutex);
 
 	if (!dai->active) {
@@ -362,13 +424,89 @@ static int omap_mcpdm_prepare(struct snd_pcm_substream *substream,
 	return 0;
 }
 
+/*
+ * McPDM has no FIFO level register, so the delay is estimated from the FIFO
+ * thresholds: the DN FIFO is refilled up to MCPDM_DN_THRES_MAX frames by each
+ * DMA packet and drains down to dn_threshold before the next request, while
+ * the UP FIFO collects up to up_threshold frames before they are read by the
+ * DMA. Report the average fill, which is within half a packet of the real
+ * value.
+ */
+static snd_pcm_sframes_t omap_mcpdm_dai_delay(
+			struct snd_pcm_substream *substream,
+			struct snd_soc_dai *dai)
+{
+	struct omap_mcpdm *mcpdm = snd_soc_dai_get_drvdata(dai);
+
+	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
+		return (MCPDM_DN_THRES_MAX + mcpdm->dn_threshold + 1) / 2;
+	else
+		return (mcpdm->up_threshold + 1) / 2;
+}
+
 static const struct snd_soc_dai_ops omap_mcpdm_dai_ops = {
 	.startup	= omap_mcpdm_dai_startup,
 	.shutdown	= omap_mcpdm_dai_shutdown,
 	.hw_params	= omap_mcpdm_dai_hw_params,
 	.prepare	= omap_mcpdm_prepare,
+	.delay		= omap_mcpdm_dai_delay,
+};
+
+#ifdef CONFIG_DEBUG_FS
+static int xruns_open_file(struct inode *inode, struct file *file)
+{
+	file->private_data = inode->i_private;
+	return 0;
+}
+
+static ssize_t xruns_read_file(struct file *file, char __user *user_buf,
+			       size_t count, loff_t *ppos)
+{
+	struct omap_mcpdm *mcpdm = file->private_data;
+	char buf[128];
+	int len;
+
+	len = snprintf(buf, sizeof(buf),
+		       "DN empty: %u\nDN full: %u\nUP empty: %u\nUP full: %u\n",
+		       mcpdm->dn_underruns, mcpdm->dn_overruns,
+		       mcpdm->up_underruns, mcpdm->up_overruns);
+
+	return simple_read_from_buffer(user_buf, count, ppos, buf, len);
+}
+
+static const struct file_operations xruns_fops = {
+	.open = xruns_open_file,
+	.read = xruns_read_file,
+	.llseek = default_llseek,
 };
 
+static void omap_mcpdm_debugfs_init(struct omap_mcpdm *mcpdm)
+{
+	mcpdm->debugfs = debugfs_create_dir(dev_name(mcpdm->dev),
+					    snd_soc_debugfs_root);
+	if (!mcpdm->debugfs) {
+		dev_warn(mcpdm->dev, "Failed to create debugfs directory\n");
+		return;
+	}
+
+	debugfs_create_file("xruns", 0444, mcpdm->debugfs, mcpdm,
+			    &xruns_fops);
+}
+
+static void omap_mcpdm_debugfs_exit(struct omap_mcpdm *mcpdm)
+{
+	debugfs_remove_recursive(mcpdm->debugfs);
+}
+#else
+static inline void omap_mcpdm_debugfs_init(struct omap_mcpdm *mcpdm)
+{
+}
+
+static inline void omap_mcpdm_debugfs_exit(struct omap_mcpdm *mcpdm)
+{
+}
+#endif
+
 static int omap_mcpdm_probe(struct snd_soc_dai *dai)
 {
 	struct omap_mcpdm *mcpdm = snd_soc_dai_get_drvdata(dai);
@@ -393,6 +531,9 @@ static int omap_mcpdm_probe(struct snd_soc_dai *dai)
 	/* Configure McPDM threshold values */
 	mcpdm->dn_threshold = 2;
 	mcpdm->up_threshold = MCPDM_UP_THRES_MAX - 3;
+
+	if (!ret)
+		omap_mcpdm_debugfs_init(mcpdm);
 	return ret;
 }
 
@@ -400,6 +541,8 @@ static int omap_mcpdm_remove(struct snd_soc_dai *dai)
 {
 	struct omap_mcpdm *mcpdm = snd_soc_dai_get_drvdata(dai);
 
+	omap_mcpdm_debugfs_exit(mcpdm);
+
 	free_irq(mcpdm->irq, (void *)mcpdm);
 	pm_runtime_disable(mcpdm->dev);
 
@@ -438,6 +581,51 @@ void omap_mcpdm_configure_dn_offsets(struct snd_soc_pcm_runtime *rtd,
 }
 EXPORT_SYMBOL_GPL(omap_mcpdm_configure_dn_offsets);
 
+static int omap_mcpdm_xrun_info(struct snd_kcontrol *kcontrol,
+				struct snd_ctl_elem_info *uinfo)
+{
+	uinfo->type = SNDRV_CTL_ELEM_TYPE_INTEGER;
+	uinfo->count = 1;
+	uinfo->value.integer.min = 0;
+	uinfo->value.integer.max = UINT_MAX;
+	return 0;
+}
+
+static int omap_mcpdm_xrun_get(struct snd_kcontrol *kcontrol,
+			       struct snd_ctl_elem_value *ucontrol)
+{
+	unsigned int *count = (unsigned int *)kcontrol->private_value;
+
+	ucontrol->value.integer.value[0] = *count;
+	return 0;
+}
+
+#define OMAP_MCPDM_XRUN_COUNTER(xname, counter) \
+{	.iface = SNDRV_CTL_ELEM_IFACE_MIXER, .name = xname, \
+	.access = SNDRV_CTL_ELEM_ACCESS_READ | \
+		  SNDRV_CTL_ELEM_ACCESS_VOLATILE, \
+	.info = omap_mcpdm_xrun_info, .get = omap_mcpdm_xrun_get, \
+	.private_value = (unsigned long)(counter) }
+
+/*
+ * Add read-only controls exposing the McPDM DN underrun and UP overrun
+ * counters to the codec of the given link.
+ */
+int omap_mcpdm_add_xrun_controls(struct snd_soc_pcm_runtime *rtd)
+{
+	struct omap_mcpdm *mcpdm = snd_soc_dai_get_drvdata(rtd->cpu_dai);
+	struct snd_kcontrol_new controls[] = {
+		OMAP_MCPDM_XRUN_COUNTER("McPDM DN Underruns",
+					&mcpdm->dn_underruns),
+		OMAP_MCPDM_XRUN_COUNTER("McPDM UP Overruns",
+					&mcpdm->up_overruns),
+	};
+
+	return snd_soc_add_controls(rtd->codec, controls,
+				    ARRAY_SIZE(controls));
+}
+EXPORT_SYMBOL_GPL(omap_mcpdm_add_xrun_controls);
+
 static __devinit int asoc_mcpdm_probe(struct platform_device *pdev)
 {
 	struct omap_mcpdm *mcpdm;
@@ -451,6 +639,7 @@ static __devinit int asoc_mcpdm_probe(struct platform_device *pdev)
 	platform_set_drvdata(pdev, mcpdm);
 
 	mutex_init(&mcpdm->mutex);
+	spin_lock_init(&mcpdm->lock);
 
 	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
 	if (res == NULL) {
@@ -103,5 +103,6 @@
 
 void omap_mcpdm_configure_dn_offsets(struct snd_soc_pcm_runtime *rtd,
 				    u8 rx1, u8 rx2);
+int omap_mcpdm_add_xrun_controls(struct snd_soc_pcm_runtime *rtd);
 
 #endif	/* End of __OMAP_MCPDM_H__ */
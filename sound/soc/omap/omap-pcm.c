@@ -25,6 +25,9 @@
 #include <linux/dma-mapping.h>
 #include <linux/slab.h>
 #include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/hrtimer.h>
+#include <linux/interrupt.h>
 #include <sound/core.h>
 #include <sound/pcm.h>
 #include <sound/pcm_params.h>
@@ -49,11 +52,58 @@ static const struct snd_pcm_hardware omap_pcm_hardware = {
 	.buffer_bytes_max	= 128 * 1024,
 };
 
+/* Upper limit for the ring of linked logical DMA channels per stream */
+#define OMAP_PCM_MAX_LINKED_CH	8
+
+/*
+ * Number of logical DMA channels linked into a ring per stream. With the
+ * default of 1 the channel is linked to itself and loops the whole buffer.
+ * Larger values split the buffer into segments, each transferred by its own
+ * channel, and the sDMA hands over from one channel to the next in hardware.
+ * Only used on OMAP2+, OMAP1 keeps the self-linked channel.
+ */
+static unsigned int linked_channels = 1;
+module_param(linked_channels, uint, 0644);
+MODULE_PARM_DESC(linked_channels,
+		 "Number of linked sDMA channels per stream (1 = self-linked)");
+
+/*
+ * Polling interval of the DMA position for streams opened with
+ * no_period_wakeup. The DMA interrupts are disabled for such streams and the
+ * hrtimer wakes up the application only once avail_min has been reached.
+ * 0 leaves the wakeups entirely to the application.
+ */
+static unsigned int nowakeup_poll_us;
+module_param(nowakeup_poll_us, uint, 0644);
+MODULE_PARM_DESC(nowakeup_poll_us,
+		 "Position polling interval in us for no_period_wakeup streams");
+
+/*
+ * Maximum buffer size in KiB for buffers allocated on demand. With the
+ * default of 0 a buffer of omap_pcm_hardware.buffer_bytes_max is
+ * preallocated for every substream at card creation. Otherwise nothing is
+ * allocated until hw_params, which allocates just the requested buffer size,
+ * and hw_free releases it again.
+ */
+static unsigned int dynamic_buffer_kb;
+module_param(dynamic_buffer_kb, uint, 0444);
+MODULE_PARM_DESC(dynamic_buffer_kb,
+		 "Allocate DMA buffers of up to this size (KiB) on demand");
+
 struct omap_runtime_data {
 	spinlock_t			lock;
 	struct omap_pcm_dma_data	*dma_data;
 	int				dma_ch;
+	int				lch[OMAP_PCM_MAX_LINKED_CH];
+	int				nr_lch;
+	int				cur_lch;	/* last one seen active */
 	int				period_index;
+	/* hrtimer based wakeup for no_period_wakeup streams */
+	struct hrtimer			poll_timer;
+	ktime_t				poll_time;
+	atomic_t			polling;
+	struct tasklet_struct		poll_tasklet;
+	struct snd_pcm_substream	*substream;
 };
 
 static void omap_pcm_dma_irq(int ch, u16 stat, void *data)
@@ -95,6 +145,194 @@ static void omap_pcm_dma_irq(int ch, u16 stat, void *data)
 	snd_pcm_period_elapsed(substream);
 }
 
+static snd_pcm_uframes_t omap_pcm_pointer(struct snd_pcm_substream *substream);
+
+static void omap_pcm_poll_elapsed(unsigned long data)
+{
+	struct omap_runtime_data *prtd = (struct omap_runtime_data *)data;
+
+	snd_pcm_period_elapsed(prtd->substream);
+}
+
+/*
+ * Estimate the frames available to the application from the current DMA
+ * position. Called without the stream lock, so the result is only used to
+ * decide whether a wakeup is due; snd_pcm_period_elapsed() does the exact
+ * hw_ptr update.
+ */
+static snd_pcm_uframes_t omap_pcm_poll_avail(struct snd_pcm_substream *substream)
+{
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	snd_pcm_uframes_t hw_ptr = runtime->status->hw_ptr;
+	snd_pcm_uframes_t appl_ptr = runtime->control->appl_ptr;
+	snd_pcm_uframes_t pos, old_pos;
+	snd_pcm_sframes_t avail;
+
+	pos = omap_pcm_pointer(substream);
+	old_pos = hw_ptr % runtime->buffer_size;
+	if (pos < old_pos)
+		pos += runtime->buffer_size;
+	hw_ptr += pos - old_pos;
+
+	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
+		avail = hw_ptr + runtime->buffer_size - appl_ptr;
+	else
+		avail = hw_ptr - appl_ptr;
+	if (avail < 0)
+		avail += runtime->boundary;
+	else if ((snd_pcm_uframes_t)avail >= runtime->boundary)
+		avail -= runtime->boundary;
+
+	return avail;
+}
+
+static enum hrtimer_restart omap_pcm_poll_timer(struct hrtimer *timer)
+{
+	struct omap_runtime_data *prtd;
+
+	prtd = container_of(timer, struct omap_runtime_data, poll_timer);
+	if (!atomic_read(&prtd->polling))
+		return HRTIMER_NORESTART;
+
+	if (omap_pcm_poll_avail(prtd->substream) >=
+	    prtd->substream->runtime->control->avail_min)
+		tasklet_schedule(&prtd->poll_tasklet);
+
+	hrtimer_forward_now(timer, prtd->poll_time);
+	return HRTIMER_RESTART;
+}
+
+static void omap_pcm_poll_start(struct omap_runtime_data *prtd)
+{
+	if (!prtd->poll_time.tv64)
+		return;
+
+	atomic_set(&prtd->polling, 1);
+	hrtimer_start(&prtd->poll_timer, prtd->poll_time, HRTIMER_MODE_REL);
+}
+
+static void omap_pcm_poll_stop(struct omap_runtime_data *prtd)
+{
+	atomic_set(&prtd->polling, 0);
+	hrtimer_try_to_cancel(&prtd->poll_timer);
+}
+
+static void omap_pcm_poll_sync(struct omap_runtime_data *prtd)
+{
+	hrtimer_cancel(&prtd->poll_timer);
+	tasklet_kill(&prtd->poll_tasklet);
+}
+
+static int omap_pcm_alloc_dma_buffer(struct snd_pcm_substream *substream,
+				     size_t size)
+{
+	struct snd_dma_buffer *buf = &substream->dma_buffer;
+	struct device *dev = substream->pcm->card->dev;
+
+	buf->dev.type = SNDRV_DMA_TYPE_DEV;
+	buf->dev.dev = dev;
+	buf->private_data = NULL;
+	buf->area = dma_alloc_writecombine(dev, size, &buf->addr, GFP_KERNEL);
+	if (!buf->area)
+		return -ENOMEM;
+
+	buf->bytes = size;
+	return 0;
+}
+
+static void omap_pcm_free_dma_buffer(struct snd_pcm_substream *substream)
+{
+	struct snd_dma_buffer *buf = &substream->dma_buffer;
+
+	if (!buf->area)
+		return;
+
+	dma_free_writecombine(substream->pcm->card->dev, buf->bytes,
+			      buf->area, buf->addr);
+	buf->area = NULL;
+	buf->bytes = 0;
+}
+
+/*
+ * Number of channels in the ring for the given number of periods: the
+ * largest divisor of periods not above the linked_channels limit, so that
+ * every channel transfers the same number of whole periods.
+ */
+static int omap_pcm_nr_lch(unsigned int periods)
+{
+	unsigned int nr = min_t(unsigned int, linked_channels,
+				OMAP_PCM_MAX_LINKED_CH);
+
+	if (cpu_class_is_omap1() || !nr)
+		return 1;
+
+	while (nr > 1 && periods % nr)
+		nr--;
+
+	return nr;
+}
+
+static void omap_pcm_free_lch(struct omap_runtime_data *prtd)
+{
+	int i;
+
+	for (i = 0; i < prtd->nr_lch; i++)
+		omap_dma_unlink_lch(prtd->lch[i],
+				    prtd->lch[(i + 1) % prtd->nr_lch]);
+	for (i = 0; i < prtd->nr_lch; i++)
+		omap_free_dma(prtd->lch[i]);
+
+	prtd->nr_lch = 0;
+	prtd->dma_ch = -1;
+}
+
+/*
+ * Stopping the first channel only breaks the links of the ring, whichever
+ * channel is currently transferring has to be disabled on its own too
+ */
+static void omap_pcm_stop_lch(struct omap_runtime_data *prtd)
+{
+	int i;
+
+	for (i = 0; i < prtd->nr_lch; i++)
+		omap_stop_dma(prtd->lch[i]);
+}
+
+static int omap_pcm_request_lch(struct snd_pcm_substream *substream,
+				struct omap_pcm_dma_data *dma_data, int nr)
+{
+	struct omap_runtime_data *prtd = substream->runtime->private_data;
+	int i, err = 0;
+
+	for (i = 0; i < nr; i++) {
+		err = omap_request_dma(dma_data->dma_req, dma_data->name,
+				       omap_pcm_dma_irq, substream,
+				       &prtd->lch[i]);
+		if (err)
+			break;
+	}
+
+	if (err) {
+		while (--i >= 0)
+			omap_free_dma(prtd->lch[i]);
+		return err;
+	}
+
+	/*
+	 * Link the channels into a ring (a single channel is linked with
+	 * itself) so DMA doesn't need any reprogramming while looping the
+	 * buffer
+	 */
+	for (i = 0; i < nr; i++)
+		omap_dma_link_lch(prtd->lch[i], prtd->lch[(i + 1) % nr]);
+
+	prtd->nr_lch = nr;
+	prtd->cur_lch = 0;
+	prtd->dma_ch = prtd->lch[0];
+
+	return 0;
+}
+
 /* this may get called several times by oss emulation */
 static int omap_pcm_hw_params(struct snd_pcm_substream *substream,
 			      struct snd_pcm_hw_params *params)
@@ -103,7 +341,7 @@ static int omap_pcm_hw_params(struct snd_pcm_substream *substream,
 	struct snd_soc_pcm_runtime *rtd = substream->private_data;
 	struct omap_runtime_data *prtd = runtime->private_data;
 	struct omap_pcm_dma_data *dma_data;
-
+	int nr_lch;
 	int err = 0;
 
 	dma_data = snd_soc_dai_get_dma_data(rtd->cpu_dai, substream);
@@ -113,22 +351,31 @@ static int omap_pcm_hw_params(struct snd_pcm_substream *substream,
 	if (!dma_data)
 		return 0;
 
+	if (dynamic_buffer_kb &&
+	    substream->dma_buffer.bytes < params_buffer_bytes(params)) {
+		omap_pcm_free_dma_buffer(substream);
+		err = omap_pcm_alloc_dma_buffer(substream,
+						params_buffer_bytes(params));
+		if (err)
+			return err;
+	}
+
 	snd_pcm_set_runtime_buffer(substream, &substream->dma_buffer);
 	runtime->dma_bytes = params_buffer_bytes(params);
 
-	if (prtd->dma_data)
-		return 0;
-	prtd->dma_data = dma_data;
-	err = omap_request_dma(dma_data->dma_req, dma_data->name,
-			       omap_pcm_dma_irq, substream, &prtd->dma_ch);
-	if (!err) {
-		/*
-		 * Link channel with itself so DMA doesn't need any
-		 * reprogramming while looping the buffer
-		 */
-		omap_dma_link_lch(prtd->dma_ch, prtd->dma_ch);
+	nr_lch = omap_pcm_nr_lch(params_periods(params));
+	if (prtd->dma_data) {
+		if (prtd->nr_lch == nr_lch)
+			return 0;
+		/* The period layout needs a different ring */
+		omap_pcm_free_lch(prtd);
+		prtd->dma_data = NULL;
 	}
 
+	err = omap_pcm_request_lch(substream, dma_data, nr_lch);
+	if (!err)
+		prtd->dma_data = dma_data;
+
 	return err;
 }
 
@@ -137,14 +384,19 @@ static int omap_pcm_hw_free(struct snd_pcm_substream *substream)
 	struct snd_pcm_runtime *runtime = substream->runtime;
 	struct omap_runtime_data *prtd = runtime->private_data;
 
-	if (prtd->dma_data == NULL)
-		return 0;
-
-	omap_dma_unlink_lch(prtd->dma_ch, prtd->dma_ch);
-	omap_free_dma(prtd->dma_ch);
-	prtd->dma_data = NULL;
+	if (prtd->dma_data) {
+		omap_pcm_poll_sync(prtd);
+		omap_pcm_free_lch(prtd);
+		prtd->dma_data = NULL;
+	}
 
+	/*
+	 * The buffer may be there without the DMA channels when requesting
+	 * them failed in hw_params
+	 */
 	snd_pcm_set_runtime_buffer(substream, NULL);
+	if (dynamic_buffer_kb)
+		omap_pcm_free_dma_buffer(substream);
 
 	return 0;
 }
@@ -155,13 +407,21 @@ static int omap_pcm_prepare(struct snd_pcm_substream *substream)
 	struct omap_runtime_data *prtd = runtime->private_data;
 	struct omap_pcm_dma_data *dma_data = prtd->dma_data;
 	struct omap_dma_channel_params dma_params;
-	int bytes;
+	int bytes, i;
 
 	/* return if this is a bufferless transfer e.g.
 	 * codec <--> BT codec or GSM modem -- lg FIXME */
 	if (!prtd->dma_data)
 		return 0;
 
+	omap_pcm_poll_sync(prtd);
+	if (runtime->no_period_wakeup && nowakeup_poll_us &&
+	    !cpu_is_omap1510())
+		prtd->poll_time = ns_to_ktime((u64)nowakeup_poll_us *
+					      NSEC_PER_USEC);
+	else
+		prtd->poll_time = ktime_set(0, 0);
+
 	memset(&dma_params, 0, sizeof(dma_params));
 	dma_params.data_type			= dma_data->data_type;
 	dma_params.trigger			= dma_data->dma_req;
@@ -185,34 +445,46 @@ static int omap_pcm_prepare(struct snd_pcm_substream *substream)
 	}
 	/*
 	 * Set DMA transfer frame size equal to ALSA period size and frame
-	 * count as no. of ALSA periods. Then with DMA frame interrupt enabled,
-	 * we can transfer the whole ALSA buffer with single DMA transfer but
-	 * still can get an interrupt at each period bounary
+	 * count as no. of ALSA periods covered by each channel of the ring.
+	 * Then with DMA frame interrupt enabled, we can transfer the whole
+	 * ALSA buffer without reprogramming but still can get an interrupt
+	 * at each period bounary
 	 */
 	bytes = snd_pcm_lib_period_bytes(substream);
 	dma_params.elem_count	= bytes >> dma_data->data_type;
-	dma_params.frame_count	= runtime->periods;
-	omap_set_dma_params(prtd->dma_ch, &dma_params);
-
-	if ((cpu_is_omap1510()))
-		omap_enable_dma_irq(prtd->dma_ch, OMAP_DMA_FRAME_IRQ |
-			      OMAP_DMA_LAST_IRQ | OMAP_DMA_BLOCK_IRQ);
-	else if (!substream->runtime->no_period_wakeup)
-		omap_enable_dma_irq(prtd->dma_ch, OMAP_DMA_FRAME_IRQ);
-	else {
-		/*
-		 * No period wakeup:
-		 * we need to disable BLOCK_IRQ, which is enabled by the omap
-		 * dma core at request dma time.
-		 */
-		omap_disable_dma_irq(prtd->dma_ch, OMAP_DMA_BLOCK_IRQ);
-	}
+	dma_params.frame_count	= runtime->periods / prtd->nr_lch;
+
+	for (i = 0; i < prtd->nr_lch; i++) {
+		int lch = prtd->lch[i];
+		dma_addr_t seg = runtime->dma_addr +
+				 i * bytes * dma_params.frame_count;
+
+		if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
+			dma_params.src_start = seg;
+		else
+			dma_params.dst_start = seg;
+		omap_set_dma_params(lch, &dma_params);
+
+		if ((cpu_is_omap1510()))
+			omap_enable_dma_irq(lch, OMAP_DMA_FRAME_IRQ |
+				      OMAP_DMA_LAST_IRQ | OMAP_DMA_BLOCK_IRQ);
+		else if (!substream->runtime->no_period_wakeup)
+			omap_enable_dma_irq(lch, OMAP_DMA_FRAME_IRQ);
+		else {
+			/*
+			 * No period wakeup:
+			 * we need to disable BLOCK_IRQ, which is enabled by
+			 * the omap dma core at request dma time.
+			 */
+			omap_disable_dma_irq(lch, OMAP_DMA_BLOCK_IRQ);
+		}
 
-	if (!(cpu_class_is_omap1())) {
-		omap_set_dma_src_burst_mode(prtd->dma_ch,
+		if (!(cpu_class_is_omap1())) {
+			omap_set_dma_src_burst_mode(lch,
 						OMAP_DMA_DATA_BURST_16);
-		omap_set_dma_dest_burst_mode(prtd->dma_ch,
+			omap_set_dma_dest_burst_mode(lch,
 						OMAP_DMA_DATA_BURST_16);
+		}
 	}
 
 	return 0;
@@ -236,14 +508,17 @@ static int omap_pcm_trigger(struct snd_pcm_substream *substream, int cmd)
 		if (dma_data->set_threshold)
 			dma_data->set_threshold(substream);
 
+		prtd->cur_lch = 0;
 		omap_start_dma(prtd->dma_ch);
+		omap_pcm_poll_start(prtd);
 		break;
 
 	case SNDRV_PCM_TRIGGER_STOP:
 	case SNDRV_PCM_TRIGGER_SUSPEND:
 	case SNDRV_PCM_TRIGGER_PAUSE_PUSH:
 		prtd->period_index = -1;
-		omap_stop_dma(prtd->dma_ch);
+		omap_pcm_poll_stop(prtd);
+		omap_pcm_stop_lch(prtd);
 		break;
 	default:
 		ret = -EINVAL;
@@ -259,14 +534,29 @@ static snd_pcm_uframes_t omap_pcm_pointer(struct snd_pcm_substream *substream)
 	struct omap_runtime_data *prtd = runtime->private_data;
 	dma_addr_t ptr;
 	snd_pcm_uframes_t offset;
+	int lch, i, n;
+
+	/*
+	 * Only one channel of the ring is enabled at a time.  While the
+	 * ring hands over to the next one none may be, the position of
+	 * the last active channel is the right one then.
+	 */
+	for (i = 0; i < prtd->nr_lch && prtd->nr_lch > 1; i++) {
+		n = (prtd->cur_lch + i) % prtd->nr_lch;
+		if (omap_get_dma_active_status(prtd->lch[n])) {
+			prtd->cur_lch = n;
+			break;
+		}
+	}
+	lch = prtd->lch[prtd->cur_lch];
 
 	if (cpu_is_omap1510()) {
 		offset = prtd->period_index * runtime->period_size;
 	} else if (substream->stream == SNDRV_PCM_STREAM_CAPTURE) {
-		ptr = omap_get_dma_dst_pos(prtd->dma_ch);
+		ptr = omap_get_dma_dst_pos(lch);
 		offset = bytes_to_frames(runtime, ptr - runtime->dma_addr);
 	} else {
-		ptr = omap_get_dma_src_pos(prtd->dma_ch);
+		ptr = omap_get_dma_src_pos(lch);
 		offset = bytes_to_frames(runtime, ptr - runtime->dma_addr);
 	}
 
@@ -283,6 +573,8 @@ static int omap_pcm_open(struct snd_pcm_substream *substream)
 	int ret;
 
 	snd_soc_set_runtime_hwparams(substream, &omap_pcm_hardware);
+	if (dynamic_buffer_kb)
+		runtime->hw.buffer_bytes_max = dynamic_buffer_kb * 1024;
 
 	/* Ensure that buffer size is a multiple of period size */
 	ret = snd_pcm_hw_constraint_integer(runtime,
@@ -296,6 +588,12 @@ static int omap_pcm_open(struct snd_pcm_substream *substream)
 		goto out;
 	}
 	spin_lock_init(&prtd->lock);
+	prtd->substream = substream;
+	hrtimer_init(&prtd->poll_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	prtd->poll_timer.function = omap_pcm_poll_timer;
+	atomic_set(&prtd->polling, 0);
+	tasklet_init(&prtd->poll_tasklet, omap_pcm_poll_elapsed,
+		     (unsigned long)prtd);
 	runtime->private_data = prtd;
 
 out:
@@ -305,8 +603,10 @@ out:
 static int omap_pcm_close(struct snd_pcm_substream *substream)
 {
 	struct snd_pcm_runtime *runtime = substream->runtime;
+	struct omap_runtime_data *prtd = runtime->private_data;
 
-	kfree(runtime->private_data);
+	omap_pcm_poll_sync(prtd);
+	kfree(prtd);
 	return 0;
 }
 
@@ -339,25 +639,14 @@ static int omap_pcm_preallocate_dma_buffer(struct snd_pcm *pcm,
 	int stream)
 {
 	struct snd_pcm_substream *substream = pcm->streams[stream].substream;
-	struct snd_dma_buffer *buf = &substream->dma_buffer;
-	size_t size = omap_pcm_hardware.buffer_bytes_max;
 
-	buf->dev.type = SNDRV_DMA_TYPE_DEV;
-	buf->dev.dev = pcm->card->dev;
-	buf->private_data = NULL;
-	buf->area = dma_alloc_writecombine(pcm->card->dev, size,
-					   &buf->addr, GFP_KERNEL);
-	if (!buf->area)
-		return -ENOMEM;
-
-	buf->bytes = size;
-	return 0;
+	return omap_pcm_alloc_dma_buffer(substream,
+					 omap_pcm_hardware.buffer_bytes_max);
 }
 
 static void omap_pcm_free_dma_buffers(struct snd_pcm *pcm)
 {
 	struct snd_pcm_substream *substream;
-	struct snd_dma_buffer *buf;
 	int stream;
 
 	for (stream = 0; stream < 2; stream++) {
@@ -365,13 +654,7 @@ static void omap_pcm_free_dma_buffers(struct snd_pcm *pcm)
 		if (!substream)
 			continue;
 
-		buf = &substream->dma_buffer;
-		if (!buf->area)
-			continue;
-
-		dma_free_writecombine(pcm->card->dev, buf->bytes,
-				      buf->area, buf->addr);
-		buf->area = NULL;
+		omap_pcm_free_dma_buffer(substream);
 	}
 }
 
@@ -386,6 +669,10 @@ static int omap_pcm_new(struct snd_soc_pcm_runtime *rtd)
 	if (!card->dev->coherent_dma_mask)
 		card->dev->coherent_dma_mask = DMA_BIT_MASK(64);
 
+	/* buffers are allocated in hw_params */
+	if (dynamic_buffer_kb)
+		goto out;
+
 	if (pcm->streams[SNDRV_PCM_STREAM_PLAYBACK].substream) {
 		ret = omap_pcm_preallocate_dma_buffer(pcm,
 			SNDRV_PCM_STREAM_PLAYBACK);
@@ -15,7 +15,9 @@
 #include <linux/spi/spi.h>
 #include <sound/soc.h>
 #include <linux/bitmap.h>
+#include <linux/slab.h>
 #include <linux/rbtree.h>
+#include <linux/lzo.h>
 #include <linux/export.h>
 
 #include <trace/events/asoc.h>
@@ -132,6 +134,505 @@ static int snd_soc_flat_cache_init(struct snd_soc_codec *codec)
 	return 0;
 }
 
+/* The hardware default of a register, used to avoid syncing it */
+static unsigned int snd_soc_cache_default(struct snd_soc_codec *codec,
+					  unsigned int reg)
+{
+	if (!codec->reg_def_copy)
+		return 0;
+
+	return snd_soc_get_cache_val(codec->reg_def_copy, reg,
+				     codec->driver->reg_word_size);
+}
+
+static int snd_soc_cache_sync_reg(struct snd_soc_codec *codec,
+				  unsigned int reg, unsigned int val)
+{
+	int ret;
+
+	if (val == snd_soc_cache_default(codec, reg))
+		return 0;
+
+	WARN_ON(!snd_soc_codec_writable_register(codec, reg));
+
+	codec->cache_bypass = 1;
+	ret = snd_soc_write(codec, reg, val);
+	codec->cache_bypass = 0;
+	if (ret)
+		return ret;
+
+	dev_dbg(codec->dev, "Synced register %#x, value = %#x\n", reg, val);
+	return 0;
+}
+
+/*
+ * The rbtree cache only holds the registers which have been written,
+ * in blocks of adjacent registers.  Anything else is still at its
+ * default value, so the tree is sparse for CODECs with large register
+ * maps and is also exactly the set of registers a resync needs to
+ * look at.
+ */
+struct snd_soc_rbtree_node {
+	struct rb_node node;
+	unsigned int base_reg;	/* first register in the block */
+	unsigned int blklen;	/* number of registers in the block */
+	void *block;
+};
+
+struct snd_soc_rbtree_ctx {
+	struct rb_root root;
+	struct snd_soc_rbtree_node *cached_rbnode;
+};
+
+static inline bool snd_soc_rbtree_contains(struct snd_soc_rbtree_node *rbnode,
+					   unsigned int reg)
+{
+	return reg >= rbnode->base_reg &&
+		reg < rbnode->base_reg + rbnode->blklen;
+}
+
+static struct snd_soc_rbtree_node *
+snd_soc_rbtree_lookup(struct snd_soc_rbtree_ctx *rbtree_ctx, unsigned int reg)
+{
+	struct snd_soc_rbtree_node *rbnode;
+	struct rb_node *node;
+
+	rbnode = rbtree_ctx->cached_rbnode;
+	if (rbnode && snd_soc_rbtree_contains(rbnode, reg))
+		return rbnode;
+
+	node = rbtree_ctx->root.rb_node;
+	while (node) {
+		rbnode = rb_entry(node, struct snd_soc_rbtree_node, node);
+		if (snd_soc_rbtree_contains(rbnode, reg)) {
+			rbtree_ctx->cached_rbnode = rbnode;
+			return rbnode;
+		}
+		if (reg < rbnode->base_reg)
+			node = node->rb_left;
+		else
+			node = node->rb_right;
+	}
+
+	return NULL;
+}
+
+static void snd_soc_rbtree_insert(struct rb_root *root,
+				  struct snd_soc_rbtree_node *rbnode)
+{
+	struct rb_node **new = &root->rb_node, *parent = NULL;
+	struct snd_soc_rbtree_node *tmp;
+
+	while (*new) {
+		tmp = rb_entry(*new, struct snd_soc_rbtree_node, node);
+		parent = *new;
+		if (rbnode->base_reg < tmp->base_reg)
+			new = &(*new)->rb_left;
+		else
+			new = &(*new)->rb_right;
+	}
+
+	rb_link_node(&rbnode->node, parent, new);
+	rb_insert_color(&rbnode->node, root);
+}
+
+/* Grow a block by one register, either at its start or its end */
+static int snd_soc_rbtree_extend(struct snd_soc_rbtree_node *rbnode,
+				 unsigned int reg, unsigned int value,
+				 unsigned int word_size)
+{
+	unsigned int pos;
+	u8 *blk;
+
+	blk = krealloc(rbnode->block, (rbnode->blklen + 1) * word_size,
+		       GFP_KERNEL);
+	if (!blk)
+		return -ENOMEM;
+
+	if (reg < rbnode->base_reg) {
+		memmove(blk + word_size, blk, rbnode->blklen * word_size);
+		rbnode->base_reg = reg;
+		pos = 0;
+	} else {
+		pos = rbnode->blklen;
+	}
+
+	rbnode->block = blk;
+	rbnode->blklen++;
+	snd_soc_set_cache_val(blk, pos, value, word_size);
+
+	return 0;
+}
+
+static int snd_soc_rbtree_cache_write(struct snd_soc_codec *codec,
+				      unsigned int reg, unsigned int value)
+{
+	struct snd_soc_rbtree_ctx *rbtree_ctx = codec->reg_cache;
+	unsigned int word_size = codec->driver->reg_word_size;
+	struct snd_soc_rbtree_node *rbnode;
+	int ret;
+
+	rbnode = snd_soc_rbtree_lookup(rbtree_ctx, reg);
+	if (rbnode) {
+		snd_soc_set_cache_val(rbnode->block, reg - rbnode->base_reg,
+				      value, word_size);
+		return 0;
+	}
+
+	/* Writing the default to a register we've not touched is a noop */
+	if (value == snd_soc_cache_default(codec, reg))
+		return 0;
+
+	/* Try to extend a block which ends or starts next to us */
+	rbnode = NULL;
+	if (reg > 0)
+		rbnode = snd_soc_rbtree_lookup(rbtree_ctx, reg - 1);
+	if (!rbnode)
+		rbnode = snd_soc_rbtree_lookup(rbtree_ctx, reg + 1);
+	if (rbnode) {
+		ret = snd_soc_rbtree_extend(rbnode, reg, value, word_size);
+		if (ret < 0)
+			return ret;
+		rbtree_ctx->cached_rbnode = rbnode;
+		return 0;
+	}
+
+	rbnode = kzalloc(sizeof(*rbnode), GFP_KERNEL);
+	if (!rbnode)
+		return -ENOMEM;
+	rbnode->block = kmalloc(word_size, GFP_KERNEL);
+	if (!rbnode->block) {
+		kfree(rbnode);
+		return -ENOMEM;
+	}
+	rbnode->base_reg = reg;
+	rbnode->blklen = 1;
+	snd_soc_set_cache_val(rbnode->block, 0, value, word_size);
+
+	snd_soc_rbtree_insert(&rbtree_ctx->root, rbnode);
+	rbtree_ctx->cached_rbnode = rbnode;
+
+	return 0;
+}
+
+static int snd_soc_rbtree_cache_read(struct snd_soc_codec *codec,
+				     unsigned int reg, unsigned int *value)
+{
+	struct snd_soc_rbtree_node *rbnode;
+
+	rbnode = snd_soc_rbtree_lookup(codec->reg_cache, reg);
+	if (rbnode)
+		*value = snd_soc_get_cache_val(rbnode->block,
+					       reg - rbnode->base_reg,
+					       codec->driver->reg_word_size);
+	else
+		*value = snd_soc_cache_default(codec, reg);
+
+	return 0;
+}
+
+/*
+ * Find the first cached register at or after *reg and its value.  The
+ * caller holds cache_rw_mutex; blocks never overlap so the tree is
+ * ordered by both their first and last register.
+ */
+static bool snd_soc_rbtree_next(struct snd_soc_rbtree_ctx *rbtree_ctx,
+				unsigned int *reg, unsigned int *value,
+				unsigned int word_size)
+{
+	struct snd_soc_rbtree_node *rbnode, *found = NULL;
+	struct rb_node *node;
+
+	node = rbtree_ctx->root.rb_node;
+	while (node) {
+		rbnode = rb_entry(node, struct snd_soc_rbtree_node, node);
+		if (*reg < rbnode->base_reg + rbnode->blklen) {
+			found = rbnode;
+			if (*reg >= rbnode->base_reg)
+				break;
+			node = node->rb_left;
+		} else {
+			node = node->rb_right;
+		}
+	}
+
+	if (!found)
+		return false;
+
+	if (*reg < found->base_reg)
+		*reg = found->base_reg;
+	*value = snd_soc_get_cache_val(found->block, *reg - found->base_reg,
+				       word_size);
+	return true;
+}
+
+static int snd_soc_rbtree_cache_sync(struct snd_soc_codec *codec)
+{
+	struct snd_soc_rbtree_ctx *rbtree_ctx = codec->reg_cache;
+	unsigned int word_size = codec->driver->reg_word_size;
+	unsigned int reg, val;
+	bool found;
+	int ret;
+
+	/*
+	 * Writing a register may flush deferred writes, which read the
+	 * cache themselves, so look each register up under the lock
+	 * rather than holding it across the whole walk.
+	 */
+	for (reg = 0; ; reg++) {
+		mutex_lock(&codec->cache_rw_mutex);
+		found = snd_soc_rbtree_next(rbtree_ctx, &reg, &val, word_size);
+		mutex_unlock(&codec->cache_rw_mutex);
+		if (!found)
+			break;
+
+		ret = snd_soc_cache_sync_reg(codec, reg, val);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static int snd_soc_rbtree_cache_exit(struct snd_soc_codec *codec)
+{
+	struct snd_soc_rbtree_ctx *rbtree_ctx = codec->reg_cache;
+	struct snd_soc_rbtree_node *rbnode;
+	struct rb_node *next;
+
+	if (!rbtree_ctx)
+		return 0;
+
+	next = rb_first(&rbtree_ctx->root);
+	while (next) {
+		rbnode = rb_entry(next, struct snd_soc_rbtree_node, node);
+		next = rb_next(next);
+		rb_erase(&rbnode->node, &rbtree_ctx->root);
+		kfree(rbnode->block);
+		kfree(rbnode);
+	}
+
+	kfree(rbtree_ctx);
+	codec->reg_cache = NULL;
+	return 0;
+}
+
+static int snd_soc_rbtree_cache_init(struct snd_soc_codec *codec)
+{
+	struct snd_soc_rbtree_ctx *rbtree_ctx;
+
+	rbtree_ctx = kzalloc(sizeof(*rbtree_ctx), GFP_KERNEL);
+	if (!rbtree_ctx)
+		return -ENOMEM;
+
+	rbtree_ctx->root = RB_ROOT;
+	codec->reg_cache = rbtree_ctx;
+
+	return 0;
+}
+
+/*
+ * The LZO cache splits the register map into a fixed number of blocks
+ * which are kept compressed.  The block last accessed is also kept
+ * decompressed so runs of accesses to nearby registers only pay for
+ * the decompression once.  A bitmap of written registers limits a
+ * resync to the registers which may differ from their defaults.
+ */
+#define SND_SOC_LZO_BLOCK_NUM 8
+
+struct snd_soc_lzo_block {
+	void *data;		/* compressed block */
+	size_t len;		/* compressed size */
+};
+
+struct snd_soc_lzo_ctx {
+	unsigned int blkregs;	/* registers per block */
+	size_t blksize;		/* decompressed bytes per block */
+	void *wmem;		/* LZO work memory */
+	void *dst;		/* compression output */
+	size_t dst_len;
+	void *cur;		/* decompressed copy of block cur_idx */
+	int cur_idx;
+	unsigned long *sync_bmp;
+	struct snd_soc_lzo_block blocks[SND_SOC_LZO_BLOCK_NUM];
+};
+
+static int snd_soc_lzo_compress_block(struct snd_soc_lzo_ctx *lzo_ctx,
+				      int idx, const void *src, size_t len)
+{
+	struct snd_soc_lzo_block *blk = &lzo_ctx->blocks[idx];
+	size_t compress_size;
+	void *data;
+	int ret;
+
+	ret = lzo1x_1_compress(src, len, lzo_ctx->dst, &compress_size,
+			       lzo_ctx->wmem);
+	if (ret != LZO_E_OK || compress_size > lzo_ctx->dst_len)
+		return -EINVAL;
+
+	data = krealloc(blk->data, compress_size, GFP_KERNEL);
+	if (!data)
+		return -ENOMEM;
+	memcpy(data, lzo_ctx->dst, compress_size);
+
+	blk->data = data;
+	blk->len = compress_size;
+	return 0;
+}
+
+/* Make block idx the current one, decompressing it if needed */
+static int snd_soc_lzo_get_block(struct snd_soc_lzo_ctx *lzo_ctx, int idx)
+{
+	struct snd_soc_lzo_block *blk = &lzo_ctx->blocks[idx];
+	size_t dst_len = lzo_ctx->blksize;
+	int ret;
+
+	if (lzo_ctx->cur_idx == idx)
+		return 0;
+
+	lzo_ctx->cur_idx = -1;
+	ret = lzo1x_decompress_safe(blk->data, blk->len, lzo_ctx->cur,
+				    &dst_len);
+	if (ret != LZO_E_OK || dst_len != lzo_ctx->blksize)
+		return -EINVAL;
+
+	lzo_ctx->cur_idx = idx;
+	return 0;
+}
+
+static int snd_soc_lzo_cache_write(struct snd_soc_codec *codec,
+				   unsigned int reg, unsigned int value)
+{
+	struct snd_soc_lzo_ctx *lzo_ctx = codec->reg_cache;
+	int idx = reg / lzo_ctx->blkregs;
+	int ret;
+
+	ret = snd_soc_lzo_get_block(lzo_ctx, idx);
+	if (ret < 0)
+		return ret;
+
+	if (snd_soc_set_cache_val(lzo_ctx->cur, reg % lzo_ctx->blkregs,
+				  value, codec->driver->reg_word_size))
+		return 0;
+
+	ret = snd_soc_lzo_compress_block(lzo_ctx, idx, lzo_ctx->cur,
+					 lzo_ctx->blksize);
+	if (ret < 0) {
+		/* The decompressed copy no longer matches the block */
+		lzo_ctx->cur_idx = -1;
+		return ret;
+	}
+
+	set_bit(reg, lzo_ctx->sync_bmp);
+	return 0;
+}
+
+static int snd_soc_lzo_cache_read(struct snd_soc_codec *codec,
+				  unsigned int reg, unsigned int *value)
+{
+	struct snd_soc_lzo_ctx *lzo_ctx = codec->reg_cache;
+	int ret;
+
+	ret = snd_soc_lzo_get_block(lzo_ctx, reg / lzo_ctx->blkregs);
+	if (ret < 0)
+		return ret;
+
+	*value = snd_soc_get_cache_val(lzo_ctx->cur, reg % lzo_ctx->blkregs,
+				       codec->driver->reg_word_size);
+	return 0;
+}
+
+static int snd_soc_lzo_cache_sync(struct snd_soc_codec *codec)
+{
+	struct snd_soc_lzo_ctx *lzo_ctx = codec->reg_cache;
+	unsigned int i, val;
+	int ret;
+
+	for_each_set_bit(i, lzo_ctx->sync_bmp, codec->driver->reg_cache_size) {
+		ret = snd_soc_cache_read(codec, i, &val);
+		if (ret)
+			return ret;
+		ret = snd_soc_cache_sync_reg(codec, i, val);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static int snd_soc_lzo_cache_exit(struct snd_soc_codec *codec)
+{
+	struct snd_soc_lzo_ctx *lzo_ctx = codec->reg_cache;
+	int i;
+
+	if (!lzo_ctx)
+		return 0;
+
+	for (i = 0; i < SND_SOC_LZO_BLOCK_NUM; i++)
+		kfree(lzo_ctx->blocks[i].data);
+	kfree(lzo_ctx->sync_bmp);
+	kfree(lzo_ctx->cur);
+	kfree(lzo_ctx->dst);
+	kfree(lzo_ctx->wmem);
+	kfree(lzo_ctx);
+	codec->reg_cache = NULL;
+	return 0;
+}
+
+static int snd_soc_lzo_cache_init(struct snd_soc_codec *codec)
+{
+	const struct snd_soc_codec_driver *codec_drv = codec->driver;
+	struct snd_soc_lzo_ctx *lzo_ctx;
+	const u8 *p, *end;
+	size_t len;
+	int i, ret;
+
+	lzo_ctx = kzalloc(sizeof(*lzo_ctx), GFP_KERNEL);
+	if (!lzo_ctx)
+		return -ENOMEM;
+	codec->reg_cache = lzo_ctx;
+
+	lzo_ctx->blkregs = DIV_ROUND_UP(codec_drv->reg_cache_size,
+					SND_SOC_LZO_BLOCK_NUM);
+	lzo_ctx->blksize = lzo_ctx->blkregs * codec_drv->reg_word_size;
+	lzo_ctx->dst_len = lzo1x_worst_compress(lzo_ctx->blksize);
+	lzo_ctx->cur_idx = -1;
+
+	lzo_ctx->wmem = kmalloc(LZO1X_MEM_COMPRESS, GFP_KERNEL);
+	lzo_ctx->dst = kmalloc(lzo_ctx->dst_len, GFP_KERNEL);
+	lzo_ctx->cur = kzalloc(lzo_ctx->blksize, GFP_KERNEL);
+	lzo_ctx->sync_bmp = kcalloc(BITS_TO_LONGS(codec_drv->reg_cache_size),
+				    sizeof(unsigned long), GFP_KERNEL);
+	if (!lzo_ctx->wmem || !lzo_ctx->dst || !lzo_ctx->cur ||
+	    !lzo_ctx->sync_bmp) {
+		ret = -ENOMEM;
+		goto err;
+	}
+
+	/* Compress the defaults, padding the last block out with zeros */
+	p = codec->reg_def_copy;
+	end = p + codec->reg_size;
+	for (i = 0; i < SND_SOC_LZO_BLOCK_NUM; i++) {
+		memset(lzo_ctx->cur, 0, lzo_ctx->blksize);
+		if (p && p < end) {
+			len = min_t(size_t, lzo_ctx->blksize, end - p);
+			memcpy(lzo_ctx->cur, p, len);
+			p += len;
+		}
+
+		ret = snd_soc_lzo_compress_block(lzo_ctx, i, lzo_ctx->cur,
+						 lzo_ctx->blksize);
+		if (ret < 0)
+			goto err;
+	}
+
+	return 0;
+
+err:
+	snd_soc_lzo_cache_exit(codec);
+	return ret;
+}
+
 /* an array of all supported compression types */
 static const struct snd_soc_cache_ops cache_types[] = {
 	/* Flat *must* be the first entry for fallback */
@@ -144,6 +645,24 @@ static const struct snd_soc_cache_ops cache_types[] = {
 		.write = snd_soc_flat_cache_write,
 		.sync = snd_soc_flat_cache_sync
 	},
+	{
+		.id = SND_SOC_RBTREE_COMPRESSION,
+		.name = "rbtree",
+		.init = snd_soc_rbtree_cache_init,
+		.exit = snd_soc_rbtree_cache_exit,
+		.read = snd_soc_rbtree_cache_read,
+		.write = snd_soc_rbtree_cache_write,
+		.sync = snd_soc_rbtree_cache_sync
+	},
+	{
+		.id = SND_SOC_LZO_COMPRESSION,
+		.name = "LZO",
+		.init = snd_soc_lzo_cache_init,
+		.exit = snd_soc_lzo_cache_exit,
+		.read = snd_soc_lzo_cache_read,
+		.write = snd_soc_lzo_cache_write,
+		.sync = snd_soc_lzo_cache_sync
+	},
 };
 
 int snd_soc_cache_init(struct snd_soc_codec *codec)
@@ -179,6 +698,9 @@ int snd_soc_cache_init(struct snd_soc_codec *codec)
  */
 int snd_soc_cache_exit(struct snd_soc_codec *codec)
 {
+	kfree(codec->defer_dirty);
+	codec->defer_dirty = NULL;
+
 	if (codec->cache_ops && codec->cache_ops->exit) {
 		if (codec->cache_ops->name)
 			dev_dbg(codec->dev, "Destroying %s cache for %s codec\n",
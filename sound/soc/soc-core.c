@@ -402,6 +402,61 @@ static const struct file_operations platform_list_fops = {
 	.llseek = default_llseek,/* read accesses f_pos */
 };
 
+static int dapm_latency_open_file(struct inode *inode, struct file *file)
+{
+	file->private_data = inode->i_private;
+	return 0;
+}
+
+static ssize_t dapm_latency_read_file(struct file *file,
+				      char __user *user_buf,
+				      size_t count, loff_t *ppos)
+{
+	struct snd_soc_card *card = file->private_data;
+	struct snd_soc_dapm_latency *p, *c;
+	char *buf = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	ssize_t len, ret = 0;
+	int i;
+
+	if (!buf)
+		return -ENOMEM;
+
+	len = snprintf(buf, PAGE_SIZE,
+		       "%-24s %24s %24s\n", "link (last/max/count us)",
+		       "playback", "capture");
+	if (len >= 0)
+		ret += len;
+
+	for (i = 0; i < card->num_rtd; i++) {
+		p = &card->rtd[i].dapm_latency[SNDRV_PCM_STREAM_PLAYBACK];
+		c = &card->rtd[i].dapm_latency[SNDRV_PCM_STREAM_CAPTURE];
+
+		len = snprintf(buf + ret, PAGE_SIZE - ret,
+			       "%-24s %10u/%6u/%6u %10u/%6u/%6u\n",
+			       card->rtd[i].dai_link->name,
+			       p->last, p->max, p->count,
+			       c->last, c->max, c->count);
+		if (len >= 0)
+			ret += len;
+		if (ret > PAGE_SIZE) {
+			ret = PAGE_SIZE;
+			break;
+		}
+	}
+
+	ret = simple_read_from_buffer(user_buf, count, ppos, buf, ret);
+
+	kfree(buf);
+
+	return ret;
+}
+
+static const struct file_operations dapm_latency_fops = {
+	.open = dapm_latency_open_file,
+	.read = dapm_latency_read_file,
+	.llseek = default_llseek,
+};
+
 static void soc_init_card_debugfs(struct snd_soc_card *card)
 {
 	card->debugfs_card_root = debugfs_create_dir(card->name,
@@ -418,6 +473,12 @@ static void soc_init_card_debugfs(struct snd_soc_card *card)
 	if (!card->debugfs_pop_time)
 		dev_warn(card->dev,
 		       "Failed to create pop time debugfs file\n");
+
+	if (!debugfs_create_file("dapm_latency", 0444,
+				 card->debugfs_card_root, card,
+				 &dapm_latency_fops))
+		dev_warn(card->dev,
+			 "Failed to create DAPM latency debugfs file\n");
 }
 
 static void soc_cleanup_card_debugfs(struct snd_soc_card *card)
@@ -3294,6 +3355,7 @@ int snd_soc_register_codec(struct device *dev,
 	codec->driver = codec_drv;
 	codec->num_dai = num_dai;
 	mutex_init(&codec->mutex);
+	mutex_init(&codec->defer_mutex);
 
 	/* allocate CODEC register cache */
 	if (codec_drv->reg_cache_size && codec_drv->reg_word_size) {
@@ -630,19 +630,109 @@ static int dapm_new_pga(struct snd_soc_dapm_widget *w)
 	return 0;
 }
 
-/* reset 'walked' bit for each dapm path */
-static inline void dapm_clear_walk(struct snd_soc_dapm_context *dapm)
+/* reset 'walked' bit for each dapm path visited by the last search */
+static inline void dapm_clear_walk(struct list_head *walked)
 {
-	struct snd_soc_dapm_path *p;
+	struct snd_soc_dapm_path *p, *next_p;
 
-	list_for_each_entry(p, &dapm->card->paths, list)
+	list_for_each_entry_safe(p, next_p, walked, walk_list) {
 		p->walked = 0;
+		list_del(&p->walk_list);
+	}
 }
 
+/*
+ * The number of connected endpoints of each widget is cached between DAPM
+ * runs. When a connection changes only the widgets downstream of it need
+ * their input count recomputed and only those upstream of it their output
+ * count. The walk stops at widgets which are already invalid, everything
+ * depending on those has been invalidated with them.
+ * A count found while the walk was cut short by a cycle in the graph is
+ * partial and not cached, so cached counts only depend on cached counts.
+ */
+static void dapm_widget_invalidate_inputs(struct snd_soc_dapm_widget *w)
+{
+	struct snd_soc_dapm_path *p;
+
+	if (w->inputs == -1)
+		return;
+
+	w->inputs = -1;
+
+	list_for_each_entry(p, &w->sinks, list_source) {
+		if (p->sink)
+			dapm_widget_invalidate_inputs(p->sink);
+	}
+}
+
+static void dapm_widget_invalidate_outputs(struct snd_soc_dapm_widget *w)
+{
+	struct snd_soc_dapm_path *p;
+
+	if (w->outputs == -1)
+		return;
+
+	w->outputs = -1;
+
+	list_for_each_entry(p, &w->sources, list_sink) {
+		if (p->source)
+			dapm_widget_invalidate_outputs(p->source);
+	}
+}
+
+/* an endpoint changed state */
+static void dapm_widget_invalidate(struct snd_soc_dapm_widget *w)
+{
+	dapm_widget_invalidate_inputs(w);
+	dapm_widget_invalidate_outputs(w);
+}
+
+/* a path was connected or disconnected */
+static void dapm_path_invalidate(struct snd_soc_dapm_path *p)
+{
+	if (p->sink)
+		dapm_widget_invalidate_inputs(p->sink);
+	if (p->source)
+		dapm_widget_invalidate_outputs(p->source);
+}
+
+/* drop all cached endpoint counts, for changes to the graph itself */
+static void dapm_invalidate_all(struct snd_soc_card *card)
+{
+	struct snd_soc_dapm_widget *w;
+
+	list_for_each_entry(w, &card->widgets, list) {
+		w->inputs = -1;
+		w->outputs = -1;
+	}
+}
+
+void dapm_mark_path_dirty(struct snd_soc_dapm_path *p, const char *reason)
+{
+	dapm_path_invalidate(p);
+
+	if (p->source)
+		dapm_mark_dirty(p->source, reason);
+	if (p->sink)
+		dapm_mark_dirty(p->sink, reason);
+}
+EXPORT_SYMBOL_GPL(dapm_mark_path_dirty);
+
 /* We implement power down on suspend by checking the power state of
  * the ALSA card - when we are suspending the ALSA state for the card
  * is set to D3.
  */
+static bool dapm_card_suspended(struct snd_soc_card *card)
+{
+	switch (snd_power_get_state(card->snd_card)) {
+	case SNDRV_CTL_POWER_D3hot:
+	case SNDRV_CTL_POWER_D3cold:
+		return true;
+	default:
+		return false;
+	}
+}
+
 static int snd_soc_dapm_suspend_check(struct snd_soc_dapm_widget *widget)
 {
 	int level = snd_power_get_state(widget->dapm->card->snd_card);
@@ -663,9 +753,11 @@ static int snd_soc_dapm_suspend_check(struct snd_soc_dapm_widget *widget)
  * Recursively check for a completed path to an active or physically connected
  * output widget. Returns number of complete paths.
  */
-static int is_connected_output_ep(struct snd_soc_dapm_widget *widget)
+static int __is_connected_output_ep(struct snd_soc_dapm_widget *widget,
+				    struct list_head *walked, bool *cut)
 {
 	struct snd_soc_dapm_path *path;
+	bool partial = false;
 	int con = 0;
 
 	if (widget->outputs >= 0)
@@ -710,27 +802,44 @@ static int is_connected_output_ep(struct snd_soc_dapm_widget *widget)
 		if (path->weak)
 			continue;
 
-		if (path->walked)
+		if (path->walked) {
+			partial = true;
 			continue;
+		}
 
 		if (path->sink && path->connect) {
 			path->walked = 1;
-			con += is_connected_output_ep(path->sink);
+			list_add(&path->walk_list, walked);
+			con += __is_connected_output_ep(path->sink, walked,
+							&partial);
 		}
 	}
 
-	widget->outputs = con;
+	if (partial)
+		*cut = true;
+	else
+		widget->outputs = con;
 
 	return con;
 }
 
+static int is_connected_output_ep(struct snd_soc_dapm_widget *widget,
+				  struct list_head *walked)
+{
+	bool cut = false;
+
+	return __is_connected_output_ep(widget, walked, &cut);
+}
+
 /*
  * Recursively check for a completed path to an active or physically connected
  * input widget. Returns number of complete paths.
  */
-static int is_connected_input_ep(struct snd_soc_dapm_widget *widget)
+static int __is_connected_input_ep(struct snd_soc_dapm_widget *widget,
+				   struct list_head *walked, bool *cut)
 {
 	struct snd_soc_dapm_path *path;
+	bool partial = false;
 	int con = 0;
 
 	if (widget->inputs >= 0)
@@ -787,20 +896,35 @@ static int is_connected_input_ep(struct snd_soc_dapm_widget *widget)
 		if (path->weak)
 			continue;
 
-		if (path->walked)
+		if (path->walked) {
+			partial = true;
 			continue;
+		}
 
 		if (path->source && path->connect) {
 			path->walked = 1;
-			con += is_connected_input_ep(path->source);
+			list_add(&path->walk_list, walked);
+			con += __is_connected_input_ep(path->source, walked,
+						       &partial);
 		}
 	}
 
-	widget->inputs = con;
+	if (partial)
+		*cut = true;
+	else
+		widget->inputs = con;
 
 	return con;
 }
 
+static int is_connected_input_ep(struct snd_soc_dapm_widget *widget,
+				 struct list_head *walked)
+{
+	bool cut = false;
+
+	return __is_connected_input_ep(widget, walked, &cut);
+}
+
 /*
  * Handler for generic register modifier widget.
  */
@@ -840,27 +964,29 @@ static int dapm_widget_power_check(struct snd_soc_dapm_widget *w)
  */
 static int dapm_generic_check_power(struct snd_soc_dapm_widget *w)
 {
+	LIST_HEAD(walked);
 	int in, out;
 
 	DAPM_UPDATE_STAT(w, power_checks);
 
-	in = is_connected_input_ep(w);
-	dapm_clear_walk(w->dapm);
-	out = is_connected_output_ep(w);
-	dapm_clear_walk(w->dapm);
+	in = is_connected_input_ep(w, &walked);
+	dapm_clear_walk(&walked);
+	out = is_connected_output_ep(w, &walked);
+	dapm_clear_walk(&walked);
 	return out != 0 && in != 0;
 }
 
 /* Check to see if an ADC has power */
 static int dapm_adc_check_power(struct snd_soc_dapm_widget *w)
 {
+	LIST_HEAD(walked);
 	int in;
 
 	DAPM_UPDATE_STAT(w, power_checks);
 
 	if (w->active) {
-		in = is_connected_input_ep(w);
-		dapm_clear_walk(w->dapm);
+		in = is_connected_input_ep(w, &walked);
+		dapm_clear_walk(&walked);
 		return in != 0;
 	} else {
 		return dapm_generic_check_power(w);
@@ -870,13 +996,14 @@ static int dapm_adc_check_power(struct snd_soc_dapm_widget *w)
 /* Check to see if a DAC has power */
 static int dapm_dac_check_power(struct snd_soc_dapm_widget *w)
 {
+	LIST_HEAD(walked);
 	int out;
 
 	DAPM_UPDATE_STAT(w, power_checks);
 
 	if (w->active) {
-		out = is_connected_output_ep(w);
-		dapm_clear_walk(w->dapm);
+		out = is_connected_output_ep(w, &walked);
+		dapm_clear_walk(&walked);
 		return out != 0;
 	} else {
 		return dapm_generic_check_power(w);
@@ -908,8 +1035,6 @@ static int dapm_supply_check_power(struct snd_soc_dapm_widget *w)
 			return 1;
 	}
 
-	dapm_clear_walk(w->dapm);
-
 	return 0;
 }
 
@@ -996,6 +1121,12 @@ static void dapm_seq_check_event(struct snd_soc_dapm_context *dapm,
 	if (w->event && (w->event_flags & event)) {
 		pop_dbg(dapm->dev, card->pop_time, "pop test : %s %s\n",
 			w->name, ev_name);
+		/* The event may rely on the hardware state so push out
+		 * anything we've been holding back.
+		 */
+		if (w->codec)
+			snd_soc_codec_flush_writes(w->codec);
+
 		trace_snd_soc_dapm_widget_event_start(w, event);
 		ret = w->event(w, NULL, event);
 		trace_snd_soc_dapm_widget_event_done(w, event);
@@ -1061,6 +1192,112 @@ static void dapm_seq_run_coalesced(struct snd_soc_dapm_context *dapm,
 	}
 }
 
+/* Apply the changes queued for a context in the current sequence step */
+static void dapm_seq_run_pending(struct snd_soc_dapm_context *dapm)
+{
+	struct snd_soc_codec *codec = dapm->codec;
+	struct snd_soc_dapm_widget *w, *n;
+	LIST_HEAD(pending);
+	int cur_reg = SND_SOC_NOPM;
+	bool deferred = false;
+
+	/* Combine the register writes for the step if the CODEC can,
+	 * unless we're deliberately spacing them out for pop testing.
+	 */
+	if (codec && codec->driver->write_combine && !dapm->card->pop_time)
+		deferred = snd_soc_codec_defer_writes(codec) == 0;
+
+	list_for_each_entry_safe(w, n, &dapm->seq_pending, power_list) {
+		if (w->reg != cur_reg && !list_empty(&pending)) {
+			dapm_seq_run_coalesced(dapm, &pending);
+			INIT_LIST_HEAD(&pending);
+		}
+
+		cur_reg = w->reg;
+		list_move(&w->power_list, &pending);
+	}
+
+	if (!list_empty(&pending))
+		dapm_seq_run_coalesced(dapm, &pending);
+
+	if (deferred)
+		snd_soc_codec_end_writes(codec);
+}
+
+static void dapm_seq_run_pending_async(void *data, async_cookie_t cookie)
+{
+	dapm_seq_run_pending(data);
+}
+
+/* Queue a widget for application in the current sequence step */
+static void dapm_seq_queue(struct snd_soc_dapm_widget *w,
+			   struct list_head *contexts)
+{
+	struct snd_soc_dapm_context *d;
+
+	list_for_each_entry(d, contexts, seq_list)
+		if (d == w->dapm)
+			goto found;
+
+	d = w->dapm;
+	INIT_LIST_HEAD(&d->seq_pending);
+	list_add_tail(&d->seq_list, contexts);
+
+found:
+	list_move_tail(&w->power_list, &d->seq_pending);
+}
+
+/* Apply one step of a DAPM power sequence.
+ *
+ * A step is the set of widgets sharing a sort order and subsequence.
+ * The steps are applied in order but within a step the CODEC contexts
+ * are independent of each other, so when several of them have changes
+ * queued they are applied in parallel. This avoids serialising the
+ * register writes of CODECs on different control buses. Card and
+ * platform contexts run first and in order since their events may
+ * touch any device.
+ */
+static void dapm_seq_run_step(struct list_head *contexts, int *sort,
+			      int cur_sort, int cur_subseq)
+{
+	struct snd_soc_dapm_context *d;
+	LIST_HEAD(async_domain);
+	int codecs = 0;
+	int i;
+
+	list_for_each_entry(d, contexts, seq_list) {
+		if (d->codec)
+			codecs++;
+		else
+			dapm_seq_run_pending(d);
+	}
+
+	list_for_each_entry(d, contexts, seq_list) {
+		if (!d->codec)
+			continue;
+
+		if (codecs > 1)
+			async_schedule_domain(dapm_seq_run_pending_async, d,
+					      &async_domain);
+		else
+			dapm_seq_run_pending(d);
+	}
+
+	if (codecs > 1)
+		async_synchronize_full_domain(&async_domain);
+
+	list_for_each_entry(d, contexts, seq_list) {
+		if (!d->seq_notifier)
+			continue;
+
+		for (i = 0; i < ARRAY_SIZE(dapm_up_seq); i++)
+			if (sort[i] == cur_sort)
+				d->seq_notifier(d, i, cur_subseq);
+	}
+
+	INIT_LIST_HEAD(contexts);
+}
+
 /* Apply a DAPM power sequence.
  *
  * We walk over a pre-sorted list of widgets to apply power to.  In
@@ -1073,12 +1310,10 @@ static void dapm_seq_run(struct snd_soc_dapm_context *dapm,
 			 struct list_head *list, int event, bool power_up)
 {
 	struct snd_soc_dapm_widget *w, *n;
-	LIST_HEAD(pending);
+	LIST_HEAD(contexts);
 	int cur_sort = -1;
 	int cur_subseq = -1;
-	int cur_reg = SND_SOC_NOPM;
-	struct snd_soc_dapm_context *cur_dapm = NULL;
-	int ret, i;
+	int ret;
 	int *sort;
 
 	if (power_up)
@@ -1090,24 +1325,13 @@ static void dapm_seq_run(struct snd_soc_dapm_context *dapm,
 		ret = 0;
 
 		/* Do we need to apply any queued changes? */
-		if (sort[w->id] != cur_sort || w->reg != cur_reg ||
-		    w->dapm != cur_dapm || w->subseq != cur_subseq) {
-			if (!list_empty(&pending))
-				dapm_seq_run_coalesced(cur_dapm, &pending);
-
-			if (cur_dapm && cur_dapm->seq_notifier) {
-				for (i = 0; i < ARRAY_SIZE(dapm_up_seq); i++)
-					if (sort[i] == cur_sort)
-						cur_dapm->seq_notifier(cur_dapm,
-								       i,
-								       cur_subseq);
-			}
+		if (sort[w->id] != cur_sort || w->subseq != cur_subseq) {
+			if (!list_empty(&contexts))
+				dapm_seq_run_step(&contexts, sort, cur_sort,
+						  cur_subseq);
 
-			INIT_LIST_HEAD(&pending);
 			cur_sort = -1;
 			cur_subseq = INT_MIN;
-			cur_reg = SND_SOC_NOPM;
-			cur_dapm = NULL;
 		}
 
 		switch (w->id) {
@@ -1141,9 +1365,7 @@ static void dapm_seq_run(struct snd_soc_dapm_context *dapm,
 			/* Queue it up for application */
 			cur_sort = sort[w->id];
 			cur_subseq = w->subseq;
-			cur_reg = w->reg;
-			cur_dapm = w->dapm;
-			list_move(&w->power_list, &pending);
+			dapm_seq_queue(w, &contexts);
 			break;
 		}
 
@@ -1152,15 +1374,8 @@ static void dapm_seq_run(struct snd_soc_dapm_context *dapm,
 				"Failed to apply widget power: %d\n", ret);
 	}
 
-	if (!list_empty(&pending))
-		dapm_seq_run_coalesced(cur_dapm, &pending);
-
-	if (cur_dapm && cur_dapm->seq_notifier) {
-		for (i = 0; i < ARRAY_SIZE(dapm_up_seq); i++)
-			if (sort[i] == cur_sort)
-				cur_dapm->seq_notifier(cur_dapm,
-						       i, cur_subseq);
-	}
+	if (!list_empty(&contexts))
+		dapm_seq_run_step(&contexts, sort, cur_sort, cur_subseq);
 }
 
 static void dapm_widget_update(struct snd_soc_dapm_context *dapm)
@@ -1361,6 +1576,7 @@ static int dapm_power_widgets(struct snd_soc_dapm_context *dapm, int event)
 	LIST_HEAD(down_list);
 	LIST_HEAD(async_domain);
 	enum snd_soc_bias_level bias;
+	bool suspended;
 
 	trace_snd_soc_dapm_start(card);
 
@@ -1375,12 +1591,16 @@ static int dapm_power_widgets(struct snd_soc_dapm_context *dapm, int event)
 
 	memset(&card->dapm_stats, 0, sizeof(card->dapm_stats));
 
-	list_for_each_entry(w, &card->widgets, list) {
-		w->power_checked = false;
-		w->inputs = -1;
-		w->outputs = -1;
+	/* Endpoints only count while suspended if they ignore suspend */
+	suspended = dapm_card_suspended(card);
+	if (suspended != card->dapm_suspended) {
+		dapm_invalidate_all(card);
+		card->dapm_suspended = suspended;
 	}
 
+	list_for_each_entry(w, &card->widgets, list)
+		w->power_checked = false;
+
 	/* Check which widgets we need to power and store them in
 	 * lists indicating if they should be powered up or down.  We
 	 * only check widgets that have been flagged as dirty but note
@@ -1500,15 +1720,16 @@ static ssize_t dapm_widget_power_read_file(struct file *file,
 	int in, out;
 	ssize_t ret;
 	struct snd_soc_dapm_path *p = NULL;
+	LIST_HEAD(walked);
 
 	buf = kmalloc(PAGE_SIZE, GFP_KERNEL);
 	if (!buf)
 		return -ENOMEM;
 
-	in = is_connected_input_ep(w);
-	dapm_clear_walk(w->dapm);
-	out = is_connected_output_ep(w);
-	dapm_clear_walk(w->dapm);
+	in = is_connected_input_ep(w, &walked);
+	dapm_clear_walk(&walked);
+	out = is_connected_output_ep(w, &walked);
+	dapm_clear_walk(&walked);
 
 	ret = snprintf(buf, PAGE_SIZE, "%s: %s  in %d out %d",
 		       w->name, w->power ? "On" : "Off", in, out);
@@ -1674,8 +1895,8 @@ static int dapm_mux_update_power(struct snd_soc_dapm_widget *widget,
 	if (!change)
 		return 0;
 
-	/* find dapm widget path assoc with kcontrol */
-	list_for_each_entry(path, &widget->dapm->card->paths, list) {
+	/* find dapm widget path assoc with kcontrol, the mux is the sink */
+	list_for_each_entry(path, &widget->sources, list_sink) {
 		if (path->kcontrol != kcontrol)
 			continue;
 
@@ -1685,12 +1906,16 @@ static int dapm_mux_update_power(struct snd_soc_dapm_widget *widget,
 		found = 1;
 		/* we now need to match the string in the enum to the path */
 		if (!(strcmp(path->name, e->texts[mux]))) {
+			if (!path->connect)
+				dapm_path_invalidate(path);
 			path->connect = 1; /* new connection */
 			dapm_mark_dirty(path->source, "mux connection");
 		} else {
-			if (path->connect)
+			if (path->connect) {
+				dapm_path_invalidate(path);
 				dapm_mark_dirty(path->source,
 						"mux disconnection");
+			}
 			path->connect = 0; /* old connection must be powered down */
 		}
 	}
@@ -1715,13 +1940,15 @@ static int dapm_mixer_update_power(struct snd_soc_dapm_widget *widget,
 	    widget->id != snd_soc_dapm_switch)
 		return -ENODEV;
 
-	/* find dapm widget path assoc with kcontrol */
-	list_for_each_entry(path, &widget->dapm->card->paths, list) {
+	/* find dapm widget path assoc with kcontrol, the mixer is the sink */
+	list_for_each_entry(path, &widget->sources, list_sink) {
 		if (path->kcontrol != kcontrol)
 			continue;
 
 		/* found, now check type */
 		found = 1;
+		if (path->connect != connect)
+			dapm_path_invalidate(path);
 		path->connect = connect;
 		dapm_mark_dirty(path->source, "mixer connection");
 	}
@@ -1869,6 +2096,9 @@ static int snd_soc_dapm_set_pin(struct snd_soc_dapm_context *dapm,
 		return -EINVAL;
 	}
 
+	if (w->connected != status)
+		dapm_widget_invalidate(w);
+
 	w->connected = status;
 	if (status == 0)
 		w->force = 0;
@@ -2059,6 +2289,8 @@ int snd_soc_dapm_add_routes(struct snd_soc_dapm_context *dapm,
 {
 	int i, ret;
 
+	dapm_invalidate_all(dapm->card);
+
 	for (i = 0; i < num; i++) {
 		ret = snd_soc_dapm_add_route(dapm, route);
 		if (ret < 0) {
@@ -2140,6 +2372,8 @@ int snd_soc_dapm_weak_routes(struct snd_soc_dapm_context *dapm,
 	int i, err;
 	int ret = 0;
 
+	dapm_invalidate_all(dapm->card);
+
 	for (i = 0; i < num; i++) {
 		err = snd_soc_dapm_weak_route(dapm, route);
 		if (err)
@@ -2213,6 +2447,7 @@ int snd_soc_dapm_new_widgets(struct snd_soc_dapm_context *dapm)
 		dapm_debugfs_add_widget(w);
 	}
 
+	dapm_invalidate_all(dapm->card);
 	dapm_power_widgets(dapm, SND_SOC_DAPM_STREAM_NOP);
 	return 0;
 }
@@ -2732,6 +2967,9 @@ int snd_soc_dapm_new_control(struct snd_soc_dapm_context *dapm,
 	INIT_LIST_HEAD(&w->dirty);
 	list_add(&w->list, &dapm->card->widgets);
 
+	w->inputs = -1;
+	w->outputs = -1;
+
 	/* machine layer set ups unconnected pins and insertions */
 	w->connected = 1;
 	return 0;
@@ -2783,9 +3021,13 @@ static void soc_dapm_stream_event(struct snd_soc_dapm_context *dapm,
 			dapm_mark_dirty(w, "stream event");
 			switch(event) {
 			case SND_SOC_DAPM_STREAM_START:
+				if (!w->active)
+					dapm_widget_invalidate(w);
 				w->active = 1;
 				break;
 			case SND_SOC_DAPM_STREAM_STOP:
+				if (w->active)
+					dapm_widget_invalidate(w);
 				w->active = 0;
 				break;
 			case SND_SOC_DAPM_STREAM_SUSPEND:
@@ -2819,13 +3061,34 @@ int snd_soc_dapm_stream_event(struct snd_soc_pcm_runtime *rtd,
 	const char *stream, int event)
 {
 	struct snd_soc_codec *codec = rtd->codec;
+	struct snd_soc_dapm_latency *latency;
+	const char *capture = rtd->codec_dai->driver->capture.stream_name;
+	ktime_t start;
+	unsigned int us;
 
 	if (stream == NULL)
 		return 0;
 
+	start = ktime_get();
+
 	mutex_lock(&codec->mutex);
 	soc_dapm_stream_event(&codec->dapm, stream, event);
 	mutex_unlock(&codec->mutex);
+
+	if (event == SND_SOC_DAPM_STREAM_START) {
+		us = ktime_to_us(ktime_sub(ktime_get(), start));
+
+		if (capture && !strcmp(stream, capture))
+			latency = &rtd->dapm_latency[SNDRV_PCM_STREAM_CAPTURE];
+		else
+			latency = &rtd->dapm_latency[SNDRV_PCM_STREAM_PLAYBACK];
+
+		latency->last = us;
+		if (us > latency->max)
+			latency->max = us;
+		latency->count++;
+	}
+
 	return 0;
 }
 
@@ -2868,6 +3131,8 @@ int snd_soc_dapm_force_enable_pin(struct snd_soc_dapm_context *dapm,
 	}
 
 	dev_dbg(w->dapm->dev, "dapm: force enable pin %s\n", pin);
+	if (!w->connected)
+		dapm_widget_invalidate(w);
 	w->connected = 1;
 	w->force = 1;
 	dapm_mark_dirty(w, "force enable");
@@ -2955,6 +3220,7 @@ int snd_soc_dapm_ignore_suspend(struct snd_soc_dapm_context *dapm,
 	}
 
 	w->ignore_suspend = 1;
+	dapm_widget_invalidate(w);
 
 	return 0;
 }
@@ -3045,6 +3311,7 @@ void snd_soc_dapm_free(struct snd_soc_dapm_context *dapm)
 	dapm_debugfs_cleanup(dapm);
 	dapm_free_widgets(dapm);
 	list_del(&dapm->list);
+	dapm_invalidate_all(dapm->card);
 }
 EXPORT_SYMBOL_GPL(snd_soc_dapm_free);
 
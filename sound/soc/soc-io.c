@@ -15,13 +15,106 @@
 #include <linux/spi/spi.h>
 #include <linux/regmap.h>
 #include <linux/export.h>
+#include <linux/slab.h>
 #include <sound/soc.h>
 
 #include <trace/events/asoc.h>
 
 #ifdef CONFIG_REGMAP
-static int hw_write(struct snd_soc_codec *codec, unsigned int reg,
-		    unsigned int value)
+/* Largest run of registers written out in a single bus transaction */
+#define SND_SOC_DEFER_MAX_RUN	32
+
+static int hw_write_run(struct snd_soc_codec *codec, unsigned int reg,
+			unsigned int count)
+{
+	union {
+		u8 u8[SND_SOC_DEFER_MAX_RUN];
+		u16 u16[SND_SOC_DEFER_MAX_RUN];
+		u32 u32[SND_SOC_DEFER_MAX_RUN];
+	} buf;
+	unsigned int i, val;
+	int ret;
+
+	for (i = 0; i < count; i++) {
+		ret = snd_soc_cache_read(codec, reg + i, &val);
+		if (ret < 0)
+			return ret;
+
+		switch (codec->val_bytes) {
+		case 1:
+			buf.u8[i] = val;
+			break;
+		case 2:
+			buf.u16[i] = val;
+			break;
+		case 4:
+			buf.u32[i] = val;
+			break;
+		default:
+			return -EINVAL;
+		}
+	}
+
+	return regmap_bulk_write(codec->control_data, reg, &buf, count);
+}
+
+/*
+ * Write out the registers dirtied while writes were deferred, in
+ * address order, merging runs of adjacent registers into a single
+ * bus transaction.  If the bus can't do multi-register writes fall
+ * back to writing the registers one at a time.  Single registers are
+ * submitted asynchronously so buses which can queue transfers keep
+ * busy while we work out the next write.  Called with defer_mutex held.
+ */
+static int hw_write_deferred(struct snd_soc_codec *codec)
+{
+	unsigned int size = codec->driver->reg_cache_size;
+	unsigned int reg, end, i, val;
+	int ret = 0, err;
+
+	if (codec->cache_only) {
+		/* Everything is in the cache already, let sync do it */
+		bitmap_zero(codec->defer_dirty, size);
+		codec->cache_sync = 1;
+		return 0;
+	}
+
+	reg = find_first_bit(codec->defer_dirty, size);
+	while (reg < size) {
+		end = find_next_zero_bit(codec->defer_dirty, size, reg);
+		if (end - reg > SND_SOC_DEFER_MAX_RUN)
+			end = reg + SND_SOC_DEFER_MAX_RUN;
+
+		ret = -EINVAL;
+		if (end - reg > 1)
+			ret = hw_write_run(codec, reg, end - reg);
+		if (ret == -EINVAL) {
+			for (i = reg, ret = 0; i < end && ret == 0; i++) {
+				ret = snd_soc_cache_read(codec, i, &val);
+				if (ret == 0)
+					ret = regmap_write_async(
+						codec->control_data, i, val);
+			}
+		}
+		if (ret < 0)
+			goto out;
+
+		bitmap_clear(codec->defer_dirty, reg, end - reg);
+		reg = find_next_bit(codec->defer_dirty, size, end);
+	}
+
+out:
+	err = regmap_async_complete(codec->control_data);
+	if (ret == 0)
+		ret = err;
+	if (ret < 0)
+		dev_err(codec->dev,
+			"Failed to write deferred registers: %d\n", ret);
+	return ret;
+}
+
+static int __hw_write(struct snd_soc_codec *codec, unsigned int reg,
+		      unsigned int value)
 {
 	int ret;
 
@@ -31,6 +124,16 @@ static int hw_write(struct snd_soc_codec *codec, unsigned int reg,
 		ret = snd_soc_cache_write(codec, reg, value);
 		if (ret < 0)
 			return -1;
+
+		if (codec->defer_depth && !codec->cache_only) {
+			set_bit(reg, codec->defer_dirty);
+			return 0;
+		}
+	} else if (codec->defer_depth) {
+		/* Keep ordering against writes we've held back */
+		ret = hw_write_deferred(codec);
+		if (ret < 0)
+			return ret;
 	}
 
 	if (codec->cache_only) {
@@ -41,6 +144,18 @@ static int hw_write(struct snd_soc_codec *codec, unsigned int reg,
 	return regmap_write(codec->control_data, reg, value);
 }
 
+static int hw_write(struct snd_soc_codec *codec, unsigned int reg,
+		    unsigned int value)
+{
+	int ret;
+
+	mutex_lock(&codec->defer_mutex);
+	ret = __hw_write(codec, reg, value);
+	mutex_unlock(&codec->defer_mutex);
+
+	return ret;
+}
+
 static unsigned int hw_read(struct snd_soc_codec *codec, unsigned int reg)
 {
 	int ret;
@@ -52,6 +167,12 @@ static unsigned int hw_read(struct snd_soc_codec *codec, unsigned int reg)
 		if (codec->cache_only)
 			return -1;
 
+		mutex_lock(&codec->defer_mutex);
+		ret = codec->defer_depth ? hw_write_deferred(codec) : 0;
+		mutex_unlock(&codec->defer_mutex);
+		if (ret < 0)
+			return -1;
+
 		ret = regmap_read(codec->control_data, reg, &val);
 		if (ret == 0)
 			return val;
@@ -119,6 +240,7 @@ int snd_soc_codec_set_cache_io(struct snd_soc_codec *codec,
 	codec->write = hw_write;
 	codec->read = hw_read;
 	codec->bulk_write_raw = snd_soc_hw_bulk_write_raw;
+	codec->val_bytes = DIV_ROUND_UP(data_bits, 8);
 
 	config.reg_bits = addr_bits;
 	config.val_bits = data_bits;
@@ -152,6 +274,93 @@ int snd_soc_codec_set_cache_io(struct snd_soc_codec *codec,
 	return 0;
 }
 EXPORT_SYMBOL_GPL(snd_soc_codec_set_cache_io);
+
+/**
+ * snd_soc_codec_defer_writes: Start combining register writes.
+ *
+ * @codec: CODEC to configure.
+ *
+ * Until the matching snd_soc_codec_end_writes() writes to cached
+ * registers only update the cache.  The registers written are then
+ * sent to the device in address order, with runs of adjacent
+ * registers combined into single bus transactions.  Writes to
+ * volatile or uncached registers and reads of volatile registers
+ * write out anything pending first so the device sees the same
+ * ordering for them.  Calls may be nested.
+ *
+ * Only CODECs using snd_soc_codec_set_cache_io() are supported; the
+ * device must auto-increment the register address for multi-register
+ * writes.
+ */
+int snd_soc_codec_defer_writes(struct snd_soc_codec *codec)
+{
+	unsigned int size = codec->driver->reg_cache_size;
+	int ret = 0;
+
+	if (codec->write != hw_write || !size)
+		return -ENOTSUPP;
+
+	mutex_lock(&codec->defer_mutex);
+	if (!codec->defer_dirty) {
+		codec->defer_dirty = kcalloc(BITS_TO_LONGS(size),
+					     sizeof(unsigned long),
+					     GFP_KERNEL);
+		if (!codec->defer_dirty)
+			ret = -ENOMEM;
+	}
+
+	if (ret == 0)
+		codec->defer_depth++;
+	mutex_unlock(&codec->defer_mutex);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(snd_soc_codec_defer_writes);
+
+/**
+ * snd_soc_codec_flush_writes: Write out registers held back so far.
+ *
+ * @codec: CODEC to flush.
+ *
+ * Used when something outside the register map, such as a delay or a
+ * clock change, depends on the writes already issued having reached
+ * the device.  Writes remain deferred afterwards.
+ */
+int snd_soc_codec_flush_writes(struct snd_soc_codec *codec)
+{
+	int ret = 0;
+
+	mutex_lock(&codec->defer_mutex);
+	if (codec->defer_depth)
+		ret = hw_write_deferred(codec);
+	mutex_unlock(&codec->defer_mutex);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(snd_soc_codec_flush_writes);
+
+/**
+ * snd_soc_codec_end_writes: Stop combining register writes.
+ *
+ * @codec: CODEC to configure.
+ *
+ * Ends a section started with snd_soc_codec_defer_writes(), writing
+ * out any pending registers once the outermost section ends.
+ */
+int snd_soc_codec_end_writes(struct snd_soc_codec *codec)
+{
+	int ret = 0;
+
+	mutex_lock(&codec->defer_mutex);
+	if (WARN_ON(!codec->defer_depth))
+		ret = -EINVAL;
+	else if (--codec->defer_depth == 0)
+		ret = hw_write_deferred(codec);
+	mutex_unlock(&codec->defer_mutex);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(snd_soc_codec_end_writes);
 #else
 int snd_soc_codec_set_cache_io(struct snd_soc_codec *codec,
 			       int addr_bits, int data_bits,
@@ -160,4 +369,22 @@ int snd_soc_codec_set_cache_io(struct snd_soc_codec *codec,
 	return -ENOTSUPP;
 }
 EXPORT_SYMBOL_GPL(snd_soc_codec_set_cache_io);
+
+int snd_soc_codec_defer_writes(struct snd_soc_codec *codec)
+{
+	return -ENOTSUPP;
+}
+EXPORT_SYMBOL_GPL(snd_soc_codec_defer_writes);
+
+int snd_soc_codec_flush_writes(struct snd_soc_codec *codec)
+{
+	return 0;
+}
+EXPORT_SYMBOL_GPL(snd_soc_codec_flush_writes);
+
+int snd_soc_codec_end_writes(struct snd_soc_codec *codec)
+{
+	return -ENOTSUPP;
+}
+EXPORT_SYMBOL_GPL(snd_soc_codec_end_writes);
 #endif